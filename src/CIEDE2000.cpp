@@ -224,6 +224,34 @@ void rgbToLAB(uint8_t red, uint8_t green, uint8_t blue, CIEDE2000::LAB &lab) {
   xyzToLAB(xValue, yValue, zValue, lab);
 }
 
+void labToRGB(const CIEDE2000::LAB &lab, uint8_t &red, uint8_t &green, uint8_t &blue) {
+  // Inverse of the CIE standard function used by xyzToLAB
+  auto fInverse = [](double t) -> double {
+    const double delta = 6.0 / 29.0;
+    if (t > delta) {
+      return t * t * t;
+    } else {
+      return 3.0 * delta * delta * (t - (4.0 / 29.0));
+    }
+  };
+
+  const double FY = (lab.l + 16.0) / 116.0;
+  const double X = 0.95047 * fInverse(FY + (lab.a / 500.0));
+  const double Y = 1.00000 * fInverse(FY);
+  const double Z = 1.08883 * fInverse(FY - (lab.b / 200.0));
+
+  // Inverse sRGB matrix (D65 illuminant) and gamma
+  auto toChannel = [](double linear) -> uint8_t {
+    const double ENCODED =
+        linear > 0.0031308 ? (1.055 * pow(linear, 1.0 / 2.4)) - 0.055 : linear * 12.92;
+    const double SCALED = round(ENCODED * 255.0);
+    return (uint8_t)(SCALED < 0.0 ? 0.0 : (SCALED > 255.0 ? 255.0 : SCALED));
+  };
+  red = toChannel(X * 3.2404542 + Y * -1.5371385 + Z * -0.4985314);
+  green = toChannel(X * -0.9692660 + Y * 1.8760108 + Z * 0.0415560);
+  blue = toChannel(X * 0.0556434 + Y * -0.2040259 + Z * 1.0572252);
+}
+
 /*****************************************************************************
  * Operators.
  *****************************************************************************/
@@ -126,6 +126,17 @@ void xyzToLAB(double x, double y, double z, CIEDE2000::LAB &lab);
  */
 void rgbToLAB(uint8_t red, uint8_t green, uint8_t blue, CIEDE2000::LAB &lab);
 
+/**
+ * @brief
+ * Convert LAB (D65 illuminant) back to RGB, clamping out-of-gamut colors
+ *
+ * @param lab Input LAB color
+ * @param red Output red component (0-255)
+ * @param green Output green component (0-255)
+ * @param blue Output blue component (0-255)
+ */
+void labToRGB(const CIEDE2000::LAB &lab, uint8_t &red, uint8_t &green, uint8_t &blue);
+
 /*****************************************************************************
  * Conversions.
  *****************************************************************************/
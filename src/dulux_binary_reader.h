@@ -5,15 +5,18 @@
  * This header provides memory-efficient reading of the binary Dulux color database.
  * The binary format significantly reduces memory usage compared to JSON parsing.
  *
- * Binary Format:
+ * Binary Format (see dulux_palette_format.h):
  * - Header: 16 bytes (magic, version, count, reserved)
- * - Each color entry: variable length with packed data
+ * - v1: each color entry is variable length with packed data
+ * - v2: fixed-size columns plus a string heap, located via a section table
  *
  * Memory Benefits:
  * - No JSON parsing overhead (saves ~1-2MB during loading)
  * - Compact binary format (typically 50-70% smaller than JSON)
  * - Direct memory mapping possible for read-only access
  * - Faster loading times
+ * - Names and codes live in one PSRAM arena: O(1) allocations per load and
+ *   no small String objects fragmenting the internal heap
  */
 
 #ifndef DULUX_BINARY_READER_H
@@ -23,28 +26,53 @@
 
 #include <esp_heap_caps.h>
 
-#include <LittleFS.h>
+#include <string.h>
 
-#include <new>
+#include "dulux_palette_arena.h"
+#include "dulux_palette_format.h"
+#include "psram_utils.h"
 
-// Binary format constants
-#define DULUX_MAGIC_NUMBER 0x584C5544  // "DULX" in little-endian
-#define DULUX_BINARY_VERSION 1
-#define DULUX_HEADER_SIZE 16
+/**
+ * @brief Read-only view of a NUL-terminated string owned by the palette arena
+ *
+ * Valid for as long as the DuluxBinaryReader that produced it stays loaded.
+ */
+struct DuluxStringView {
+  const char* ptr{""};
+  uint16_t len{0};
+
+  const char* c_str() const {
+    return ptr;
+  }
+  size_t length() const {
+    return len;
+  }
+  bool isEmpty() const {
+    return len == 0;
+  }
+
+  /**
+   * @brief Copy into an Arduino String (allocates - only for API responses)
+   */
+  String toString() const {
+    return String(ptr);
+  }
+};
 
 /**
  * @brief Compact color structure for binary format
  *
  * This structure is optimized for memory usage while maintaining
- * all necessary color information.
+ * all necessary color information. Name and code point into the PSRAM
+ * arena, so a loaded palette costs no per-color heap allocations.
  */
 struct DuluxColorBinary {
-  uint8_t r, g, b;      // RGB values (3 bytes)
-  uint16_t lrv_scaled;  // LRV * 100 (2 bytes, e.g., 7940 for 79.40)
-  uint32_t id;          // Color ID (4 bytes)
-  String name;          // Color name (heap allocated)
-  String code;          // Color code (heap allocated)
-  bool light_text;      // Light text flag (1 byte)
+  uint8_t r, g, b;       // RGB values (3 bytes)
+  bool light_text;       // Light text flag (1 byte)
+  uint16_t lrv_scaled;   // LRV * 100 (2 bytes, e.g., 7940 for 79.40)
+  uint32_t id;           // Color ID (4 bytes)
+  DuluxStringView name;  // Color name (arena view)
+  DuluxStringView code;  // Color code (arena view)
 
   /**
    * @brief Get LRV as float value
@@ -64,77 +92,78 @@ struct DuluxColorBinary {
   }
 };
 
-/**
- * @brief Binary header structure
- */
-struct DuluxBinaryHeader {
-  uint32_t magic;        // Magic number for validation
-  uint32_t version;      // Format version
-  uint32_t color_count;  // Number of colors in file
-  uint32_t reserved;     // Reserved for future use
-};
-
 /**
  * @brief Dulux binary database reader class
  *
  * This class provides efficient loading and access to the binary
- * Dulux color database with minimal memory overhead.
+ * Dulux color database with minimal memory overhead. The file is loaded
+ * by DuluxPaletteArena; this class only adds a DuluxColorBinary table
+ * (one PSRAM allocation) whose strings are views into the arena.
  */
 class DuluxBinaryReader {
  private:
-  DuluxColorBinary* colors;
+  DuluxPaletteArena arena;
+  PSRAMVector<DuluxColorBinary> colors;
+  PSRAMVector<char> decoded_strings;  // Front-coded palettes only: all strings, decoded once
   uint32_t color_count;
   bool loaded;
 
+  static DuluxStringView makeView(const char* str) {
+    DuluxStringView view;
+    view.ptr = str;
+    view.len = (uint16_t)strlen(str);
+    return view;
+  }
+
   /**
-   * @brief Read a string from file with length prefix
-   * @param file File to read from
-   * @return String read from file
+   * @brief Expand front-coded names/codes into one PSRAM block
+   *
+   * This reader hands out stable string views for every color, so it pays
+   * the decode once: a sizing pass, a single allocation, then a fill pass.
    */
-  String readString(File& file) {
-    uint8_t length = file.read();
-    if (length == 0 || length == 255) {  // 255 indicates read error
-      return String();
+  bool decodeAllStrings() {
+    char buffer[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    size_t total = 0;
+    for (uint32_t i = 0; i < color_count; i++) {
+      total += arena.copyName(i, buffer, sizeof(buffer)) + 1;
+      total += arena.copyCode(i, buffer, sizeof(buffer)) + 1;
     }
 
-    // Use heap allocation instead of PSRAM for temporary buffer
-    char* buffer = static_cast<char*>(malloc(length + 1));
-    if (!buffer) {
-      Serial.printf("Failed to allocate %d bytes for string buffer\n", length + 1);
-      return String();
+    try {
+      decoded_strings.resize(total);
+    } catch (const std::bad_alloc&) {
+      Serial.printf("Failed to allocate %u bytes for decoded strings\n", (unsigned)total);
+      return false;
     }
 
-    size_t bytes_read = file.readBytes(buffer, length);
-    if (bytes_read != length) {
-      Serial.printf("String read error: expected %d bytes, got %d\n", length, bytes_read);
-      free(buffer);
-      return String();
+    char* cursor = decoded_strings.data();
+    for (uint32_t i = 0; i < color_count; i++) {
+      colors[i].name = makeView(cursor);
+      cursor += arena.copyName(i, cursor, DULUX_FRONT_CODED_MAX_LENGTH + 1) + 1;
+      colors[i].code = makeView(cursor);
+      cursor += arena.copyCode(i, cursor, DULUX_FRONT_CODED_MAX_LENGTH + 1) + 1;
     }
-
-    buffer[bytes_read] = '\0';
-
-    // Create string and immediately free buffer
-    String result(buffer);
-    free(buffer);
-
-    return result;
+    return true;
   }
 
  public:
   /**
    * @brief Constructor
    */
-  DuluxBinaryReader() : colors(nullptr), color_count(0), loaded(false) {
+  DuluxBinaryReader() : color_count(0), loaded(false) {
   }
 
   /**
-   * @brief Destructor - cleanup allocated memory
+   * @brief Release the color table and the arena
    */
-  ~DuluxBinaryReader() {
-    if (colors) {
-      delete[] colors;
-      colors = nullptr;
-    }
+  void unload() {
+    colors.clear();
+    colors.shrink_to_fit();
+    decoded_strings.clear();
+    decoded_strings.shrink_to_fit();
+    arena.release();
+    color_count = 0;
+    loaded = false;
   }
 
   /**
@@ -144,39 +173,18 @@ class DuluxBinaryReader {
    */
   bool loadDatabase(const char* filename) {
     Serial.printf("Loading binary color database: %s\n", filename);
+    unload();
 
-    // Open file
-    File file = LittleFS.open(filename, "r");
-    if (!file) {
-      Serial.printf("Failed to open binary file: %s\n", filename);
-      return false;
-    }
-
-    // Read and validate header
-    DuluxBinaryHeader header;
-    if (file.readBytes(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)) {
-      Serial.println("Failed to read binary header");
-      file.close();
-      return false;
-    }
-
-    // Validate magic number and version
-    if (header.magic != DULUX_MAGIC_NUMBER) {
-      Serial.printf("Invalid magic number: 0x%08X (expected 0x%08X)\n", header.magic,
-                    DULUX_MAGIC_NUMBER);
-      file.close();
-      return false;
-    }
+    size_t const INTERNAL_BEFORE = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
 
-    if (header.version != DULUX_BINARY_VERSION) {
-      Serial.printf("Unsupported version: %u (expected %u)\n", header.version,
-                    DULUX_BINARY_VERSION);
-      file.close();
+    if (!arena.load(filename)) {
+      Serial.printf("Failed to load binary file: %s\n", filename);
       return false;
     }
 
-    color_count = header.color_count;
-    Serial.printf("Binary database contains %u colors\n", color_count);
+    color_count = arena.getColorCount();
+    Serial.printf("Binary database contains %u colors (format v%u)\n", color_count,
+                  arena.getFormatVersion());
 
 // Debug mode: limit colors for testing
 #ifdef DEBUG_BINARY_LOADING
@@ -186,106 +194,44 @@ class DuluxBinaryReader {
     }
 #endif
 
-    // Allocate memory in regular heap (PSRAM can cause issues with String objects)
-    Serial.printf("Allocating %u bytes for %u colors...\n", sizeof(DuluxColorBinary) * color_count,
-                  color_count);
-
-    colors = new (std::nothrow) DuluxColorBinary[color_count];
-    if (!colors) {
+    try {
+      colors.resize(color_count);
+    } catch (const std::bad_alloc&) {
       Serial.println("Failed to allocate memory for color database");
-      file.close();
+      unload();
       return false;
     }
 
-    Serial.println("Memory allocation successful");
-
-    Serial.printf("Allocated %u bytes for color database\n",
-                  sizeof(DuluxColorBinary) * color_count);
-
-    // Read color entries with error checking
-    Serial.println("Starting to read color entries...");
-
     for (uint32_t i = 0; i < color_count; i++) {
+      const DuluxArenaRecord& record = arena.record(i);
       DuluxColorBinary& color = colors[i];
-
-      // Check if we can still read from file
-      if (!file.available()) {
-        Serial.printf("Unexpected end of file at color %u\n", i);
-        delete[] colors;
-        colors = nullptr;
-        file.close();
-        return false;
-      }
-
-      // Read RGB values with validation
-      int r_val = file.read();
-      int g_val = file.read();
-      int b_val = file.read();
-
-      if (r_val < 0 || g_val < 0 || b_val < 0) {
-        Serial.printf("Failed to read RGB values for color %u\n", i);
-        delete[] colors;
-        colors = nullptr;
-        file.close();
-        return false;
+      color.r = record.r;
+      color.g = record.g;
+      color.b = record.b;
+      color.light_text = (record.flags & DULUX_FLAG_LIGHT_TEXT) != 0;
+      color.lrv_scaled = record.lrv_scaled;
+      color.id = record.id;
+      if (arena.hasInlineStrings()) {
+        color.name = makeView(arena.name(i));
+        color.code = makeView(arena.code(i));
       }
+    }
 
-      color.r = (uint8_t)r_val;
-      color.g = (uint8_t)g_val;
-      color.b = (uint8_t)b_val;
-
-      // Read LRV (scaled) with validation
-      if (file.readBytes(reinterpret_cast<char*>(&color.lrv_scaled), sizeof(color.lrv_scaled)) !=
-          sizeof(color.lrv_scaled)) {
-        Serial.printf("Failed to read LRV for color %u\n", i);
-        delete[] colors;
-        colors = nullptr;
-        file.close();
-        return false;
-      }
-
-      // Read ID with validation
-      if (file.readBytes(reinterpret_cast<char*>(&color.id), sizeof(color.id)) != sizeof(color.id)) {
-        Serial.printf("Failed to read ID for color %u\n", i);
-        delete[] colors;
-        colors = nullptr;
-        file.close();
-        return false;
-      }
-
-      // Read name and code strings with error checking
-      color.name = readString(file);
-      if (color.name.length() == 0) {
-        Serial.printf("Warning: Empty name for color %u\n", i);
-      }
-
-      color.code = readString(file);
-      if (color.code.length() == 0) {
-        Serial.printf("Warning: Empty code for color %u\n", i);
-      }
-
-      // Read light text flag
-      int light_flag = file.read();
-      if (light_flag < 0) {
-        Serial.printf("Failed to read light text flag for color %u\n", i);
-        delete[] colors;
-        colors = nullptr;
-        file.close();
-        return false;
-      }
-      color.light_text = (light_flag != 0);
-
-      // Progress indicator for large databases
-      if ((i + 1) % 500 == 0) {
-        Serial.printf("Loaded %u/%u colors...\n", i + 1, color_count);
-      }
+    if (!arena.hasInlineStrings() && !decodeAllStrings()) {
+      unload();
+      return false;
     }
 
-    file.close();
     loaded = true;
 
+    size_t const INTERNAL_AFTER = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
     Serial.printf("Successfully loaded %u colors from binary database\n", color_count);
-    Serial.printf("Memory usage: %u bytes\n", sizeof(DuluxColorBinary) * color_count);
+    size_t const TABLE_BYTES = colors.size() * sizeof(DuluxColorBinary);
+    Serial.printf("Memory usage: %u bytes PSRAM (arena %u + table %u + strings %u), "
+                  "internal heap delta %d\n",
+                  (unsigned)(arena.getStats().block_bytes + TABLE_BYTES + decoded_strings.size()),
+                  (unsigned)arena.getStats().block_bytes, (unsigned)TABLE_BYTES,
+                  (unsigned)decoded_strings.size(), (int)INTERNAL_BEFORE - (int)INTERNAL_AFTER);
 
     return true;
   }
@@ -295,7 +241,7 @@ class DuluxBinaryReader {
    * @return true if loaded, false otherwise
    */
   bool isLoaded() const {
-    return loaded && colors != nullptr;
+    return loaded;
   }
 
   /**
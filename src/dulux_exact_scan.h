@@ -0,0 +1,374 @@
+/**
+ * @file dulux_exact_scan.h
+ * @brief Exhaustive palette search that skips candidates a cheap bound rules out
+ *
+ * The answer is exactly that of the plain scans (same metric, same tie
+ * break on the lower palette index), but most candidates never reach the
+ * full CIEDE2000 formula:
+ *
+ * - Entries are sorted by L*. A search starts at the target's L* and widens
+ *   the window in both directions; since dE00 >= |dL| / max(S_L), a side is
+ *   finished once that alone exceeds the best distance found.
+ * - Inside the window each candidate is first checked against
+ *     dE00^2 >= (dL / 1.747)^2 + 0.134 (da^2 + db^2) / (1 + 0.03375 (C1 + C2))^2
+ *   (differences in L*, a*, b*; C = chroma), which follows from S_L <= 1.747
+ *   on L* in [0, 100], S_H <= S_C, |R_T| <= sqrt(3), |da'| >= |da| and
+ *   C' <= 1.5 C. L*, a*, b* and C* are kept as separate columns, so the
+ *   window grows by DULUX_LAB_LANES entries at a time and each block is
+ *   checked in one dulux_lab_kernel.h call.
+ * - For a light target the shared metric scores light candidates by RGB
+ *   distance, which has no L* ordering; those are scanned first (they are
+ *   cheap), and the window then covers the CIEDE2000-scored rest.
+ * - Given workers (setWorkers()), the light candidates and the window's
+ *   blocks on each side are dealt out to the DuluxParallelScan shards in
+ *   turn. The shards share the best distance found for pruning, and their
+ *   winners merge with the same tie break.
+ *
+ * There is no time budget: the bounds make the full scan affordable, so the
+ * result is always the true optimum.
+ */
+
+#ifndef DULUX_EXACT_SCAN_H
+#define DULUX_EXACT_SCAN_H
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "dulux_lab_kernel.h"
+#include "dulux_match_metric.h"
+#include "dulux_palette_format.h"
+#include "dulux_parallel_scan.h"
+#include "lightweight_kdtree.h"
+
+#define DULUX_EXACT_MAX_COLORS 65535    // Palette indices are stored as uint16_t
+#define DULUX_EXACT_SL_MAX 1.747f       // Largest CIEDE2000 S_L for L* in [0, 100]
+#define DULUX_EXACT_CROSS_FLOOR 0.134f  // 1 - max|R_T| / 2
+#define DULUX_EXACT_SC_SLOPE 0.03375f   // 0.045 * C'mean / (C1 + C2), with C' <= 1.5 C
+#define DULUX_EXACT_BOUND_SLACK 1e-3f   // Bounds must beat the best by this much to prune
+#define DULUX_EXACT_NO_SEED UINT32_MAX  // findClosest() without a starting candidate
+
+/**
+ * @brief Work done by one exact search
+ */
+struct DuluxExactScanStats {
+  uint32_t window;     // Candidates in the final L* window, whole blocks (plus light candidates)
+  uint32_t evaluated;  // Candidates scored with the full metric
+};
+
+class DuluxExactScan {
+ private:
+  struct Entry {
+    uint16_t index;  // Palette index
+    uint8_t r, g, b;
+    uint8_t light;   // All channels above DULUX_LIGHT_CHANNEL_THRESHOLD
+  };
+
+  template <typename T>
+  using Column = std::vector<T, PSRAMAllocator<T>>;
+
+  // All sorted by L*; the L*a*b* columns hold the same values (* 100) the plain scans use
+  Column<Entry> entries;
+  Column<int16_t> column_l, column_a, column_b;
+  Column<uint16_t> column_chroma;  // C* * 100, rounded up
+  Column<uint16_t> light_entries;  // Positions in entries
+  Column<uint16_t> positions;      // Palette index -> entry
+  bool built{false};
+  DuluxParallelScan* workers{nullptr};
+
+  DuluxLabColumns columns() const {
+    return {column_l.data(), column_a.data(), column_b.data(), column_chroma.data()};
+  }
+
+  // One search, shared by the shards working on it
+  struct Query {
+    CIEDE2000::LAB lab;
+    uint8_t r, g, b;
+    bool light;
+    size_t start;  // First entry at or above the target's L*
+    DuluxLabBoundTarget bound;
+    DuluxScanShard seed;              // Scored before the shards start
+    std::atomic<float> shared_best;   // Best distance any shard has found, for pruning only
+    DuluxExactScanStats work[DULUX_PARALLEL_MAX_SHARDS];  // Per shard
+  };
+
+  float distanceTo(const Query& query, size_t position) const {
+    const Entry& entry = entries[position];
+    DuluxLabFixed const LAB{column_l[position], column_a[position], column_b[position]};
+    return duluxCandidateDistance(query.r, query.g, query.b, query.lab, entry.r, entry.g,
+                                  entry.b, duluxLabFromFixed(LAB));
+  }
+
+  /**
+   * Shard `shard` of `shards` takes every shards-th light candidate and every
+   * shards-th block on each side of the L* window, counted outward from the
+   * target. Its blocks on a side are ever further in L*, so a side is done
+   * for the shard once its next block's nearest entry is out of reach. The
+   * limit is the best distance of all shards, which only tightens the bound.
+   */
+  DuluxScanShard scanShard(Query& query, uint32_t shard, uint32_t shards) const {
+    DuluxExactScanStats& work = query.work[shard];
+    DuluxScanShard best = query.seed;
+
+    auto score = [&](size_t position) {
+      DuluxScanShard const CANDIDATE{entries[position].index, distanceTo(query, position)};
+      work.evaluated++;
+      if (CANDIDATE.isBetterThan(best)) {
+        best = CANDIDATE;
+        float shared = query.shared_best.load(std::memory_order_relaxed);
+        while (best.distance < shared &&
+               !query.shared_best.compare_exchange_weak(shared, best.distance,
+                                                        std::memory_order_relaxed)) {
+        }
+      }
+    };
+
+    // Light pairs are ranked by RGB distance, which the L* window cannot bound
+    if (query.light) {
+      for (size_t i = shard; i < light_entries.size(); i += shards) {
+        score(light_entries[i]);
+        work.window++;
+      }
+    }
+
+    // Widen an L* window around the target a block at a time, always on the closer side
+    size_t const BLOCK_STEP = (size_t)DULUX_LAB_LANES * shards;
+    size_t below = shard * (size_t)DULUX_LAB_LANES;  // Next block below ends this far under start
+    size_t above = query.start + below;              // Next block above starts here
+    float const SCALE = 1.0f / DULUX_LAB_FIXED_SCALE;
+    DuluxLabColumns const COLUMNS = columns();
+
+    while (below < query.start || above < entries.size()) {
+      float const DL_BELOW = below < query.start
+                                 ? fabsf(query.lab.l - (column_l[query.start - below - 1] * SCALE))
+                                 : INFINITY;
+      float const DL_ABOVE =
+          above < entries.size() ? fabsf((column_l[above] * SCALE) - query.lab.l) : INFINITY;
+      bool const TAKE_BELOW = DL_BELOW <= DL_ABOVE;
+      float const DL = TAKE_BELOW ? DL_BELOW : DL_ABOVE;
+
+      // Everything further out in L* is at least this far away
+      float const SHARED = query.shared_best.load(std::memory_order_relaxed);
+      float const LIMIT = std::min(best.distance, SHARED) + DULUX_EXACT_BOUND_SLACK;
+      if (DL / DULUX_EXACT_SL_MAX > LIMIT) {
+        break;
+      }
+
+      // Entries of the block past that point fail the bound below as well
+      size_t const FIRST =
+          TAKE_BELOW ? query.start - std::min(query.start, below + DULUX_LAB_LANES) : above;
+      size_t const END =
+          TAKE_BELOW ? query.start - below : std::min(entries.size(), above + DULUX_LAB_LANES);
+      if (TAKE_BELOW) {
+        below += BLOCK_STEP;
+      } else {
+        above += BLOCK_STEP;
+      }
+      work.window += END - FIRST;
+
+      uint32_t mask = duluxLabBoundMask(COLUMNS, FIRST, END - FIRST, query.bound, LIMIT * LIMIT);
+      while (mask != 0) {
+        size_t const POSITION = FIRST + __builtin_ctz(mask);
+        mask &= mask - 1;
+        if (query.light && entries[POSITION].light) {
+          continue;  // Already scored by RGB distance
+        }
+        score(POSITION);
+      }
+    }
+    return best;
+  }
+
+ public:
+  DuluxExactScan() = default;
+  DuluxExactScan(const DuluxExactScan&) = delete;
+  DuluxExactScan& operator=(const DuluxExactScan&) = delete;
+
+  /**
+   * @brief Build the L*-sorted table
+   * @param fetch Callable bool(uint32_t index, uint8_t& r, uint8_t& g, uint8_t& b,
+   *        DuluxLabFixed& lab) returning one palette entry
+   */
+  template <typename Fetch>
+  bool build(uint32_t color_count, Fetch fetch) {
+    unsigned long const START_TIME = millis();
+    clear();
+    if (color_count == 0 || color_count > DULUX_EXACT_MAX_COLORS) {
+      Serial.printf("[ExactScan] Unsupported palette size %u\n", (unsigned)color_count);
+      return false;
+    }
+
+    // Read row by row and sort, then split into the columns
+    struct Row {
+      Entry entry;
+      DuluxLabFixed lab;
+    };
+    Column<Row> rows;
+    try {
+      rows.reserve(color_count);
+      entries.reserve(color_count);
+      column_l.reserve(color_count);
+      column_a.reserve(color_count);
+      column_b.reserve(color_count);
+      column_chroma.reserve(color_count);
+      positions.resize(color_count);
+    } catch (const std::exception& e) {
+      Serial.printf("[ExactScan] Error allocating table: %s\n", e.what());
+      clear();
+      return false;
+    }
+    for (uint32_t i = 0; i < color_count; i++) {
+      Row row{};
+      if (!fetch(i, row.entry.r, row.entry.g, row.entry.b, row.lab)) {
+        Serial.printf("[ExactScan] Cannot read palette entry %u\n", (unsigned)i);
+        clear();
+        return false;
+      }
+      row.entry.index = (uint16_t)i;
+      row.entry.light = row.entry.r > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+                        row.entry.g > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+                        row.entry.b > DULUX_LIGHT_CHANNEL_THRESHOLD;
+      rows.push_back(row);
+    }
+
+    // Stable, so equal L* keeps palette order
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const Row& x, const Row& y) { return x.lab.l < y.lab.l; });
+    for (size_t i = 0; i < rows.size(); i++) {
+      const Row& row = rows[i];
+      entries.push_back(row.entry);
+      column_l.push_back(row.lab.l);
+      column_a.push_back(row.lab.a);
+      column_b.push_back(row.lab.b);
+      // Rounded up: a larger C* only weakens the bound
+      column_chroma.push_back((uint16_t)ceilf(hypotf(row.lab.a, row.lab.b)));
+      positions[row.entry.index] = (uint16_t)i;
+      if (row.entry.light) {
+        light_entries.push_back((uint16_t)i);
+      }
+    }
+
+    built = true;
+    Serial.printf("[ExactScan] Sorted %u colors (%u light) in %lu ms, %u KB PSRAM\n",
+                  (unsigned)entries.size(), (unsigned)light_entries.size(),
+                  millis() - START_TIME, (unsigned)(getMemoryUsage() / 1024));
+    return true;
+  }
+
+  void clear() {
+    entries.clear();
+    column_l.clear();
+    column_a.clear();
+    column_b.clear();
+    column_chroma.clear();
+    light_entries.clear();
+    positions.clear();
+    built = false;
+  }
+
+  /**
+   * @brief Empty the index and return its storage to the heap
+   */
+  void release() {
+    clear();
+    entries.shrink_to_fit();
+    column_l.shrink_to_fit();
+    column_a.shrink_to_fit();
+    column_b.shrink_to_fit();
+    column_chroma.shrink_to_fit();
+    light_entries.shrink_to_fit();
+    positions.shrink_to_fit();
+  }
+
+  /**
+   * @brief Exact closest palette entry under the shared metric
+   * @param distance_out Receives the winning distance (optional)
+   * @param stats Receives the amount of work done (optional)
+   * @param seed Palette index likely to be close (e.g. a lookup table hint); scoring it
+   *        first tightens the bounds from the start. Does not change the result.
+   * @return Palette index of the best match, or getColorCount() if not built
+   */
+  uint32_t findClosest(uint8_t r, uint8_t g, uint8_t b, float* distance_out = nullptr,
+                       DuluxExactScanStats* stats = nullptr,
+                       uint32_t seed = DULUX_EXACT_NO_SEED) const {
+    CIEDE2000::LAB target_lab;
+    rgbToLAB(r, g, b, target_lab);
+    return findClosest(target_lab, r, g, b, distance_out, stats, seed);
+  }
+
+  /**
+   * @brief Same, for a target given in L*a*b* (r, g, b only decide whether it is light)
+   */
+  uint32_t findClosest(const CIEDE2000::LAB& target_lab, uint8_t r, uint8_t g, uint8_t b,
+                       float* distance_out = nullptr, DuluxExactScanStats* stats = nullptr,
+                       uint32_t seed = DULUX_EXACT_NO_SEED) const {
+    if (!built) {
+      return entries.size();
+    }
+
+    Query query{};
+    query.lab = target_lab;
+    query.r = r;
+    query.g = g;
+    query.b = b;
+    query.light = r > DULUX_LIGHT_CHANNEL_THRESHOLD && g > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+                  b > DULUX_LIGHT_CHANNEL_THRESHOLD;
+    int16_t const TARGET_L = duluxLabToFixed(target_lab).l;
+    query.start =
+        std::lower_bound(column_l.begin(), column_l.end(), TARGET_L) - column_l.begin();
+    query.bound = {(float)target_lab.l,
+                   (float)target_lab.a,
+                   (float)target_lab.b,
+                   hypotf(target_lab.a, target_lab.b),
+                   1.0f / DULUX_EXACT_SL_MAX,
+                   DULUX_EXACT_CROSS_FLOOR,
+                   DULUX_EXACT_SC_SLOPE};
+    query.seed = {(uint32_t)entries.size(), 999999.0f};
+    uint32_t seed_evaluated = 0;
+    if (seed < entries.size()) {
+      // Scored again in the window; ties keep the same index
+      query.seed = {seed, distanceTo(query, positions[seed])};
+      seed_evaluated = 1;
+    }
+    query.shared_best.store(query.seed.distance, std::memory_order_relaxed);
+
+    auto const SHARD = [this, &query](uint32_t shard, uint32_t shards) {
+      return scanShard(query, shard, shards);
+    };
+    DuluxScanShard const BEST = workers ? workers->scan(entries.size(), SHARD) : SHARD(0, 1);
+
+    if (distance_out) {
+      *distance_out = BEST.distance;
+    }
+    if (stats) {
+      *stats = {0, seed_evaluated};
+      for (const DuluxExactScanStats& work : query.work) {
+        stats->window += work.window;
+        stats->evaluated += work.evaluated;
+      }
+    }
+    return BEST.index;
+  }
+
+  /**
+   * @brief Split later searches across these workers (nullptr: search on the caller alone)
+   */
+  void setWorkers(DuluxParallelScan* scan_workers) {
+    workers = scan_workers;
+  }
+
+  bool isBuilt() const {
+    return built;
+  }
+  uint32_t getColorCount() const {
+    return entries.size();
+  }
+  size_t getMemoryUsage() const {
+    return (entries.size() * (sizeof(Entry) + (4 * sizeof(int16_t)))) +
+           ((light_entries.size() + positions.size()) * sizeof(uint16_t));
+  }
+};
+
+#endif  // DULUX_EXACT_SCAN_H
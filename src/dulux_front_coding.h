@@ -0,0 +1,141 @@
+/**
+ * @file dulux_front_coding.h
+ * @brief Decoder for the front-coded v2 name/code sections (FCNM, FCCD)
+ *
+ * Distinct strings are sorted bytewise and split into buckets of
+ * bucket_size. The first string of a bucket is stored whole, every later
+ * one as (shared prefix length, suffix). Palette names share long prefixes
+ * ("White ...", "... Half", collection names) and codes even more so.
+ *
+ * Section layout (all offsets relative to the section start):
+ * - DuluxFrontCodedHeader (16 bytes)
+ * - uint16_t ordinal[color_count]: string number of each color
+ * - padding to 4 bytes
+ * - uint32_t bucket_offset[bucket_count]: offset of each bucket in the data
+ * - data: per string u8 prefix_length, u8 suffix_length, suffix bytes
+ *
+ * Decoding one string touches one ordinal, one bucket offset and at most one
+ * bucket, so only the names of returned matches are ever expanded. Reads go
+ * through a caller-supplied fetch function so the same code serves mapped
+ * flash, PSRAM and LittleFS files.
+ *
+ * Portable (no Arduino dependency): the palette compiler uses it too.
+ */
+
+#ifndef DULUX_FRONT_CODING_H
+#define DULUX_FRONT_CODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dulux_palette_format.h"
+
+#define DULUX_FRONT_CODED_BUCKET 16     // Strings per bucket written by the compiler
+#define DULUX_FRONT_CODED_MAX_LENGTH 255  // Longest string a bucket entry can hold
+
+/**
+ * @brief Offsets of the parts of a front-coded section
+ */
+struct DuluxFrontCodedLayout {
+  DuluxFrontCodedHeader header;
+  uint32_t ordinals;  // Offset of the ordinal column
+  uint32_t buckets;   // Offset of the bucket offset table
+  uint32_t data;      // Offset of the bucket data
+  uint32_t bucket_count;
+};
+
+/**
+ * @brief Compute and validate the layout of a front-coded section
+ * @param header Header read from the start of the section
+ * @param section_size Size of the section in bytes
+ * @param color_count Colors in the palette (must match the ordinal column)
+ * @return true if every part lies inside the section
+ */
+inline bool duluxFrontCodedLayout(const DuluxFrontCodedHeader& header, uint32_t section_size,
+                                  uint32_t color_count, DuluxFrontCodedLayout& layout) {
+  if (header.color_count != color_count || header.bucket_size == 0 ||
+      header.string_count > UINT16_MAX + 1U) {
+    return false;
+  }
+  layout.header = header;
+  layout.bucket_count = (header.string_count + header.bucket_size - 1) / header.bucket_size;
+  layout.ordinals = sizeof(DuluxFrontCodedHeader);
+  uint64_t const BUCKETS = (layout.ordinals + (2ULL * color_count) + 3) & ~3ULL;
+  uint64_t const DATA = BUCKETS + (4ULL * layout.bucket_count);
+  if (DATA + header.data_size > section_size) {
+    return false;
+  }
+  layout.buckets = (uint32_t)BUCKETS;
+  layout.data = (uint32_t)DATA;
+  return true;
+}
+
+/**
+ * @brief Decode the string of one color
+ * @param fetch bool(uint32_t offset, void* dest, size_t length) reading from the section
+ * @param out Caller buffer; truncated (always NUL-terminated) if too small
+ * @return Full length of the string, or -1 on malformed data
+ */
+template <typename Fetch>
+int duluxFrontCodedDecode(Fetch&& fetch, const DuluxFrontCodedLayout& layout,
+                          uint32_t color_index, char* out, size_t out_size) {
+  if (out_size == 0) {
+    return -1;
+  }
+  out[0] = '\0';
+
+  uint16_t ordinal = 0;
+  if (color_index >= layout.header.color_count ||
+      !fetch(layout.ordinals + (color_index * 2), &ordinal, 2) ||
+      ordinal >= layout.header.string_count) {
+    return -1;
+  }
+
+  uint32_t const BUCKET = ordinal / layout.header.bucket_size;
+  uint32_t const SLOT = ordinal % layout.header.bucket_size;
+  uint32_t position = 0;
+  if (!fetch(layout.buckets + (BUCKET * 4), &position, 4)) {
+    return -1;
+  }
+
+  // Walk the bucket; each entry rewrites the tail of the previous string
+  char scratch[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+  uint32_t length = 0;
+  for (uint32_t i = 0; i <= SLOT; i++) {
+    uint8_t lengths[2];
+    if (position + 2 > layout.header.data_size ||
+        !fetch(layout.data + position, lengths, 2)) {
+      return -1;
+    }
+    uint32_t const PREFIX = lengths[0];
+    uint32_t const SUFFIX = lengths[1];
+    if (PREFIX > length || PREFIX + SUFFIX > DULUX_FRONT_CODED_MAX_LENGTH ||
+        position + 2 + SUFFIX > layout.header.data_size ||
+        (SUFFIX > 0 && !fetch(layout.data + position + 2, scratch + PREFIX, SUFFIX))) {
+      return -1;
+    }
+    length = PREFIX + SUFFIX;
+    position += 2 + SUFFIX;
+  }
+
+  size_t const COPY = length < out_size - 1 ? length : out_size - 1;
+  memcpy(out, scratch, COPY);
+  out[COPY] = '\0';
+  return (int)length;
+}
+
+/**
+ * @brief Decode from a section held in addressable memory (flash map, PSRAM)
+ */
+inline int duluxFrontCodedDecode(const uint8_t* section, const DuluxFrontCodedLayout& layout,
+                                 uint32_t color_index, char* out, size_t out_size) {
+  return duluxFrontCodedDecode(
+      [section](uint32_t offset, void* dest, size_t length) {
+        memcpy(dest, section + offset, length);
+        return true;
+      },
+      layout, color_index, out, out_size);
+}
+
+#endif  // DULUX_FRONT_CODING_H
@@ -0,0 +1,155 @@
+/**
+ * @file dulux_lab_kernel.h
+ * @brief Weighted squared L*a*b* distance for a block of palette entries at once
+ *
+ * Palette entries are read from structure-of-arrays columns (L*, a*, b*, C*,
+ * fixed point * 100), so one step loads DULUX_LAB_LANES consecutive values
+ * of each column. Each entry's
+ *
+ *   (w_L dL)^2 + w_ab (da^2 + db^2) / (1 + k (C_target + C_entry))^2
+ *
+ * is compared with a limit, and the result is a bit mask of the entries at
+ * or under it. With unit weights and k = 0 this is squared dE76; the exact
+ * scan uses it with its CIEDE2000 lower-bound weights as a prefilter.
+ *
+ * duluxLabBoundMaskScalar() is the reference. Where the compiler targets a
+ * SIMD unit it can reach through GCC/Clang vector extensions (SSE2, NEON,
+ * WASM SIMD), duluxLabBoundMask() uses the vector version, otherwise the
+ * scalar one; both do the same float operations per entry. Predefine
+ * DULUX_LAB_KERNEL_VECTOR to 0 or 1 to override the choice. The header has no
+ * Arduino dependency, so firmware and host tools share it.
+ */
+
+#ifndef DULUX_LAB_KERNEL_H
+#define DULUX_LAB_KERNEL_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dulux_palette_format.h"
+
+#define DULUX_LAB_LANES 16  // Entries per kernel step (bits of the returned mask)
+
+#ifndef DULUX_LAB_KERNEL_VECTOR
+  #if (defined(__SSE2__) || defined(__ARM_NEON) || defined(__wasm_simd128__)) && \
+      (defined(__clang__) || __GNUC__ >= 9)
+    #define DULUX_LAB_KERNEL_VECTOR 1
+  #else
+    #define DULUX_LAB_KERNEL_VECTOR 0  // e.g. Xtensa: vector types would become scalar code
+  #endif
+#endif
+
+/**
+ * @brief Palette columns in fixed point (value * DULUX_LAB_FIXED_SCALE), one slot per entry
+ */
+struct DuluxLabColumns {
+  const int16_t* l;
+  const int16_t* a;
+  const int16_t* b;
+  const uint16_t* chroma;  // C*; unused when chroma_slope is 0
+};
+
+/**
+ * @brief Target color and weights of a kernel call
+ */
+struct DuluxLabBoundTarget {
+  float l, a, b;       // Target L*a*b* in units
+  float chroma;        // Target C*
+  float l_weight;      // w_L
+  float ab_weight;     // w_ab
+  float chroma_slope;  // k, per unit of C*
+};
+
+/**
+ * @brief Reference kernel
+ * @param count Entries from start to test, at most DULUX_LAB_LANES
+ * @return Bit i set if entry start + i is within limit_squared
+ */
+inline uint32_t duluxLabBoundMaskScalar(const DuluxLabColumns& columns, uint32_t start,
+                                        uint32_t count, const DuluxLabBoundTarget& target,
+                                        float limit_squared) {
+  float const SCALE = 1.0f / DULUX_LAB_FIXED_SCALE;
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    float const L_TERM = (target.l - (columns.l[start + i] * SCALE)) * target.l_weight;
+    float const DA = target.a - (columns.a[start + i] * SCALE);
+    float const DB = target.b - (columns.b[start + i] * SCALE);
+    float const CHROMA_SUM = target.chroma + (columns.chroma[start + i] * SCALE);
+    float const SC = 1.0f + (target.chroma_slope * CHROMA_SUM);
+    float const BOUND =
+        (L_TERM * L_TERM) + (target.ab_weight * ((DA * DA) + (DB * DB)) / (SC * SC));
+    if (BOUND <= limit_squared) {
+      mask |= 1U << i;
+    }
+  }
+  return mask;
+}
+
+#if DULUX_LAB_KERNEL_VECTOR
+static_assert(DULUX_LAB_LANES == 16, "duluxLabBoundMaskVector() spells out 16 lane bits");
+
+typedef float DuluxLabLaneFloats __attribute__((vector_size(DULUX_LAB_LANES * sizeof(float))));
+typedef int32_t DuluxLabLaneInts __attribute__((vector_size(DULUX_LAB_LANES * sizeof(int32_t))));
+typedef int16_t DuluxLabLaneShorts
+    __attribute__((vector_size(DULUX_LAB_LANES * sizeof(int16_t))));
+typedef uint16_t DuluxLabLaneUShorts
+    __attribute__((vector_size(DULUX_LAB_LANES * sizeof(uint16_t))));
+
+/**
+ * @brief Vector kernel for one full block of DULUX_LAB_LANES entries; same mask as the reference
+ */
+inline uint32_t duluxLabBoundMaskVector(const DuluxLabColumns& columns, uint32_t start,
+                                        const DuluxLabBoundTarget& target, float limit_squared) {
+  // Columns carry no alignment guarantee, so lanes are loaded with memcpy
+  DuluxLabLaneShorts l_lanes, a_lanes, b_lanes;
+  DuluxLabLaneUShorts chroma_lanes;
+  memcpy(&l_lanes, columns.l + start, sizeof(l_lanes));
+  memcpy(&a_lanes, columns.a + start, sizeof(a_lanes));
+  memcpy(&b_lanes, columns.b + start, sizeof(b_lanes));
+  memcpy(&chroma_lanes, columns.chroma + start, sizeof(chroma_lanes));
+
+  float const SCALE = 1.0f / DULUX_LAB_FIXED_SCALE;
+  DuluxLabLaneFloats const L = __builtin_convertvector(l_lanes, DuluxLabLaneFloats);
+  DuluxLabLaneFloats const A = __builtin_convertvector(a_lanes, DuluxLabLaneFloats);
+  DuluxLabLaneFloats const B = __builtin_convertvector(b_lanes, DuluxLabLaneFloats);
+  DuluxLabLaneFloats const CHROMA = __builtin_convertvector(chroma_lanes, DuluxLabLaneFloats);
+
+  DuluxLabLaneFloats const L_TERM = (target.l - (L * SCALE)) * target.l_weight;
+  DuluxLabLaneFloats const DA = target.a - (A * SCALE);
+  DuluxLabLaneFloats const DB = target.b - (B * SCALE);
+  DuluxLabLaneFloats const CHROMA_SUM = target.chroma + (CHROMA * SCALE);
+  DuluxLabLaneFloats const SC = 1.0f + (target.chroma_slope * CHROMA_SUM);
+  DuluxLabLaneFloats const BOUND =
+      (L_TERM * L_TERM) + (target.ab_weight * ((DA * DA) + (DB * DB)) / (SC * SC));
+  // limit - bound is +0 or positive exactly when bound <= limit; its sign bit says which.
+  // A float vector comparison would be split into one scalar compare per lane
+  DuluxLabLaneInts const PRUNED = ((DuluxLabLaneInts)(limit_squared - BOUND)) >> 31;
+  DuluxLabLaneInts const LANE_BITS = {1 << 0,  1 << 1,  1 << 2,  1 << 3,  1 << 4,  1 << 5,
+                                      1 << 6,  1 << 7,  1 << 8,  1 << 9,  1 << 10, 1 << 11,
+                                      1 << 12, 1 << 13, 1 << 14, 1 << 15};
+  DuluxLabLaneInts const KEPT = ~PRUNED & LANE_BITS;
+
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < DULUX_LAB_LANES; i++) {
+    mask |= (uint32_t)KEPT[i];
+  }
+  return mask;
+}
+#endif
+
+/**
+ * @brief Kernel selected for this target; partial blocks use the reference
+ * @param count Entries from start to test, at most DULUX_LAB_LANES
+ * @return Bit i set if entry start + i is within limit_squared
+ */
+inline uint32_t duluxLabBoundMask(const DuluxLabColumns& columns, uint32_t start, uint32_t count,
+                                  const DuluxLabBoundTarget& target, float limit_squared) {
+#if DULUX_LAB_KERNEL_VECTOR
+  if (count == DULUX_LAB_LANES) {
+    return duluxLabBoundMaskVector(columns, start, target, limit_squared);
+  }
+#endif
+  return duluxLabBoundMaskScalar(columns, start, count, target, limit_squared);
+}
+
+#endif  // DULUX_LAB_KERNEL_H
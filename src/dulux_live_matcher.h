@@ -0,0 +1,105 @@
+/**
+ * @file dulux_live_matcher.h
+ * @brief Incremental palette matching for a stream of live readings
+ *
+ * Smoothed sensor readings barely move from one loop to the next, so the
+ * candidates the KD-tree gathered for the previous reading (its winner and
+ * the runners-up re-ranked with it) are usually still the nearest points.
+ * LightweightKDTree::findNearestIncremental() proves that from how far the
+ * reading moved and only re-ranks them; the tree is walked again once the
+ * reading leaves that neighbourhood. A reading identical to the previous
+ * one is answered without any work. Every answer is the one findNearest()
+ * gives.
+ */
+
+#ifndef DULUX_LIVE_MATCHER_H
+#define DULUX_LIVE_MATCHER_H
+
+#include <Arduino.h>
+
+#include "lightweight_kdtree.h"
+
+/**
+ * @brief Counters since the last reset
+ */
+struct DuluxLiveMatcherStats {
+  uint32_t searches;   // Readings matched
+  uint32_t unchanged;  // Same RGB as the previous reading, answered without a search
+  uint32_t reused;     // Previous candidates proven still nearest, re-ranked without a walk
+  uint32_t walked;     // Full KD-tree walks
+  uint32_t visited;    // KD-tree points examined, all walks together
+  uint32_t switched;   // Readings whose paint differs from the previous reading's
+};
+
+class DuluxLiveMatcher {
+ private:
+  KDTreeNeighbourhood hood{};
+  ColorPoint last_match;
+  float last_distance{0.0f};
+  bool has_match{false};
+  uint8_t last_r{0}, last_g{0}, last_b{0};
+  DuluxLiveMatcherStats stats{0, 0, 0, 0, 0, 0};
+
+ public:
+  /**
+   * @brief Best match for the next reading, as LightweightKDTree::findNearest() gives it
+   * @param distance_out Receives the match distance (optional)
+   * @return false if the tree is not built or empty
+   */
+  bool match(const LightweightKDTree& tree, uint8_t r, uint8_t g, uint8_t b, ColorPoint& best,
+             float* distance_out = nullptr) {
+    stats.searches++;
+    if (has_match && r == last_r && g == last_g && b == last_b) {
+      stats.unchanged++;
+      best = last_match;
+      if (distance_out) {
+        *distance_out = last_distance;
+      }
+      return true;
+    }
+
+    ColorPoint found;
+    float distance = 0.0f;
+    bool const FOUND =
+        tree.findNearestIncremental(r, g, b, KDTREE_ALL_BRANDS, hood, found, &distance);
+    if (hood.visited > 0) {
+      stats.walked++;
+      stats.visited += hood.visited;
+    } else if (FOUND) {
+      stats.reused++;
+    }
+    if (!FOUND) {
+      reset();
+      return false;
+    }
+
+    if (has_match && found.getIndex() != last_match.getIndex()) {
+      stats.switched++;
+    }
+    last_match = found;
+    last_distance = distance;
+    has_match = true;
+    last_r = r;
+    last_g = g;
+    last_b = b;
+    best = found;
+    if (distance_out) {
+      *distance_out = distance;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Forget the previous reading (call when the tree is rebuilt)
+   */
+  void reset() {
+    hood.valid = false;
+    has_match = false;
+  }
+
+  const DuluxLiveMatcherStats& getStats() const {
+    return stats;
+  }
+};
+
+#endif  // DULUX_LIVE_MATCHER_H
@@ -0,0 +1,182 @@
+/**
+ * @file dulux_match_cache.h
+ * @brief Fixed-size cache of recent matches, keyed on quantized L*a*b*
+ *
+ * Rescanning the same wall or swatch produces readings that differ by sensor
+ * noise only. Keys round the target's L*a*b* to DULUX_MATCH_CACHE_LAB_STEP,
+ * so those readings share one entry and skip the search; a cached answer is
+ * then the best match for a color at most half a cell diagonal (0.22 dE76)
+ * away. The key also carries the light-pair flag of the shared metric and a
+ * palette generation, so answers for another palette never hit.
+ *
+ * Entries live in DULUX_MATCH_CACHE_SHARDS independent shards chosen by key
+ * hash, each with its own CLOCK hand and spin flag. A shard that another task
+ * holds is treated as a miss rather than waited for, so the cache never
+ * blocks a web handler or the main loop. Nothing is allocated after
+ * construction.
+ */
+
+#ifndef DULUX_MATCH_CACHE_H
+#define DULUX_MATCH_CACHE_H
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <cmath>
+
+#include "CIEDE2000.h"
+#include "dulux_match_metric.h"
+
+#define DULUX_MATCH_CACHE_SHARDS 4        // Independent shards, each with its own lock
+#define DULUX_MATCH_CACHE_SLOTS 64        // Entries per shard
+#define DULUX_MATCH_CACHE_LAB_STEP 0.25f  // Quantization of L*, a* and b* in keys
+#define DULUX_MATCH_CACHE_GENERATIONS 0x3FFFU  // Palette generations distinguished in keys
+
+/**
+ * @brief Counters since construction
+ */
+struct DuluxMatchCacheStats {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t evictions;  // Entries replaced to make room
+  uint32_t busy;       // Lookups or inserts skipped because the shard was in use
+};
+
+class DuluxMatchCache {
+ private:
+  struct Slot {
+    uint64_t key;  // 0 when empty
+    uint32_t index;
+    float distance;
+    bool referenced;  // CLOCK bit: set on a hit, cleared as the hand passes
+  };
+
+  struct Shard {
+    Slot slots[DULUX_MATCH_CACHE_SLOTS];
+    uint8_t hand;
+    std::atomic_flag lock = ATOMIC_FLAG_INIT;
+  };
+
+  Shard shards[DULUX_MATCH_CACHE_SHARDS]{};
+  std::atomic<uint32_t> hits{0};
+  std::atomic<uint32_t> misses{0};
+  std::atomic<uint32_t> evictions{0};
+  std::atomic<uint32_t> busy{0};
+
+  static int32_t quantize(double value) {
+    return (int32_t)lround(value / DULUX_MATCH_CACHE_LAB_STEP);
+  }
+
+  Shard& shardFor(uint64_t key) {
+    // Fibonacci hashing spreads neighbouring cells over the shards
+    return shards[((key * 0x9E3779B97F4A7C15ULL) >> 61) % DULUX_MATCH_CACHE_SHARDS];
+  }
+
+  // Find the key in the shard; the caller holds its lock
+  static Slot* find(Shard& shard, uint64_t key) {
+    for (Slot& slot : shard.slots) {
+      if (slot.key == key) {
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+
+ public:
+  DuluxMatchCache() = default;
+  DuluxMatchCache(const DuluxMatchCache&) = delete;
+  DuluxMatchCache& operator=(const DuluxMatchCache&) = delete;
+
+  /**
+   * @brief Key of a target color
+   * @param generation Identifies the palette the answer belongs to (0 = main palette)
+   */
+  static uint64_t keyFor(const CIEDE2000::LAB& lab, uint8_t r, uint8_t g, uint8_t b,
+                         uint32_t generation) {
+    bool const LIGHT = r > DULUX_LIGHT_CHANNEL_THRESHOLD && g > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+                       b > DULUX_LIGHT_CHANNEL_THRESHOLD;
+    // Bit 63 marks a used slot; 14 bits of generation; light flag; 16 bits per axis
+    return (1ULL << 63) | ((uint64_t)(generation & DULUX_MATCH_CACHE_GENERATIONS) << 49) |
+           ((uint64_t)LIGHT << 48) | ((uint64_t)(uint16_t)quantize(lab.l) << 32) |
+           ((uint64_t)(uint16_t)quantize(lab.a) << 16) | (uint64_t)(uint16_t)quantize(lab.b);
+  }
+
+  static uint64_t keyFor(uint8_t r, uint8_t g, uint8_t b, uint32_t generation) {
+    CIEDE2000::LAB lab;
+    rgbToLAB(r, g, b, lab);
+    return keyFor(lab, r, g, b, generation);
+  }
+
+  /**
+   * @brief Cached answer for a key
+   * @return false on a miss (index and distance are left unchanged)
+   */
+  bool lookup(uint64_t key, uint32_t& index, float& distance) {
+    Shard& shard = shardFor(key);
+    if (shard.lock.test_and_set(std::memory_order_acquire)) {
+      busy.fetch_add(1, std::memory_order_relaxed);
+      misses.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    Slot* const SLOT = find(shard, key);
+    if (SLOT) {
+      SLOT->referenced = true;
+      index = SLOT->index;
+      distance = SLOT->distance;
+    }
+    shard.lock.clear(std::memory_order_release);
+    (SLOT ? hits : misses).fetch_add(1, std::memory_order_relaxed);
+    return SLOT != nullptr;
+  }
+
+  /**
+   * @brief Store an answer, replacing the first unreferenced entry the CLOCK hand reaches
+   */
+  void insert(uint64_t key, uint32_t index, float distance) {
+    Shard& shard = shardFor(key);
+    if (shard.lock.test_and_set(std::memory_order_acquire)) {
+      busy.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    Slot* slot = find(shard, key);
+    if (!slot) {
+      // Every pass clears referenced bits, so this ends within two turns
+      while (shard.slots[shard.hand].referenced) {
+        shard.slots[shard.hand].referenced = false;
+        shard.hand = (shard.hand + 1) % DULUX_MATCH_CACHE_SLOTS;
+      }
+      slot = &shard.slots[shard.hand];
+      shard.hand = (shard.hand + 1) % DULUX_MATCH_CACHE_SLOTS;
+      if (slot->key != 0) {
+        evictions.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    *slot = {key, index, distance, false};
+    shard.lock.clear(std::memory_order_release);
+  }
+
+  /**
+   * @brief Drop every entry (palette reloaded in place)
+   */
+  void clear() {
+    for (Shard& shard : shards) {
+      while (shard.lock.test_and_set(std::memory_order_acquire)) {
+      }
+      for (Slot& slot : shard.slots) {
+        slot = {0, 0, 0.0f, false};
+      }
+      shard.hand = 0;
+      shard.lock.clear(std::memory_order_release);
+    }
+  }
+
+  DuluxMatchCacheStats getStats() const {
+    return {hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed),
+            evictions.load(std::memory_order_relaxed), busy.load(std::memory_order_relaxed)};
+  }
+  static constexpr size_t getCapacity() {
+    return DULUX_MATCH_CACHE_SHARDS * DULUX_MATCH_CACHE_SLOTS;
+  }
+};
+
+#endif  // DULUX_MATCH_CACHE_H
@@ -0,0 +1,57 @@
+/**
+ * @file dulux_match_metric.h
+ * @brief Distance used to rank palette candidates against a measured color
+ *
+ * Every search path (streaming reader, mapped palette, KD-tree re-ranking)
+ * must score candidates with the same function, otherwise the same reading
+ * can name a different paint depending on which path ran.
+ */
+
+#ifndef DULUX_MATCH_METRIC_H
+#define DULUX_MATCH_METRIC_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "CIEDE2000.h"
+
+#define DULUX_LIGHT_CHANNEL_THRESHOLD 200  // All channels above this = light color
+#define DULUX_EXCELLENT_LIGHT_DISTANCE 3.0f  // RGB distance that ends a search early
+#define DULUX_EXCELLENT_DELTA_E 1.0f         // CIEDE2000 distance that ends a search early
+
+/**
+ * @brief Check if both colors are light (potential whites)
+ */
+inline bool duluxIsLightPair(uint8_t target_r, uint8_t target_g, uint8_t target_b, uint8_t r,
+                             uint8_t g, uint8_t b) {
+  return target_r > DULUX_LIGHT_CHANNEL_THRESHOLD && target_g > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+         target_b > DULUX_LIGHT_CHANNEL_THRESHOLD && r > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+         g > DULUX_LIGHT_CHANNEL_THRESHOLD && b > DULUX_LIGHT_CHANNEL_THRESHOLD;
+}
+
+/**
+ * @brief Distance between a target and a palette candidate
+ *
+ * Simple RGB distance for whites/light colors (more accurate for close
+ * matches), CIEDE2000 for everything else.
+ */
+inline float duluxCandidateDistance(uint8_t target_r, uint8_t target_g, uint8_t target_b,
+                                    const CIEDE2000::LAB& target_lab, uint8_t r, uint8_t g,
+                                    uint8_t b, const CIEDE2000::LAB& candidate_lab) {
+  if (duluxIsLightPair(target_r, target_g, target_b, r, g, b)) {
+    auto const DR = (float)(target_r - r);
+    auto const DG = (float)(target_g - g);
+    auto const DB = (float)(target_b - b);
+    return sqrtf((DR * DR) + (DG * DG) + (DB * DB));
+  }
+  return (float)CIEDE2000::ciedE2000(target_lab, candidate_lab);
+}
+
+/**
+ * @brief Check whether a distance is good enough to stop an early-exit search
+ */
+inline bool duluxIsExcellentMatch(bool light_pair, float distance) {
+  return light_pair ? distance < DULUX_EXCELLENT_LIGHT_DISTANCE : distance < DULUX_EXCELLENT_DELTA_E;
+}
+
+#endif  // DULUX_MATCH_METRIC_H
@@ -0,0 +1,388 @@
+/**
+ * @file dulux_palette_arena.h
+ * @brief Bulk palette loader: whole dulux.bin in one PSRAM block, parsed in place
+ *
+ * The file is pulled in with a handful of large reads instead of several
+ * small reads per record, then parsed into a compact record table that lives
+ * in the same allocation. Names and codes are not copied: v1 strings are
+ * shifted one byte down over their length prefix and NUL-terminated in
+ * place, v2 strings already sit NUL-terminated in the string heap. Records
+ * refer to them by offset into the block. Front-coded v2 palettes keep their
+ * strings compressed and decode them on demand (copyName()/copyCode()).
+ *
+ * Block layout: [DuluxArenaRecord x color_count][file image]
+ */
+
+#ifndef DULUX_PALETTE_ARENA_H
+#define DULUX_PALETTE_ARENA_H
+
+#include <Arduino.h>
+
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+
+#include "CIEDE2000.h"
+#include "dulux_match_metric.h"
+#include "dulux_palette_format.h"
+#include "dulux_palette_view.h"
+
+#define DULUX_ARENA_READ_CHUNK 65536  // Bytes per LittleFS read while loading
+
+/**
+ * @brief Compact in-memory palette record
+ */
+struct DuluxArenaRecord {
+  uint8_t r, g, b;      // RGB values
+  uint8_t flags;        // DULUX_FLAG_* bits
+  uint16_t lrv_scaled;  // LRV * 100
+  DuluxLabFixed lab;    // Precomputed L*a*b* (fixed point)
+  uint32_t id;          // Color ID
+  uint32_t name;        // Offset of the NUL-terminated name in the block (0 = front-coded)
+  uint32_t code;        // Offset of the NUL-terminated code in the block (0 = front-coded)
+};
+
+/**
+ * @brief Load statistics reported after load()
+ */
+struct DuluxArenaStats {
+  uint32_t bytes_read;     // Bytes read from the file
+  uint32_t read_calls;     // Number of File::read() calls
+  uint32_t block_bytes;    // Size of the PSRAM allocation
+  unsigned long read_us;   // Time spent reading the file
+  unsigned long parse_us;  // Time spent building the record table
+};
+
+class DuluxPaletteArena {
+ private:
+  uint8_t* block{nullptr};
+  size_t block_size{0};
+  uint8_t* image{nullptr};  // File image inside block
+  size_t image_size{0};
+  DuluxArenaRecord* records{nullptr};
+  uint32_t color_count{0};
+  uint32_t format_version{0};
+  DuluxPaletteView view;  // v2 only: section access into the image
+  DuluxArenaStats stats{};
+  uint32_t palette_crc{0};
+
+  /**
+   * @brief Turn a v1 length-prefixed string into a C string in place
+   * @param pos Offset of the length byte inside the image, advanced past the string
+   * @return Block offset of the string, or 0 on truncation
+   */
+  uint32_t terminateV1String(size_t& pos) {
+    if (pos >= image_size) {
+      return 0;
+    }
+    uint8_t* prefix = image + pos;
+    uint8_t length = *prefix;
+    if (length == 255) {  // Written by older tools for "no string", nothing follows
+      length = 0;
+      pos += 1;
+    } else {
+      if (pos + 1 + length > image_size) {
+        return 0;
+      }
+      pos += 1 + length;
+    }
+    memmove(prefix, prefix + 1, length);
+    prefix[length] = '\0';  // Lands on the old last character (or the prefix when empty)
+    return (uint32_t)(prefix - block);
+  }
+
+  bool parseV1() {
+    size_t pos = DULUX_HEADER_SIZE;
+    for (uint32_t i = 0; i < color_count; i++) {
+      if (pos + DULUX_FIXED_FIELDS_SIZE > image_size) {
+        Serial.printf("[Arena] Truncated v1 record %u\n", i);
+        return false;
+      }
+      DuluxArenaRecord& rec = records[i];
+      const uint8_t* fixed = image + pos;
+      rec.r = fixed[0];
+      rec.g = fixed[1];
+      rec.b = fixed[2];
+      memcpy(&rec.lrv_scaled, fixed + 3, 2);
+      memcpy(&rec.id, fixed + 5, 4);
+      pos += DULUX_FIXED_FIELDS_SIZE;
+
+      rec.name = terminateV1String(pos);
+      rec.code = terminateV1String(pos);
+      if (rec.name == 0 || rec.code == 0 || pos >= image_size) {
+        Serial.printf("[Arena] Truncated v1 strings at record %u\n", i);
+        return false;
+      }
+      rec.flags = image[pos++] != 0 ? DULUX_FLAG_LIGHT_TEXT : 0;
+
+      CIEDE2000::LAB lab;
+      rgbToLAB(rec.r, rec.g, rec.b, lab);
+      rec.lab = duluxLabToFixed(lab);
+    }
+    return true;
+  }
+
+  static size_t copyInline(const char* str, char* out, size_t out_size) {
+    if (out_size == 0) {
+      return 0;
+    }
+    strncpy(out, str, out_size - 1);
+    out[out_size - 1] = '\0';
+    return strlen(out);
+  }
+
+  // Block offset of a string returned by the view (heap strings live inside the image)
+  uint32_t blockOffset(const char* str) const {
+    const auto* p = reinterpret_cast<const uint8_t*>(str);
+    return p >= image && p < image + image_size ? (uint32_t)(p - block) : 0;
+  }
+
+  bool parseV2() {
+    if (!view.attach(image, image_size)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < color_count; i++) {
+      DuluxArenaRecord& rec = records[i];
+      const uint8_t* rgb = view.rgb(i);
+      rec.r = rgb[0];
+      rec.g = rgb[1];
+      rec.b = rgb[2];
+      rec.flags = view.lightText(i) ? DULUX_FLAG_LIGHT_TEXT : 0;
+      rec.lrv_scaled = view.lrvScaled(i);
+      rec.lab = view.lab(i);
+      rec.id = view.id(i);
+      if (!view.hasInlineStrings()) {
+        rec.name = 0;
+        rec.code = 0;
+        continue;
+      }
+      rec.name = blockOffset(view.name(i));
+      rec.code = blockOffset(view.code(i));
+      if (rec.name == 0 || rec.code == 0) {
+        Serial.printf("[Arena] Invalid string offset at record %u\n", i);
+        return false;
+      }
+    }
+    return true;
+  }
+
+ public:
+  DuluxPaletteArena() = default;
+  DuluxPaletteArena(const DuluxPaletteArena&) = delete;
+  DuluxPaletteArena& operator=(const DuluxPaletteArena&) = delete;
+
+  ~DuluxPaletteArena() {
+    release();
+  }
+
+  /**
+   * @brief Read and parse a v1 or v2 palette file into PSRAM
+   */
+  bool load(const char* filename) {
+    release();
+    unsigned long const READ_START = micros();
+
+    File file = LittleFS.open(filename, "r");
+    if (!file) {
+      Serial.printf("[Arena] Cannot open %s\n", filename);
+      return false;
+    }
+
+    DuluxBinaryHeader header{};
+    size_t const FILE_SIZE = file.size();
+    stats.read_calls++;
+    if (FILE_SIZE < DULUX_HEADER_SIZE ||
+        file.read(reinterpret_cast<uint8_t*>(&header), DULUX_HEADER_SIZE) != DULUX_HEADER_SIZE ||
+        header.magic != DULUX_MAGIC_NUMBER || !duluxIsSupportedVersion(header.version)) {
+      Serial.printf("[Arena] %s is not a dulux.bin database\n", filename);
+      file.close();
+      return false;
+    }
+
+    // One allocation for the record table and the raw image
+    size_t const RECORD_BYTES = (size_t)header.color_count * sizeof(DuluxArenaRecord);
+    block_size = RECORD_BYTES + FILE_SIZE;
+    block = static_cast<uint8_t*>(heap_caps_malloc(block_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!block) {
+      Serial.printf("[Arena] Cannot allocate %u bytes of PSRAM\n", (unsigned)block_size);
+      file.close();
+      release();
+      return false;
+    }
+    records = reinterpret_cast<DuluxArenaRecord*>(block);
+    image = block + RECORD_BYTES;
+    image_size = FILE_SIZE;
+    memcpy(image, &header, DULUX_HEADER_SIZE);
+
+    size_t loaded = DULUX_HEADER_SIZE;
+    while (loaded < FILE_SIZE) {
+      size_t const WANT = std::min((size_t)DULUX_ARENA_READ_CHUNK, FILE_SIZE - loaded);
+      size_t const GOT = file.read(image + loaded, WANT);
+      stats.read_calls++;
+      if (GOT == 0) {
+        break;
+      }
+      loaded += GOT;
+    }
+    file.close();
+    stats.bytes_read = loaded;
+    stats.read_us = micros() - READ_START;
+
+    if (loaded != FILE_SIZE) {
+      Serial.printf("[Arena] Short read: %u of %u bytes\n", (unsigned)loaded, (unsigned)FILE_SIZE);
+      release();
+      return false;
+    }
+
+    unsigned long const PARSE_START = micros();
+    color_count = header.color_count;
+    format_version = header.version;
+    if (format_version == DULUX_BINARY_VERSION) {
+      // Before parsing: parseV1() rewrites the strings in place
+      uint32_t trailer_crc = 0;
+      bool const HAS_TRAILER =
+          image_size >= DULUX_HEADER_SIZE + sizeof(DuluxV1Trailer) &&
+          duluxParseV1Trailer(image + image_size - sizeof(DuluxV1Trailer), trailer_crc);
+      palette_crc = HAS_TRAILER ? trailer_crc : duluxCrc32(0, image, image_size);
+    }
+    bool const PARSED = format_version == DULUX_BINARY_VERSION ? parseV1() : parseV2();
+    if (PARSED && format_version == DULUX_BINARY_VERSION_V2) {
+      palette_crc = view.getPaletteCrc();
+    }
+    if (!PARSED) {
+      release();
+      return false;
+    }
+    stats.parse_us = micros() - PARSE_START;
+    stats.block_bytes = block_size;
+
+    Serial.printf("[Arena] %u colors (v%u): %u bytes in %u reads, read %luus, parse %luus, "
+                  "%u KB PSRAM\n",
+                  color_count, format_version, stats.bytes_read, stats.read_calls, stats.read_us,
+                  stats.parse_us, (unsigned)(block_size / 1024));
+    return true;
+  }
+
+  /**
+   * @brief Free the PSRAM block
+   */
+  void release() {
+    view.detach();
+    if (block) {
+      heap_caps_free(block);
+    }
+    block = nullptr;
+    block_size = 0;
+    image = nullptr;
+    image_size = 0;
+    records = nullptr;
+    color_count = 0;
+    format_version = 0;
+    palette_crc = 0;
+    stats = {};
+  }
+
+  bool isLoaded() const {
+    return block != nullptr;
+  }
+  uint32_t getColorCount() const {
+    return color_count;
+  }
+  uint32_t getFormatVersion() const {
+    return format_version;
+  }
+  const DuluxArenaStats& getStats() const {
+    return stats;
+  }
+  uint32_t getPaletteCrc() const {
+    return palette_crc;
+  }
+
+  // Record accessors - index must be below getColorCount()
+  const DuluxArenaRecord& record(uint32_t index) const {
+    return records[index];
+  }
+
+  /**
+   * @brief Check whether name()/code() can hand out pointers into the block
+   */
+  bool hasInlineStrings() const {
+    return format_version == DULUX_BINARY_VERSION || view.hasInlineStrings();
+  }
+
+  // In-block strings; nullptr for front-coded palettes (see copyName())
+  const char* name(uint32_t index) const {
+    uint32_t const OFFSET = records[index].name;
+    return OFFSET ? reinterpret_cast<const char*>(block + OFFSET) : nullptr;
+  }
+  const char* code(uint32_t index) const {
+    uint32_t const OFFSET = records[index].code;
+    return OFFSET ? reinterpret_cast<const char*>(block + OFFSET) : nullptr;
+  }
+
+  /**
+   * @brief Copy (front-coded palettes: decode) a name into a caller buffer
+   * @return Length written, excluding the terminator
+   */
+  size_t copyName(uint32_t index, char* out, size_t out_size) const {
+    return hasInlineStrings() ? copyInline(name(index), out, out_size)
+                              : view.copyName(index, out, out_size);
+  }
+  size_t copyCode(uint32_t index, char* out, size_t out_size) const {
+    return hasInlineStrings() ? copyInline(code(index), out, out_size)
+                              : view.copyCode(index, out, out_size);
+  }
+
+  /**
+   * @brief Locate an optional v2 section (META, KDT3, ...) in the loaded image
+   * @return Pointer to the payload, or nullptr for v1 files or absent sections
+   */
+  const uint8_t* section(uint32_t tag, uint32_t* size_out) const {
+    if (!view.isAttached()) {
+      *size_out = 0;
+      return nullptr;
+    }
+    return view.section(tag, size_out);
+  }
+
+  /**
+   * @brief Exhaustive scan over the record table with the shared match metric
+   * @param distance_out Receives the winning distance (optional)
+   * @return Index of the closest color, or getColorCount() if empty
+   */
+  uint32_t findClosest(uint8_t r, uint8_t g, uint8_t b, float* distance_out = nullptr) const {
+    CIEDE2000::LAB target_lab;
+    rgbToLAB(r, g, b, target_lab);
+
+    float best_distance = 0.0f;
+    uint32_t const BEST = findClosestInRange(0, color_count, r, g, b, target_lab, best_distance);
+    if (distance_out) {
+      *distance_out = best_distance;
+    }
+    return BEST;
+  }
+
+  /**
+   * @brief The same scan over records [lo, hi) only (one shard of DuluxParallelScan)
+   * @return Index of the closest record in the range, or getColorCount() if it is empty
+   */
+  uint32_t findClosestInRange(uint32_t lo, uint32_t hi, uint8_t r, uint8_t g, uint8_t b,
+                              const CIEDE2000::LAB& target_lab, float& best_distance) const {
+    uint32_t best_index = color_count;
+    best_distance = 999999.0f;
+
+    for (uint32_t i = lo; i < hi; i++) {
+      const DuluxArenaRecord& rec = records[i];
+      float const DISTANCE = duluxCandidateDistance(r, g, b, target_lab, rec.r, rec.g, rec.b,
+                                                    duluxLabFromFixed(rec.lab));
+      if (DISTANCE < best_distance) {
+        best_distance = DISTANCE;
+        best_index = i;
+      }
+    }
+    return best_index;
+  }
+};
+
+#endif  // DULUX_PALETTE_ARENA_H
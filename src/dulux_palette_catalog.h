@@ -0,0 +1,261 @@
+/**
+ * @file dulux_palette_catalog.h
+ * @brief Several paint palettes mounted side by side behind one search index
+ *
+ * Each palette is bulk-loaded into its own PSRAM arena and given a brand id
+ * (its mount slot). buildIndex() puts every color of every palette into a
+ * single KD-tree whose points carry that brand id, so a query for one brand,
+ * a subset of brands or all of them is answered by one traversal: the brand
+ * mask only decides which points may become the match.
+ *
+ * Matches are reported as (brand, index within that brand's palette), so the
+ * strings are decoded from the owning arena exactly as for a single palette.
+ *
+ * planKDTree() picks the index width from the combined color count: the
+ * compact 16-bit tree while it fits in 65,535 points, the 32-bit tree for
+ * larger catalogs, so every mounted color is always indexed.
+ *
+ * With filters, the index also carries each color's LRV and flags, so a
+ * query can ask for the nearest color within an LRV band or text style
+ * across any set of brands and skip subtrees with no such color.
+ */
+
+#ifndef DULUX_PALETTE_CATALOG_H
+#define DULUX_PALETTE_CATALOG_H
+
+#include <Arduino.h>
+
+#include <string.h>
+
+#include "dulux_palette_arena.h"
+#include "lightweight_kdtree.h"
+
+#define DULUX_CATALOG_MAX_PALETTES 8    // Palettes that can be mounted at once
+#define DULUX_CATALOG_BRAND_LENGTH 24   // Brand name buffer, including the NUL
+
+/**
+ * @brief Result of a catalog query
+ */
+struct DuluxCatalogMatch {
+  uint8_t brand;   // Mount slot of the palette the match came from
+  uint32_t index;  // Color index within that palette
+  float distance;  // Distance to the query (shared palette metric)
+};
+
+class DuluxPaletteCatalog {
+ private:
+  struct Entry {
+    char brand[DULUX_CATALOG_BRAND_LENGTH];
+    DuluxPaletteArena arena;
+  };
+
+  Entry entries[DULUX_CATALOG_MAX_PALETTES];
+  uint8_t palette_count{0};
+  uint32_t total_colors{0};
+  LightweightKDTree index;  // Used while the catalog fits 16-bit positions
+  WideKDTree wide_index;    // Used beyond that
+  bool wide{false};
+
+  // Brand-tagged points of every mounted palette, then the tree over them
+  template <typename Tree>
+  bool buildTree(Tree& tree, bool filters) {
+    typename Tree::PointVector points;
+    try {
+      points.reserve(total_colors);
+    } catch (const std::exception& e) {
+      Serial.printf("[Catalog] Error allocating index points: %s\n", e.what());
+      return false;
+    }
+    for (uint8_t brand = 0; brand < palette_count; brand++) {
+      const DuluxPaletteArena& arena = entries[brand].arena;
+      for (uint32_t i = 0; i < arena.getColorCount(); i++) {
+        const DuluxArenaRecord& record = arena.record(i);
+        points.push_back(typename Tree::Point(record.r, record.g, record.b, record.lab, i, brand));
+      }
+    }
+
+    if (!tree.build(points) || tree.getNodeCount() != total_colors) {
+      Serial.printf("[Catalog] Index covers %u of %u colors - rejecting partial index\n",
+                    (unsigned)tree.getNodeCount(), (unsigned)total_colors);
+      tree.clear();
+      return false;
+    }
+    if (filters) {
+      // Optional: without attributes the index still answers unfiltered queries
+      tree.attachAttributes([this](uint32_t i, uint8_t brand, KDTreeAttributes& attributes) {
+        const DuluxArenaRecord& record = entries[brand].arena.record(i);
+        attributes = {record.lrv_scaled, record.flags};
+        return true;
+      });
+    }
+    return true;
+  }
+
+  template <typename Tree>
+  static bool findIn(const Tree& tree, uint8_t r, uint8_t g, uint8_t b, uint32_t brand_mask,
+                     const KDTreeSearchOptions& options, DuluxCatalogMatch& match) {
+    typename Tree::Point best;
+    float distance = 0.0f;
+    if (!tree.findNearest(r, g, b, brand_mask, best, &distance, options)) {
+      return false;
+    }
+    match.brand = best.getBrand();
+    match.index = best.getIndex();
+    match.distance = distance;
+    return true;
+  }
+
+ public:
+  DuluxPaletteCatalog() = default;
+  DuluxPaletteCatalog(const DuluxPaletteCatalog&) = delete;
+  DuluxPaletteCatalog& operator=(const DuluxPaletteCatalog&) = delete;
+
+  /**
+   * @brief Load a palette file and register it under a brand name
+   * @return Brand id of the new palette, or -1 if the catalog is full,
+   *         the brand is already mounted or the file cannot be loaded
+   *
+   * The index is not updated; call buildIndex() once all palettes are mounted.
+   */
+  int mount(const char* brand, const char* filename) {
+    if (!brand || brand[0] == '\0' || palette_count >= DULUX_CATALOG_MAX_PALETTES) {
+      Serial.printf("[Catalog] Cannot mount %s: catalog full or brand missing\n", filename);
+      return -1;
+    }
+    if (findBrand(brand) >= 0) {
+      Serial.printf("[Catalog] Brand %s already mounted\n", brand);
+      return -1;
+    }
+
+    Entry& entry = entries[palette_count];
+    if (!entry.arena.load(filename)) {
+      Serial.printf("[Catalog] Failed to load %s for brand %s\n", filename, brand);
+      return -1;
+    }
+    strncpy(entry.brand, brand, sizeof(entry.brand) - 1);
+    entry.brand[sizeof(entry.brand) - 1] = '\0';
+    total_colors += entry.arena.getColorCount();
+
+    Serial.printf("[Catalog] Mounted %s as brand %u (%u colors)\n", filename,
+                  (unsigned)palette_count, (unsigned)entry.arena.getColorCount());
+    return palette_count++;
+  }
+
+  /**
+   * @brief Drop the index and release every mounted palette
+   */
+  void unmountAll() {
+    index.clear();
+    wide_index.clear();
+    wide = false;
+    for (uint8_t i = 0; i < palette_count; i++) {
+      entries[i].arena.release();
+      entries[i].brand[0] = '\0';
+    }
+    palette_count = 0;
+    total_colors = 0;
+  }
+
+  /**
+   * @brief Build the brand-tagged index over every mounted palette
+   * @param filters Also store LRV and flags for filtered queries (see hasFilters())
+   * @return false if nothing is mounted, the palettes do not fit in PSRAM
+   *         or the tree could not be allocated
+   */
+  bool buildIndex(bool filters = false) {
+    index.clear();
+    wide_index.clear();
+    if (total_colors == 0) {
+      return false;
+    }
+    KDTreePlan const PLAN = planKDTree(total_colors);
+    if (PLAN.points < total_colors) {
+      Serial.printf("[Catalog] Only %u of %u colors fit in PSRAM - not indexing\n",
+                    (unsigned)PLAN.points, (unsigned)total_colors);
+      return false;
+    }
+    wide = PLAN.index_bits > 16;
+    Serial.printf("[Catalog] Indexing %u colors with %u-bit positions (%u KB)\n",
+                  (unsigned)total_colors, (unsigned)PLAN.index_bits, (unsigned)(PLAN.bytes / 1024));
+    return wide ? buildTree(wide_index, filters) : buildTree(index, filters);
+  }
+
+  /**
+   * @brief Nearest color among the brands in brand_mask (bit n = brand id n)
+   * @param options Optional KD-tree options, e.g. an LRV / flag filter (needs hasFilters())
+   * @return false if the index is not built, no selected brand is mounted or no
+   *         color passes the filter
+   */
+  bool findNearest(uint8_t r, uint8_t g, uint8_t b, uint32_t brand_mask, DuluxCatalogMatch& match,
+                   const KDTreeSearchOptions& options = KDTreeSearchOptions()) const {
+    if (!isIndexed() || (brand_mask & allBrandsMask()) == 0) {
+      return false;
+    }
+    return wide ? findIn(wide_index, r, g, b, brand_mask, options, match)
+                : findIn(index, r, g, b, brand_mask, options, match);
+  }
+
+  /**
+   * @brief Brand id of a mounted palette (case-insensitive), or -1
+   */
+  int findBrand(const char* brand) const {
+    for (uint8_t i = 0; i < palette_count; i++) {
+      if (strcasecmp(entries[i].brand, brand) == 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  static uint32_t brandMask(uint8_t brand) {
+    return brand < KDTREE_MAX_BRANDS ? (1U << brand) : 0;
+  }
+  uint32_t allBrandsMask() const {
+    return palette_count >= 32 ? KDTREE_ALL_BRANDS : ((1U << palette_count) - 1);
+  }
+
+  uint8_t getPaletteCount() const {
+    return palette_count;
+  }
+  uint32_t getTotalColors() const {
+    return total_colors;
+  }
+  bool isIndexed() const {
+    return wide ? wide_index.isBuilt() : index.isBuilt();
+  }
+  size_t getIndexMemoryUsage() const {
+    return wide ? wide_index.getMemoryUsage() : index.getMemoryUsage();
+  }
+  bool hasFilters() const {
+    return wide ? wide_index.hasAttributes() : index.hasAttributes();
+  }
+  uint8_t getIndexBits() const {
+    return wide ? 32 : 16;
+  }
+  const KDTreeBuildStats& getIndexBuildStats() const {
+    return wide ? wide_index.getBuildStats() : index.getBuildStats();
+  }
+
+  const char* getBrandName(uint8_t brand) const {
+    return brand < palette_count ? entries[brand].brand : "";
+  }
+  const DuluxPaletteArena& palette(uint8_t brand) const {
+    return entries[brand].arena;
+  }
+
+  /**
+   * @brief Decode the name and code of a match into caller buffers
+   */
+  bool describe(const DuluxCatalogMatch& match, char* name, size_t name_size, char* code,
+                size_t code_size) const {
+    if (match.brand >= palette_count ||
+        match.index >= entries[match.brand].arena.getColorCount()) {
+      return false;
+    }
+    entries[match.brand].arena.copyName(match.index, name, name_size);
+    entries[match.brand].arena.copyCode(match.index, code, code_size);
+    return true;
+  }
+};
+
+#endif  // DULUX_PALETTE_CATALOG_H
@@ -0,0 +1,303 @@
+/**
+ * @file dulux_palette_format.h
+ * @brief On-disk layout of the dulux.bin palette database (v1 and v2)
+ *
+ * Shared by the firmware readers and host-side tooling, so this header must
+ * not depend on Arduino or ESP-IDF.
+ *
+ * Version 1 (row oriented):
+ * - Header: 16 bytes (magic, version, count, reserved = 0)
+ * - Each color entry: RGB (3), LRV*100 (2), ID (4), name (u8 length + bytes),
+ *   code (u8 length + bytes), light text flag (1)
+ *
+ * Version 2 (column oriented):
+ * - Header: 16 bytes, reserved = file offset of the section table
+ * - Section table: u32 section count followed by {tag, offset, size} entries
+ * - One contiguous section per column (RGB, fixed-point L*a*b*, LRV, ID, flags)
+ * - Names and codes either as offset columns into a heap of NUL-terminated
+ *   strings (NAME, CODE, STRS) or front-coded (FCNM, FCCD, see
+ *   dulux_front_coding.h)
+ * - Optional sections: META (CRC and build info) and KDT3 (prebuilt KD-tree)
+ *
+ * A full-palette scan over v2 touches only the LAB (6 bytes) and RGB (3 bytes)
+ * columns and needs no per-candidate color-space conversion.
+ *
+ * v1 files written by the palette compiler carry an 8 byte CRC trailer after
+ * the last entry; v1 readers stop after color_count entries and ignore it.
+ *
+ * Palette identity (key for cached derived data such as KD-tree snapshots):
+ * the META palette_crc for v2, the trailer CRC for v1, and otherwise the
+ * CRC-32 of the whole file.
+ */
+
+#ifndef DULUX_PALETTE_FORMAT_H
+#define DULUX_PALETTE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CIEDE2000.h"
+
+// Binary format constants
+#define DULUX_MAGIC_NUMBER 0x584C5544  // "DULX" in little-endian
+#define DULUX_BINARY_VERSION 1
+#define DULUX_BINARY_VERSION_V2 2
+#define DULUX_HEADER_SIZE 16
+#define DULUX_FIXED_FIELDS_SIZE 9  // v1: RGB (3) + LRV (2) + ID (4) before the name string
+#define DULUX_SECTION_ALIGNMENT 4
+#define DULUX_LAB_FIXED_SCALE 100  // v2 L*a*b* columns store value * 100
+
+// Builds a little-endian four character section tag
+#define DULUX_FOURCC(a, b, c, d) \
+  ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+// v2 section tags
+#define DULUX_SECTION_RGB DULUX_FOURCC('R', 'G', 'B', ' ')   // 3 bytes per color
+#define DULUX_SECTION_LAB DULUX_FOURCC('L', 'A', 'B', ' ')   // DuluxLabFixed per color
+#define DULUX_SECTION_LRV DULUX_FOURCC('L', 'R', 'V', ' ')   // uint16_t LRV * 100 per color
+#define DULUX_SECTION_ID DULUX_FOURCC('I', 'D', ' ', ' ')    // uint32_t per color
+#define DULUX_SECTION_FLAGS DULUX_FOURCC('F', 'L', 'A', 'G')  // uint8_t per color
+#define DULUX_SECTION_NAME DULUX_FOURCC('N', 'A', 'M', 'E')  // uint32_t heap offset per color
+#define DULUX_SECTION_CODE DULUX_FOURCC('C', 'O', 'D', 'E')  // uint32_t heap offset per color
+#define DULUX_SECTION_STRINGS DULUX_FOURCC('S', 'T', 'R', 'S')  // NUL-terminated strings
+#define DULUX_SECTION_NAME_FC DULUX_FOURCC('F', 'C', 'N', 'M')  // Front-coded names
+#define DULUX_SECTION_CODE_FC DULUX_FOURCC('F', 'C', 'C', 'D')  // Front-coded codes
+#define DULUX_SECTION_META DULUX_FOURCC('M', 'E', 'T', 'A')     // DuluxPaletteMeta
+#define DULUX_SECTION_KDTREE DULUX_FOURCC('K', 'D', 'T', '3')   // DuluxKDTreeHeader + points
+// Superseded trees, ignored by readers (rebuilt instead): KDT1 split on RGB,
+// KDT2 stored linked L*a*b* nodes
+
+// v1 CRC trailer magic
+#define DULUX_TRAILER_MAGIC DULUX_FOURCC('D', 'C', 'R', 'C')
+
+// META ordering values
+#define DULUX_ORDER_SOURCE 0   // Entries kept in source order
+#define DULUX_ORDER_MORTON 1   // Entries sorted along a Z-order curve in Lab space
+#define DULUX_ORDER_HILBERT 2  // Entries sorted along a Hilbert curve in Lab space
+
+// v2 FLAG column bits
+#define DULUX_FLAG_LIGHT_TEXT 0x01
+
+/**
+ * @brief Binary header structure (both versions)
+ */
+struct DuluxBinaryHeader {
+  uint32_t magic;        // Magic number for validation
+  uint32_t version;      // Format version
+  uint32_t color_count;  // Number of colors in file
+  uint32_t reserved;     // v1: unused (0), v2: offset of the section table
+};
+
+/**
+ * @brief One entry of the v2 section table
+ */
+struct DuluxSectionEntry {
+  uint32_t tag;     // DULUX_SECTION_* four character code
+  uint32_t offset;  // Absolute file offset of the section
+  uint32_t size;    // Section size in bytes
+};
+
+/**
+ * @brief Fixed-point CIELAB value as stored in the v2 LAB column
+ */
+struct DuluxLabFixed {
+  int16_t l;  // L* * 100 (0..10000)
+  int16_t a;  // a* * 100
+  int16_t b;  // b* * 100
+};
+
+/**
+ * @brief Contents of the v2 META section
+ *
+ * palette_crc is the CRC-32 of every other section payload, in section table
+ * order, and identifies the palette for cached derived data (KD-tree
+ * snapshots, lookup tables).
+ */
+struct DuluxPaletteMeta {
+  uint32_t palette_crc;   // CRC-32 over all non-META section payloads
+  uint32_t ordering;      // DULUX_ORDER_* used by the compiler
+  uint32_t source_count;  // Entries in the source before de-duplication
+  uint32_t reserved;      // Must be 0
+};
+
+/**
+ * @brief Header of a prebuilt KD-tree (KDT3 section and snapshot body)
+ *
+ * The tree is implicit: point_count DuluxKDPointRecord entries follow, and
+ * the records of a range [lo, hi) form one subtree. A range of at most
+ * leaf_size points is a leaf bucket in no particular order; a larger one is
+ * split by its middle record (lo + (hi - lo) / 2) on L*a*b* axis
+ * depth % 3 (0=L*, 1=a*, 2=b*), with [lo, mid) and [mid + 1, hi) as its
+ * children. Splits use each point's fixed-point L*a*b*, which the records do
+ * not store: the reader takes it from the palette's LAB column (a reader
+ * without one in memory computes the same values from the point's RGB).
+ */
+struct DuluxKDTreeHeader {
+  uint16_t leaf_size;    // Largest range stored as an unsplit bucket (>= 1)
+  uint16_t reserved;     // Must be 0
+  uint32_t point_count;  // DuluxKDPointRecord entries that follow
+};
+
+#define DULUX_KD_LEAF_SIZE 8  // Bucket size of trees built by the compiler and the firmware
+
+/**
+ * @brief One point of a prebuilt KD-tree, in implicit tree order
+ */
+struct DuluxKDPointRecord {
+  uint8_t r, g, b;   // Color of the point
+  uint8_t reserved;  // Must be 0
+  uint16_t index;    // Palette index of the point
+};
+
+/**
+ * @brief Header of a front-coded string section (FCNM, FCCD)
+ */
+struct DuluxFrontCodedHeader {
+  uint32_t color_count;   // Entries in the ordinal column
+  uint32_t string_count;  // Distinct strings
+  uint16_t bucket_size;   // Strings per bucket; the first is stored whole
+  uint16_t reserved;      // Must be 0
+  uint32_t data_size;     // Bytes of bucket data
+};
+
+/**
+ * @brief v1 trailer written after the last entry by the palette compiler
+ */
+struct DuluxV1Trailer {
+  uint32_t palette_crc;  // CRC-32 of every byte before the trailer
+  uint32_t magic;        // DULUX_TRAILER_MAGIC
+};
+
+static_assert(sizeof(DuluxBinaryHeader) == DULUX_HEADER_SIZE, "header must stay 16 bytes");
+static_assert(sizeof(DuluxSectionEntry) == 12, "section entries are packed on disk");
+static_assert(sizeof(DuluxLabFixed) == 6, "LAB column stride is 6 bytes");
+static_assert(sizeof(DuluxPaletteMeta) == 16, "META section is packed on disk");
+static_assert(sizeof(DuluxKDTreeHeader) == 8, "KD-tree header is packed on disk");
+static_assert(sizeof(DuluxKDPointRecord) == 6, "KD-tree records are packed on disk");
+static_assert(sizeof(DuluxFrontCodedHeader) == 16, "front-coded header is packed on disk");
+
+/**
+ * @brief On-disk header of a KD-tree snapshot (followed by a DuluxKDTreeHeader and its points)
+ *
+ * The tree is only valid for the palette and build request it was made from;
+ * any field mismatch means the snapshot is stale and the tree is rebuilt.
+ */
+struct DuluxKDSnapshotHeader {
+  uint32_t magic;             // DULUX_KD_SNAPSHOT_MAGIC
+  uint32_t version;           // DULUX_KD_SNAPSHOT_VERSION (node layout / builder revision)
+  uint32_t palette_crc;       // Palette identity the tree was built from
+  uint32_t color_count;       // Colors in that palette
+  uint32_t requested_points;  // Points the build was asked to index
+  uint32_t node_count;        // Points in the tree that follows the header
+  uint32_t nodes_crc;         // CRC-32 of the tree bytes (detects torn writes)
+  uint32_t reserved;          // Must be 0
+};
+
+#define DULUX_KD_SNAPSHOT_MAGIC DULUX_FOURCC('K', 'D', 'S', 'N')
+#define DULUX_KD_SNAPSHOT_VERSION 3  // 2: L*a*b* splits, 3: implicit layout
+
+static_assert(sizeof(DuluxKDSnapshotHeader) == 32, "snapshot header is packed on disk");
+
+/**
+ * @brief On-disk header of a nearest-paint lookup table (followed by uint16_t cells)
+ *
+ * The table covers RGB quantized to `bits` bits per channel, one cell per
+ * (r >> shift, g >> shift, b >> shift) in r-major order. A cell holds the
+ * palette index that is the exact best match for every RGB value inside it.
+ * Cells whose values have different best matches carry DULUX_LUT_BOUNDARY
+ * plus the most common winner as a hint for a refined search.
+ */
+struct DuluxLutHeader {
+  uint32_t magic;          // DULUX_LUT_MAGIC
+  uint32_t version;        // DULUX_LUT_VERSION
+  uint32_t palette_crc;    // Palette identity the table was computed for
+  uint32_t color_count;    // Colors in that palette
+  uint32_t bits;           // Bits per channel (cells = 1 << (3 * bits))
+  uint32_t uniform_cells;  // Cells without DULUX_LUT_BOUNDARY
+  uint32_t cells_crc;      // CRC-32 of the cell array
+  uint32_t reserved;       // Must be 0
+};
+
+#define DULUX_LUT_MAGIC DULUX_FOURCC('D', 'L', 'U', 'T')
+#define DULUX_LUT_VERSION 1
+#define DULUX_LUT_BITS 6               // 64^3 cells, 512 KB
+#define DULUX_LUT_BOUNDARY 0x8000U     // Cell straddles a match boundary; low bits are a hint
+#define DULUX_LUT_MAX_COLORS 0x8000U   // Palette indices must fit below the flag bit
+
+static_assert(sizeof(DuluxLutHeader) == 32, "LUT header is packed on disk");
+
+/**
+ * @brief Check whether the header describes a version this firmware can read
+ */
+inline bool duluxIsSupportedVersion(uint32_t version) {
+  return version == DULUX_BINARY_VERSION || version == DULUX_BINARY_VERSION_V2;
+}
+
+/**
+ * @brief Locate a section by tag in an already-loaded section table
+ * @return Pointer to the entry, or nullptr if the section is absent
+ */
+inline const DuluxSectionEntry* duluxFindSection(const DuluxSectionEntry* table, uint32_t count,
+                                                 uint32_t tag) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (table[i].tag == tag) {
+      return &table[i];
+    }
+  }
+  return nullptr;
+}
+
+/**
+ * @brief Incremental CRC-32 (IEEE 802.3, reflected) with a 16-entry nibble table
+ * @param crc Previous value (0 to start)
+ */
+inline uint32_t duluxCrc32(uint32_t crc, const uint8_t* data, size_t length) {
+  static const uint32_t NIBBLE_TABLE[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ NIBBLE_TABLE[crc & 0x0F];
+    crc = (crc >> 4) ^ NIBBLE_TABLE[crc & 0x0F];
+  }
+  return ~crc;
+}
+
+/**
+ * @brief Recognise the compiler's v1 trailer in the last 8 bytes of a file
+ * @param tail Last sizeof(DuluxV1Trailer) bytes of the file
+ * @param crc_out Receives the palette CRC when the trailer is present
+ */
+inline bool duluxParseV1Trailer(const uint8_t* tail, uint32_t& crc_out) {
+  DuluxV1Trailer trailer;
+  memcpy(&trailer, tail, sizeof(trailer));
+  if (trailer.magic != DULUX_TRAILER_MAGIC) {
+    return false;
+  }
+  crc_out = trailer.palette_crc;
+  return true;
+}
+
+/**
+ * @brief Convert a floating point L*a*b* value to the v2 fixed-point column format
+ */
+inline DuluxLabFixed duluxLabToFixed(const CIEDE2000::LAB& lab) {
+  auto quantize = [](double v) {
+    double const SCALED = v * DULUX_LAB_FIXED_SCALE;
+    return (int16_t)(SCALED < 0 ? SCALED - 0.5 : SCALED + 0.5);
+  };
+  return {quantize(lab.l), quantize(lab.a), quantize(lab.b)};
+}
+
+/**
+ * @brief Expand a v2 fixed-point L*a*b* value for CIEDE2000
+ */
+inline CIEDE2000::LAB duluxLabFromFixed(const DuluxLabFixed& lab) {
+  return {lab.l / (double)DULUX_LAB_FIXED_SCALE, lab.a / (double)DULUX_LAB_FIXED_SCALE,
+          lab.b / (double)DULUX_LAB_FIXED_SCALE};
+}
+
+#endif  // DULUX_PALETTE_FORMAT_H
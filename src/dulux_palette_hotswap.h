@@ -0,0 +1,273 @@
+/**
+ * @file dulux_palette_hotswap.h
+ * @brief Replace the live palette without a reboot or a service gap
+ *
+ * A palette and its search indexes are bundled into an immutable
+ * DuluxLivePalette. Readers take a shared_ptr to the current one with
+ * acquire() and search it for as long as they hold the pointer. A reload
+ * loads and indexes the new file in a low-priority FreeRTOS task, then
+ * publishes it with one atomic shared_ptr store. Queries that started before
+ * the swap finish on the old palette; it is freed when the last of them
+ * drops its reference.
+ */
+
+#ifndef DULUX_PALETTE_HOTSWAP_H
+#define DULUX_PALETTE_HOTSWAP_H
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+
+#include "dulux_exact_scan.h"
+#include "dulux_palette_arena.h"
+#include "lightweight_kdtree.h"
+
+#define DULUX_HOTSWAP_PATH_LENGTH 64      // Longest palette path a reload accepts
+#define DULUX_HOTSWAP_TASK_STACK 8192     // Bytes of stack for the build task
+#define DULUX_HOTSWAP_TASK_PRIORITY 1     // Same as loop() (time-sliced with it), below web/WiFi
+
+/**
+ * @brief One palette plus its indexes, never modified after publication
+ */
+class DuluxLivePalette {
+ private:
+  DuluxPaletteArena palette;
+  LightweightKDTree tree;
+  DuluxExactScan exact;
+  uint32_t generation{0};
+
+  friend class DuluxPaletteHotSwap;
+
+ public:
+  DuluxLivePalette() = default;
+  DuluxLivePalette(const DuluxLivePalette&) = delete;
+  DuluxLivePalette& operator=(const DuluxLivePalette&) = delete;
+
+  /**
+   * @brief Exact closest palette entry under the shared metric
+   *
+   * The exact scan answers, starting from the KD-tree's (approximate) answer
+   * when there is a tree; without the exact scan the plain scan does.
+   * @param distance_out Receives the match distance (optional)
+   */
+  uint32_t findClosest(uint8_t r, uint8_t g, uint8_t b, float* distance_out = nullptr) const {
+    if (!exact.isBuilt()) {
+      return palette.findClosest(r, g, b, distance_out);
+    }
+    uint32_t seed = DULUX_EXACT_NO_SEED;
+    ColorPoint hint;
+    if (tree.isBuilt() && tree.findNearest(r, g, b, KDTREE_ALL_BRANDS, hint)) {
+      seed = hint.getIndex();
+    }
+    return exact.findClosest(r, g, b, distance_out, nullptr, seed);
+  }
+
+  const DuluxPaletteArena& getPalette() const {
+    return palette;
+  }
+  const LightweightKDTree& getTree() const {
+    return tree;
+  }
+  const DuluxExactScan& getExactScan() const {
+    return exact;
+  }
+  // A tree short of the palette only seeds the exact scan, so it does not count here
+  bool isTreeIndexed() const {
+    return tree.isBuilt() && tree.getNodeCount() == palette.getColorCount();
+  }
+  bool isExactIndexed() const {
+    return exact.isBuilt();
+  }
+  uint32_t getGeneration() const {
+    return generation;
+  }
+};
+
+/**
+ * @brief State of the most recent reload request
+ */
+enum class DuluxHotSwapState : uint8_t {
+  IDLE,       // No reload requested yet
+  BUILDING,   // Background task is loading and indexing
+  PUBLISHED,  // New palette is live
+  FAILED      // Load or index failed; the previous palette stays live
+};
+
+class DuluxPaletteHotSwap {
+ private:
+  std::shared_ptr<const DuluxLivePalette> live;  // Accessed only via std::atomic_load/store
+  std::atomic<DuluxHotSwapState> state{DuluxHotSwapState::IDLE};
+  std::atomic<uint32_t> generation{0};
+  char pending_path[DULUX_HOTSWAP_PATH_LENGTH]{};
+  bool pending_tree{false};
+  bool pending_exact{false};
+  DuluxParallelScan* scan_workers{nullptr};
+  unsigned long last_build_ms{0};
+
+  static void buildTask(void* param) {
+    auto* self = static_cast<DuluxPaletteHotSwap*>(param);
+    self->runBuild();
+    vTaskDelete(nullptr);
+  }
+
+  void runBuild() {
+    unsigned long const START_TIME = millis();
+    std::shared_ptr<DuluxLivePalette> next(new (std::nothrow) DuluxLivePalette());
+    if (!next || !next->palette.load(pending_path)) {
+      Serial.printf("[HotSwap] Failed to load %s - keeping current palette\n", pending_path);
+      state.store(DuluxHotSwapState::FAILED);
+      return;
+    }
+
+    if (pending_tree && !indexPalette(*next)) {
+      Serial.println("[HotSwap] KD-tree build failed - exact scan starts without a hint");
+    }
+    if (pending_exact && !buildExactScan(*next)) {
+      Serial.println("[HotSwap] Exact scan build failed - new palette will use linear scan");
+    }
+
+    next->generation = generation.load() + 1;
+    publish(std::move(next));
+    last_build_ms = millis() - START_TIME;
+    Serial.printf("[HotSwap] Published %s as generation %u in %lu ms\n", pending_path,
+                  (unsigned)generation.load(), last_build_ms);
+    state.store(DuluxHotSwapState::PUBLISHED);
+  }
+
+  // Prebuilt KDT3 section if the file carries one, otherwise build over the arena records;
+  // either way the tree gets the LRV and flags that filtered matches test
+  static bool indexPalette(DuluxLivePalette& next) {
+    if (!buildTree(next)) {
+      return false;
+    }
+    const DuluxPaletteArena& palette = next.palette;
+    if (!next.tree.attachAttributes(
+            [&palette](uint32_t index, uint8_t, KDTreeAttributes& attributes) {
+              const DuluxArenaRecord& record = palette.record(index);
+              attributes.lrv_scaled = record.lrv_scaled;
+              attributes.flags = record.flags;
+              return true;
+            })) {
+      Serial.println("[HotSwap] KD-tree attributes unavailable - filtered matches disabled");
+    }
+    return true;
+  }
+
+  static bool buildTree(DuluxLivePalette& next) {
+    const DuluxPaletteArena& palette = next.palette;
+    uint32_t size = 0;
+    const uint8_t* records = palette.section(DULUX_SECTION_KDTREE, &size);
+    auto const LAB_OF = [&palette](uint32_t index, uint8_t, uint8_t, uint8_t) {
+      return palette.record(index).lab;
+    };
+    if (records && next.tree.loadPrebuilt(records, size, palette.getColorCount(), LAB_OF)) {
+      return true;
+    }
+
+    PSRAMColorVector points;
+    try {
+      points.reserve(palette.getColorCount());
+    } catch (const std::exception&) {
+      return false;
+    }
+    for (uint32_t i = 0; i < palette.getColorCount(); i++) {
+      const DuluxArenaRecord& record = palette.record(i);
+      points.push_back(ColorPoint(record.r, record.g, record.b, record.lab, (uint16_t)i));
+    }
+    next.tree.setPointCap(palette.getColorCount());
+    return next.tree.build(points) && next.tree.getNodeCount() == palette.getColorCount();
+  }
+
+  bool buildExactScan(DuluxLivePalette& next) const {
+    const DuluxPaletteArena& palette = next.palette;
+    next.exact.setWorkers(scan_workers);
+    return next.exact.build(palette.getColorCount(),
+                            [&palette](uint32_t index, uint8_t& r, uint8_t& g, uint8_t& b,
+                                       DuluxLabFixed& lab) {
+                              const DuluxArenaRecord& record = palette.record(index);
+                              r = record.r;
+                              g = record.g;
+                              b = record.b;
+                              lab = record.lab;
+                              return true;
+                            });
+  }
+
+  void publish(std::shared_ptr<const DuluxLivePalette> next) {
+    uint32_t const GENERATION = next->generation;
+    std::atomic_store(&live, std::move(next));
+    generation.store(GENERATION);
+  }
+
+ public:
+  DuluxPaletteHotSwap() = default;
+  DuluxPaletteHotSwap(const DuluxPaletteHotSwap&) = delete;
+  DuluxPaletteHotSwap& operator=(const DuluxPaletteHotSwap&) = delete;
+
+  /**
+   * @brief Current live palette, or nullptr if none was published
+   *
+   * Hold the returned pointer for the whole query; it keeps that palette
+   * alive even if a swap happens meanwhile.
+   */
+  std::shared_ptr<const DuluxLivePalette> acquire() const {
+    return std::atomic_load(&live);
+  }
+
+  /**
+   * @brief Start loading and indexing a palette file in the background
+   * @param build_tree Also build a KD-tree (prebuilt section used when present)
+   * @param build_exact Also build the exact scan index
+   * @return false if a reload is already running, the path is too long or
+   *         the task could not be created
+   */
+  bool requestReload(const char* path, bool build_tree, bool build_exact) {
+    if (!path || strlen(path) >= sizeof(pending_path)) {
+      return false;
+    }
+    DuluxHotSwapState expected = state.load();
+    if (expected == DuluxHotSwapState::BUILDING ||
+        !state.compare_exchange_strong(expected, DuluxHotSwapState::BUILDING)) {
+      Serial.println("[HotSwap] Reload already in progress");
+      return false;
+    }
+
+    strncpy(pending_path, path, sizeof(pending_path) - 1);
+    pending_path[sizeof(pending_path) - 1] = '\0';
+    pending_tree = build_tree;
+    pending_exact = build_exact;
+
+    Serial.printf("[HotSwap] Rebuilding index for %s in background\n", pending_path);
+    if (xTaskCreate(buildTask, "palette_swap", DULUX_HOTSWAP_TASK_STACK, this,
+                    DULUX_HOTSWAP_TASK_PRIORITY, nullptr) != pdPASS) {
+      Serial.println("[HotSwap] Failed to start build task");
+      state.store(DuluxHotSwapState::FAILED);
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Workers the exact scans of later palettes split their searches across
+   */
+  void setScanWorkers(DuluxParallelScan* workers) {
+    scan_workers = workers;
+  }
+
+  DuluxHotSwapState getState() const {
+    return state.load();
+  }
+  uint32_t getGeneration() const {
+    return generation.load();
+  }
+  const char* getPendingPath() const {
+    return pending_path;
+  }
+  unsigned long getLastBuildMs() const {
+    return last_build_ms;
+  }
+};
+
+#endif  // DULUX_PALETTE_HOTSWAP_H
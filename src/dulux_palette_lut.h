@@ -0,0 +1,171 @@
+/**
+ * @file dulux_palette_lut.h
+ * @brief Precomputed nearest-paint answers for quantized RGB
+ *
+ * The palette compiler (--lut) matches every RGB value offline and stores,
+ * per 4x4x4 block of RGB values, the palette index that is the exact answer
+ * for the whole block. Blocks that straddle a match boundary are flagged and
+ * carry the block's most common answer instead; the caller refines those
+ * with a real search seeded from that hint.
+ *
+ * The table is a separate file keyed by the palette CRC, so a palette
+ * change leaves a stale table that load() refuses rather than wrong names.
+ * It is read into one PSRAM block (512 KB for 6 bits per channel).
+ */
+
+#ifndef DULUX_PALETTE_LUT_H
+#define DULUX_PALETTE_LUT_H
+
+#include <Arduino.h>
+
+#include <LittleFS.h>
+#include <esp_heap_caps.h>
+
+#include "dulux_palette_format.h"
+
+class DuluxPaletteLut {
+ private:
+  uint16_t* cells{nullptr};
+  uint32_t cell_count{0};
+  uint32_t shift{0};
+  uint32_t bits{0};
+  uint32_t color_count{0};
+  uint32_t uniform_cells{0};
+  mutable uint32_t exact_hits{0};     // Lookups answered by the table alone
+  mutable uint32_t boundary_hits{0};  // Lookups that needed a refined search
+
+ public:
+  DuluxPaletteLut() = default;
+  DuluxPaletteLut(const DuluxPaletteLut&) = delete;
+  DuluxPaletteLut& operator=(const DuluxPaletteLut&) = delete;
+  ~DuluxPaletteLut() {
+    release();
+  }
+
+  /**
+   * @brief Read a lookup table built for the given palette into PSRAM
+   * @return false if the file is missing, corrupt or built for another palette
+   */
+  bool load(const char* path, uint32_t palette_crc, uint32_t palette_colors) {
+    release();
+    if (!LittleFS.exists(path)) {
+      return false;
+    }
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+      return false;
+    }
+
+    unsigned long const START_TIME = millis();
+    DuluxLutHeader header{};
+    if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != DULUX_LUT_MAGIC || header.version != DULUX_LUT_VERSION ||
+        header.bits == 0 || header.bits > 8) {
+      Serial.printf("[PaletteLUT] %s is not a lookup table\n", path);
+      file.close();
+      return false;
+    }
+    if (header.palette_crc != palette_crc || header.color_count != palette_colors ||
+        palette_colors > DULUX_LUT_MAX_COLORS) {
+      Serial.printf("[PaletteLUT] %s is stale (CRC 0x%08X vs 0x%08X) - ignoring\n", path,
+                    header.palette_crc, palette_crc);
+      file.close();
+      return false;
+    }
+
+    uint32_t const COUNT = 1U << (3 * header.bits);
+    size_t const BYTES = COUNT * sizeof(uint16_t);
+    if (file.size() != sizeof(header) + BYTES) {
+      Serial.printf("[PaletteLUT] %s has the wrong size\n", path);
+      file.close();
+      return false;
+    }
+    cells = static_cast<uint16_t*>(heap_caps_malloc(BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!cells) {
+      Serial.printf("[PaletteLUT] Cannot allocate %u KB PSRAM\n", (unsigned)(BYTES / 1024));
+      file.close();
+      return false;
+    }
+    bool const READ_OK = file.read(reinterpret_cast<uint8_t*>(cells), BYTES) == BYTES;
+    file.close();
+    if (!READ_OK || duluxCrc32(0, reinterpret_cast<const uint8_t*>(cells), BYTES) !=
+                        header.cells_crc) {
+      Serial.printf("[PaletteLUT] %s is corrupt - ignoring\n", path);
+      release();
+      return false;
+    }
+
+    // Every stored index (hint or exact) must name a palette entry
+    for (uint32_t i = 0; i < COUNT; i++) {
+      if ((cells[i] & ~DULUX_LUT_BOUNDARY) >= palette_colors) {
+        Serial.printf("[PaletteLUT] %s cell %u is out of range - ignoring\n", path, (unsigned)i);
+        release();
+        return false;
+      }
+    }
+
+    cell_count = COUNT;
+    bits = header.bits;
+    shift = 8 - header.bits;
+    color_count = palette_colors;
+    uniform_cells = header.uniform_cells;
+    Serial.printf("[PaletteLUT] Loaded %u cells (%u%% exact) in %lu ms, %u KB PSRAM\n",
+                  (unsigned)cell_count, (unsigned)((uniform_cells * 100ULL) / cell_count),
+                  millis() - START_TIME, (unsigned)(getMemoryUsage() / 1024));
+    return true;
+  }
+
+  void release() {
+    if (cells) {
+      heap_caps_free(cells);
+      cells = nullptr;
+    }
+    cell_count = 0;
+    color_count = 0;
+    uniform_cells = 0;
+  }
+
+  /**
+   * @brief Look up the cell of an RGB value
+   * @param index Receives the exact answer, or a hint when false is returned
+   * @return true if index is the exact best match; false if the cell straddles
+   *         a boundary (refine starting from index) or no table is loaded
+   *         (index is then color count)
+   */
+  bool lookup(uint8_t r, uint8_t g, uint8_t b, uint32_t& index) const {
+    if (!cells) {
+      index = color_count;
+      return false;
+    }
+    uint32_t const CELL = ((((uint32_t)(r >> shift) << bits) | (g >> shift)) << bits) | (b >> shift);
+    uint16_t const VALUE = cells[CELL];
+    index = VALUE & ~DULUX_LUT_BOUNDARY;
+    if (VALUE & DULUX_LUT_BOUNDARY) {
+      boundary_hits++;
+      return false;
+    }
+    exact_hits++;
+    return true;
+  }
+
+  bool isLoaded() const {
+    return cells != nullptr;
+  }
+  uint32_t getCellCount() const {
+    return cell_count;
+  }
+  uint32_t getUniformCells() const {
+    return uniform_cells;
+  }
+  uint32_t getExactHits() const {
+    return exact_hits;
+  }
+  uint32_t getBoundaryHits() const {
+    return boundary_hits;
+  }
+  size_t getMemoryUsage() const {
+    return cell_count * sizeof(uint16_t);
+  }
+};
+
+#endif  // DULUX_PALETTE_LUT_H
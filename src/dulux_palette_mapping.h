@@ -0,0 +1,142 @@
+/**
+ * @file dulux_palette_mapping.h
+ * @brief Zero-copy palette backend over a raw flash partition (or a host file)
+ *
+ * On the ESP32-S3 the "palette" data partition is mapped into the data
+ * address space with esp_partition_mmap(), so palette columns are read
+ * straight out of flash cache: no LittleFS/VFS hop, no copy, and no heap or
+ * PSRAM used for the palette itself. On the host build the same v2 image is
+ * mapped from a regular file with POSIX mmap().
+ *
+ * Flashing the partition (v2 image produced by the palette compiler):
+ *   esptool.py write_flash 0xF00000 dulux_v2.bin
+ */
+
+#ifndef DULUX_PALETTE_MAPPING_H
+#define DULUX_PALETTE_MAPPING_H
+
+#include "dulux_palette_view.h"
+
+#if defined(ESP_PLATFORM)
+  #include <esp_partition.h>
+  #include <esp_spi_flash.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#define DULUX_PALETTE_PARTITION_SUBTYPE 0x40  // Custom data subtype used in the partition table
+
+class DuluxPaletteMapping {
+ private:
+  DuluxPaletteView view;
+  const void* mapped{nullptr};
+  size_t mapped_size{0};
+
+#if defined(ESP_PLATFORM)
+  spi_flash_mmap_handle_t handle{0};
+#endif
+
+ public:
+  DuluxPaletteMapping() = default;
+  DuluxPaletteMapping(const DuluxPaletteMapping&) = delete;
+  DuluxPaletteMapping& operator=(const DuluxPaletteMapping&) = delete;
+
+  ~DuluxPaletteMapping() {
+    unmap();
+  }
+
+  /**
+   * @brief Map a palette image and validate it
+   * @param source Partition label on the device, file path on the host
+   * @return true if a valid v2 palette is now accessible through view()
+   */
+  bool map(const char* source) {
+    unmap();
+    unsigned long const START_US = DULUX_PALETTE_MICROS();
+
+#if defined(ESP_PLATFORM)
+    const esp_partition_t* partition = esp_partition_find_first(
+        ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)DULUX_PALETTE_PARTITION_SUBTYPE, source);
+    if (!partition) {
+      DULUX_PALETTE_LOG("[Palette] Partition '%s' not found\n", source);
+      return false;
+    }
+
+    esp_err_t const ERR = esp_partition_mmap(partition, 0, partition->size,
+                                             SPI_FLASH_MMAP_DATA, &mapped, &handle);
+    if (ERR != ESP_OK) {
+      DULUX_PALETTE_LOG("[Palette] esp_partition_mmap failed: %s\n", esp_err_to_name(ERR));
+      mapped = nullptr;
+      return false;
+    }
+    mapped_size = partition->size;
+#else
+    int const FD = open(source, O_RDONLY);
+    if (FD < 0) {
+      DULUX_PALETTE_LOG("[Palette] Cannot open %s\n", source);
+      return false;
+    }
+    struct stat info {};
+    if (fstat(FD, &info) != 0 || info.st_size <= 0) {
+      close(FD);
+      return false;
+    }
+    void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, FD, 0);
+    close(FD);  // The mapping keeps its own reference to the file
+    if (address == MAP_FAILED) {
+      DULUX_PALETTE_LOG("[Palette] mmap of %s failed\n", source);
+      return false;
+    }
+    mapped = address;
+    mapped_size = (size_t)info.st_size;
+#endif
+
+    // A partition is larger than the image it holds; trust only the described extent
+    const auto* bytes = static_cast<const uint8_t*>(mapped);
+    size_t const IMAGE_SIZE = DuluxPaletteView::describedSize(bytes, mapped_size);
+    if (IMAGE_SIZE == 0 || !view.attach(bytes, IMAGE_SIZE)) {
+      DULUX_PALETTE_LOG("[Palette] '%s' does not hold a valid v2 palette\n", source);
+      unmap();
+      return false;
+    }
+
+    DULUX_PALETTE_LOG("[Palette] Mapped %u colors (%u bytes) from '%s' in %luus\n",
+                      (unsigned)view.getColorCount(), (unsigned)IMAGE_SIZE, source,
+                      (unsigned long)(DULUX_PALETTE_MICROS() - START_US));
+    return true;
+  }
+
+  /**
+   * @brief Release the mapping
+   */
+  void unmap() {
+    view.detach();
+    if (!mapped) {
+      return;
+    }
+#if defined(ESP_PLATFORM)
+    spi_flash_munmap(handle);
+    handle = 0;
+#else
+    munmap(const_cast<void*>(mapped), mapped_size);
+#endif
+    mapped = nullptr;
+    mapped_size = 0;
+  }
+
+  bool isMapped() const {
+    return view.isAttached();
+  }
+
+  /**
+   * @brief Access the mapped palette (pointers stay valid until unmap())
+   */
+  const DuluxPaletteView& getView() const {
+    return view;
+  }
+};
+
+#endif  // DULUX_PALETTE_MAPPING_H
@@ -0,0 +1,356 @@
+/**
+ * @file dulux_palette_upload.h
+ * @brief Streaming palette upload: chunks go straight to LittleFS, parsed as they pass
+ *
+ * The web server hands over the request body a chunk at a time. Each chunk
+ * is appended to a temporary file and fed through a byte-level parser that
+ * walks the v1 record structure (or the v2 header) and keeps a running
+ * CRC-32, so nothing beyond the current chunk is ever held in RAM. Only a
+ * structurally complete upload is renamed over the target path; anything
+ * else is deleted and the existing file is left untouched.
+ */
+
+#ifndef DULUX_PALETTE_UPLOAD_H
+#define DULUX_PALETTE_UPLOAD_H
+
+#include <Arduino.h>
+
+#include <LittleFS.h>
+
+#include <algorithm>
+
+#include "dulux_palette_format.h"
+
+#define DULUX_UPLOAD_PATH_LENGTH 64       // Longest target path accepted
+#define DULUX_UPLOAD_MAX_SECTIONS 32      // v2 section table entries checked at finish
+#define DULUX_UPLOAD_MAX_COLORS 65535     // Largest palette an upload may declare
+
+class DuluxPaletteUpload {
+ private:
+  // Parser stage; v1 records advance FIXED -> NAME_LENGTH -> NAME -> CODE_LENGTH -> CODE -> FLAG
+  enum class Stage : uint8_t {
+    HEADER,
+    FIXED,
+    NAME_LENGTH,
+    NAME,
+    CODE_LENGTH,
+    CODE,
+    FLAG,
+    TRAILER,  // v1: bytes after the last record (compiler CRC trailer)
+    BODY,     // v2: columns and section table, checked at finish()
+    FAILED
+  };
+
+  File file;
+  char target[DULUX_UPLOAD_PATH_LENGTH]{};
+  char temp[DULUX_UPLOAD_PATH_LENGTH + 8]{};
+  bool active{false};
+
+  Stage stage{Stage::HEADER};
+  uint8_t header_bytes[DULUX_HEADER_SIZE]{};
+  DuluxBinaryHeader header{};
+  uint32_t remaining{0};     // Bytes left in the current stage
+  uint32_t colors_parsed{0};
+  uint8_t tail[sizeof(DuluxV1Trailer)]{};
+  uint32_t tail_length{0};
+  uint32_t crc{0};           // CRC-32 of every byte so far
+  uint32_t records_crc{0};   // v1: CRC-32 up to the end of the last record
+  uint32_t palette_crc{0};
+  uint32_t bytes_received{0};
+  const char* error{nullptr};
+
+  void fail(const char* reason) {
+    if (!error) {
+      error = reason;
+    }
+    stage = Stage::FAILED;
+  }
+
+  void enterRecord() {
+    if (colors_parsed == header.color_count) {
+      stage = Stage::TRAILER;
+    } else {
+      stage = Stage::FIXED;
+      remaining = DULUX_FIXED_FIELDS_SIZE;
+    }
+  }
+
+  // Length byte of a v1 string; 255 marks an empty string with no bytes following
+  static uint32_t stringBytes(uint8_t length) {
+    return length == 255 ? 0 : length;
+  }
+
+  void parseHeader() {
+    memcpy(&header, header_bytes, sizeof(header));
+    if (header.magic != DULUX_MAGIC_NUMBER || !duluxIsSupportedVersion(header.version)) {
+      fail("not a dulux palette");
+    } else if (header.color_count == 0 || header.color_count > DULUX_UPLOAD_MAX_COLORS) {
+      fail("unsupported color count");
+    } else if (header.version == DULUX_BINARY_VERSION) {
+      enterRecord();
+    } else {
+      stage = Stage::BODY;
+    }
+  }
+
+  // Advance the parser and the CRC over one chunk; only counters change, no bytes are kept
+  void parse(const uint8_t* data, size_t length) {
+    size_t pos = 0;
+    size_t crc_pos = 0;  // Chunk bytes already folded into crc
+    while (pos < length && stage != Stage::FAILED) {
+      switch (stage) {
+        case Stage::HEADER: {
+          uint32_t const HAVE = bytes_received + pos;
+          size_t const TAKE = std::min<size_t>(DULUX_HEADER_SIZE - HAVE, length - pos);
+          memcpy(header_bytes + HAVE, data + pos, TAKE);
+          pos += TAKE;
+          if (HAVE + TAKE == DULUX_HEADER_SIZE) {
+            parseHeader();
+          }
+          break;
+        }
+        case Stage::FIXED:
+        case Stage::NAME:
+        case Stage::CODE: {
+          size_t const TAKE = std::min<size_t>(remaining, length - pos);
+          pos += TAKE;
+          remaining -= TAKE;
+          if (remaining == 0) {
+            stage = stage == Stage::FIXED  ? Stage::NAME_LENGTH
+                    : stage == Stage::NAME ? Stage::CODE_LENGTH
+                                           : Stage::FLAG;
+          }
+          break;
+        }
+        case Stage::NAME_LENGTH:
+        case Stage::CODE_LENGTH:
+          remaining = stringBytes(data[pos++]);
+          stage = stage == Stage::NAME_LENGTH ? Stage::NAME : Stage::CODE;
+          if (remaining == 0) {
+            stage = stage == Stage::NAME ? Stage::CODE_LENGTH : Stage::FLAG;
+          }
+          break;
+        case Stage::FLAG:
+          pos++;
+          colors_parsed++;
+          enterRecord();
+          if (stage == Stage::TRAILER) {
+            // The compiler trailer covers every byte up to the end of the last record
+            crc = duluxCrc32(crc, data + crc_pos, pos - crc_pos);
+            crc_pos = pos;
+            records_crc = crc;
+          }
+          break;
+        case Stage::TRAILER:
+          if (tail_length + (length - pos) > sizeof(tail)) {
+            fail("unexpected data after the last color");
+            break;
+          }
+          memcpy(tail + tail_length, data + pos, length - pos);
+          tail_length += length - pos;
+          pos = length;
+          break;
+        case Stage::BODY:
+          pos = length;
+          break;
+        case Stage::FAILED:
+          break;
+      }
+    }
+    crc = duluxCrc32(crc, data + crc_pos, length - crc_pos);
+  }
+
+  // v2: the section table must lie inside the file and every section inside the data
+  bool checkSectionTable() {
+    File image = LittleFS.open(temp, "r");
+    if (!image) {
+      return false;
+    }
+    uint32_t count = 0;
+    if (header.reserved < DULUX_HEADER_SIZE || header.reserved + 4 > bytes_received ||
+        !image.seek(header.reserved) ||
+        image.read(reinterpret_cast<uint8_t*>(&count), 4) != 4 || count == 0 ||
+        count > DULUX_UPLOAD_MAX_SECTIONS ||
+        header.reserved + 4 + (count * sizeof(DuluxSectionEntry)) > bytes_received) {
+      return false;
+    }
+    bool found_rgb = false;
+    for (uint32_t i = 0; i < count; i++) {
+      DuluxSectionEntry entry{};
+      if (image.read(reinterpret_cast<uint8_t*>(&entry), sizeof(entry)) != sizeof(entry) ||
+          (uint64_t)entry.offset + entry.size > bytes_received) {
+        return false;
+      }
+      if (entry.tag == DULUX_SECTION_META && entry.size >= sizeof(DuluxPaletteMeta)) {
+        DuluxPaletteMeta meta{};
+        size_t const NEXT = image.position();
+        if (!image.seek(entry.offset) ||
+            image.read(reinterpret_cast<uint8_t*>(&meta), sizeof(meta)) != sizeof(meta) ||
+            !image.seek(NEXT)) {
+          return false;
+        }
+        palette_crc = meta.palette_crc;
+      }
+      found_rgb = found_rgb || (entry.tag == DULUX_SECTION_RGB &&
+                                entry.size >= header.color_count * 3ULL);
+    }
+    return found_rgb;
+  }
+
+  // Move the finished upload over the target. An existing target is renamed aside first and
+  // renamed back if the upload cannot take its place, so a failed replace never loses it
+  bool replaceTarget() {
+    char backup[sizeof(temp)];
+    snprintf(backup, sizeof(backup), "%s.old", target);
+    bool const HAD_TARGET = LittleFS.exists(target);
+    if (HAD_TARGET) {
+      LittleFS.remove(backup);  // Left over from an interrupted earlier replace
+      if (!LittleFS.rename(target, backup)) {
+        return false;
+      }
+    }
+    if (!LittleFS.rename(temp, target)) {
+      if (HAD_TARGET) {
+        LittleFS.rename(backup, target);
+      }
+      return false;
+    }
+    if (HAD_TARGET) {
+      LittleFS.remove(backup);
+    }
+    return true;
+  }
+
+  void reset() {
+    stage = Stage::HEADER;
+    remaining = 0;
+    colors_parsed = 0;
+    tail_length = 0;
+    crc = 0;
+    records_crc = 0;
+    palette_crc = 0;
+    bytes_received = 0;
+    error = nullptr;
+  }
+
+ public:
+  DuluxPaletteUpload() = default;
+  DuluxPaletteUpload(const DuluxPaletteUpload&) = delete;
+  DuluxPaletteUpload& operator=(const DuluxPaletteUpload&) = delete;
+
+  /**
+   * @brief Start an upload that will replace target_path once complete
+   */
+  bool begin(const char* target_path) {
+    abort();
+    reset();
+    if (!target_path || target_path[0] != '/' || strlen(target_path) >= sizeof(target)) {
+      error = "invalid target path";
+      return false;
+    }
+    strncpy(target, target_path, sizeof(target) - 1);
+    snprintf(temp, sizeof(temp), "%s.part", target);
+
+    file = LittleFS.open(temp, "w");
+    if (!file) {
+      error = "cannot create upload file";
+      return false;
+    }
+    active = true;
+    Serial.printf("[Upload] Receiving palette into %s\n", temp);
+    return true;
+  }
+
+  /**
+   * @brief Append one chunk: written to flash immediately, then parsed
+   * @return false once the upload has failed (further chunks are ignored)
+   */
+  bool write(const uint8_t* data, size_t length) {
+    if (!active || stage == Stage::FAILED) {
+      return false;
+    }
+    if (file.write(data, length) != length) {
+      fail("filesystem full or write error");
+      return false;
+    }
+    parse(data, length);
+    bytes_received += length;
+    return stage != Stage::FAILED;
+  }
+
+  /**
+   * @brief Validate the complete upload and move it over the target path
+   * @return false (and the target untouched) if the file is truncated or corrupt
+   */
+  bool finish() {
+    if (!active) {
+      return false;
+    }
+    file.close();
+    active = false;
+
+    if (stage == Stage::BODY) {
+      if (!checkSectionTable()) {
+        fail("invalid v2 section table");
+      } else if (palette_crc == 0) {
+        palette_crc = crc;
+      }
+    } else if (stage == Stage::TRAILER) {
+      uint32_t trailer_crc = 0;
+      if (tail_length == 0) {
+        palette_crc = crc;
+      } else if (tail_length == sizeof(tail) && duluxParseV1Trailer(tail, trailer_crc)) {
+        if (trailer_crc != records_crc) {
+          fail("CRC mismatch");
+        }
+        palette_crc = trailer_crc;
+      } else {
+        fail("unexpected data after the last color");
+      }
+    } else if (stage != Stage::FAILED) {
+      fail("upload truncated");
+    }
+
+    if (stage == Stage::FAILED || !replaceTarget()) {
+      fail("cannot replace target file");
+      LittleFS.remove(temp);
+      Serial.printf("[Upload] Rejected %s: %s\n", target, error);
+      return false;
+    }
+    Serial.printf("[Upload] Stored %s: %u colors, %u bytes, CRC 0x%08X\n", target,
+                  (unsigned)header.color_count, (unsigned)bytes_received, palette_crc);
+    return true;
+  }
+
+  /**
+   * @brief Drop an unfinished upload and its temporary file
+   */
+  void abort() {
+    if (active) {
+      file.close();
+      LittleFS.remove(temp);
+      active = false;
+    }
+  }
+
+  bool isActive() const {
+    return active;
+  }
+  const char* getTarget() const {
+    return target;
+  }
+  const char* getError() const {
+    return error ? error : "";
+  }
+  uint32_t getColorCount() const {
+    return header.color_count;
+  }
+  uint32_t getBytesReceived() const {
+    return bytes_received;
+  }
+  uint32_t getPaletteCrc() const {
+    return palette_crc;
+  }
+};
+
+#endif  // DULUX_PALETTE_UPLOAD_H
@@ -0,0 +1,358 @@
+/**
+ * @file dulux_palette_view.h
+ * @brief Read-only, zero-copy view over a v2 palette image held in memory
+ *
+ * The view never allocates: every accessor reads straight from the image,
+ * which may live in memory-mapped flash, PSRAM or a host mmap. Multi-byte
+ * fields are fetched with memcpy because flash-cache mappings do not
+ * tolerate unaligned loads.
+ */
+
+#ifndef DULUX_PALETTE_VIEW_H
+#define DULUX_PALETTE_VIEW_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dulux_front_coding.h"
+#include "dulux_match_metric.h"
+#include "dulux_palette_format.h"
+
+#ifdef ARDUINO
+  #include <Arduino.h>
+  #define DULUX_PALETTE_LOG(...) Serial.printf(__VA_ARGS__)
+  #define DULUX_PALETTE_MICROS() micros()
+#else
+  #include <stdio.h>
+  #include <time.h>
+  #define DULUX_PALETTE_LOG(...) printf(__VA_ARGS__)
+  #define DULUX_PALETTE_MICROS() duluxHostMicros()
+
+inline unsigned long duluxHostMicros() {
+  timespec now{};
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long)((now.tv_sec * 1000000UL) + (now.tv_nsec / 1000));
+}
+#endif
+
+class DuluxPaletteView {
+ private:
+  const uint8_t* image{nullptr};
+  size_t image_size{0};
+  uint32_t color_count{0};
+
+  // Column base pointers inside the image
+  const uint8_t* rgb_column{nullptr};
+  const uint8_t* lab_column{nullptr};
+  const uint8_t* lrv_column{nullptr};
+  const uint8_t* id_column{nullptr};
+  const uint8_t* flag_column{nullptr};
+  const uint8_t* name_column{nullptr};
+  const uint8_t* code_column{nullptr};
+  const char* string_heap{nullptr};
+  uint32_t string_heap_size{0};
+
+  // Front-coded strings (used instead of the name/code columns when present)
+  const uint8_t* name_fc{nullptr};
+  const uint8_t* code_fc{nullptr};
+  DuluxFrontCodedLayout name_layout{};
+  DuluxFrontCodedLayout code_layout{};
+  const uint8_t* section_table{nullptr};
+  uint32_t section_count{0};
+  uint32_t palette_crc{0};
+
+  template <typename T>
+  static T load(const uint8_t* p) {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+  }
+
+  // Resolve a column and check that it holds one stride-sized slot per color
+  const uint8_t* column(const uint8_t* table, uint32_t section_count, uint32_t tag,
+                        uint32_t stride, uint32_t* size_out = nullptr) const {
+    for (uint32_t i = 0; i < section_count; i++) {
+      auto const ENTRY = load<DuluxSectionEntry>(table + (i * sizeof(DuluxSectionEntry)));
+      if (ENTRY.tag != tag) {
+        continue;
+      }
+      if ((uint64_t)ENTRY.offset + ENTRY.size > image_size ||
+          ENTRY.size < (uint64_t)stride * color_count) {
+        DULUX_PALETTE_LOG("[Palette] Section 0x%08X out of bounds\n", (unsigned)tag);
+        return nullptr;
+      }
+      if (size_out) {
+        *size_out = ENTRY.size;
+      }
+      return image + ENTRY.offset;
+    }
+    DULUX_PALETTE_LOG("[Palette] Missing section 0x%08X\n", (unsigned)tag);
+    return nullptr;
+  }
+
+  const char* heapString(const uint8_t* offsets, uint32_t index) const {
+    if (!offsets) {
+      return nullptr;  // Front-coded palette: use copyName()/copyCode()
+    }
+    uint32_t const OFFSET = load<uint32_t>(offsets + (index * 4));
+    return OFFSET < string_heap_size ? string_heap + OFFSET : "";
+  }
+
+  // Resolve an optional front-coded section and validate its layout
+  const uint8_t* frontCoded(uint32_t tag, DuluxFrontCodedLayout& layout) const {
+    uint32_t size = 0;
+    const uint8_t* data = section(tag, &size);
+    if (!data || size < sizeof(DuluxFrontCodedHeader) ||
+        !duluxFrontCodedLayout(load<DuluxFrontCodedHeader>(data), size, color_count, layout)) {
+      return nullptr;
+    }
+    return data;
+  }
+
+  size_t copyString(const char* inline_str, const uint8_t* fc, const DuluxFrontCodedLayout& layout,
+                    uint32_t index, char* out, size_t out_size) const {
+    if (out_size == 0) {
+      return 0;
+    }
+    if (inline_str) {
+      strncpy(out, inline_str, out_size - 1);
+      out[out_size - 1] = '\0';
+      return strlen(out);
+    }
+    if (fc && duluxFrontCodedDecode(fc, layout, index, out, out_size) >= 0) {
+      return strlen(out);
+    }
+    out[0] = '\0';
+    return 0;
+  }
+
+ public:
+  /**
+   * @brief Validate a v2 image and resolve its column pointers
+   * @param data Start of the image (must stay valid while the view is used)
+   * @param size Number of readable bytes at data
+   * @return true if the image is a well-formed v2 palette
+   */
+  bool attach(const uint8_t* data, size_t size) {
+    detach();
+    if (!data || size < DULUX_HEADER_SIZE) {
+      return false;
+    }
+
+    auto const HEADER = load<DuluxBinaryHeader>(data);
+    if (HEADER.magic != DULUX_MAGIC_NUMBER) {
+      DULUX_PALETTE_LOG("[Palette] Invalid magic: 0x%08X\n", (unsigned)HEADER.magic);
+      return false;
+    }
+    if (HEADER.version != DULUX_BINARY_VERSION_V2) {
+      // v1 entries are variable length and would need a heap-allocated offset table
+      DULUX_PALETTE_LOG("[Palette] Zero-copy access requires a v2 image (found v%u)\n",
+                        (unsigned)HEADER.version);
+      return false;
+    }
+    if ((uint64_t)HEADER.reserved + 4 > size) {
+      DULUX_PALETTE_LOG("[Palette] Section table outside image\n");
+      return false;
+    }
+
+    uint32_t const SECTION_COUNT = load<uint32_t>(data + HEADER.reserved);
+    const uint8_t* table = data + HEADER.reserved + 4;
+    if ((uint64_t)HEADER.reserved + 4 + ((uint64_t)SECTION_COUNT * sizeof(DuluxSectionEntry)) >
+        size) {
+      DULUX_PALETTE_LOG("[Palette] Truncated section table\n");
+      return false;
+    }
+
+    image = data;
+    image_size = size;
+    color_count = HEADER.color_count;
+    section_table = table;
+    section_count = SECTION_COUNT;
+
+    rgb_column = column(table, SECTION_COUNT, DULUX_SECTION_RGB, 3);
+    lab_column = column(table, SECTION_COUNT, DULUX_SECTION_LAB, sizeof(DuluxLabFixed));
+    lrv_column = column(table, SECTION_COUNT, DULUX_SECTION_LRV, 2);
+    id_column = column(table, SECTION_COUNT, DULUX_SECTION_ID, 4);
+    flag_column = column(table, SECTION_COUNT, DULUX_SECTION_FLAGS, 1);
+    if (!rgb_column || !lab_column || !lrv_column || !id_column || !flag_column) {
+      detach();
+      return false;
+    }
+
+    // Palette identity: compiler-stamped META CRC, else CRC of the whole image
+    uint32_t meta_size = 0;
+    const uint8_t* meta = section(DULUX_SECTION_META, &meta_size);
+    palette_crc = meta && meta_size >= sizeof(DuluxPaletteMeta)
+                      ? load<DuluxPaletteMeta>(meta).palette_crc
+                      : duluxCrc32(0, data, size);
+
+    // Strings: front-coded sections when present, otherwise offset columns + heap
+    name_fc = frontCoded(DULUX_SECTION_NAME_FC, name_layout);
+    code_fc = frontCoded(DULUX_SECTION_CODE_FC, code_layout);
+    if (name_fc && code_fc) {
+      return true;
+    }
+    name_fc = nullptr;
+    code_fc = nullptr;
+
+    name_column = column(table, SECTION_COUNT, DULUX_SECTION_NAME, 4);
+    code_column = column(table, SECTION_COUNT, DULUX_SECTION_CODE, 4);
+    const uint8_t* heap =
+        column(table, SECTION_COUNT, DULUX_SECTION_STRINGS, 0, &string_heap_size);
+    if (!name_column || !code_column || !heap) {
+      detach();
+      return false;
+    }
+
+    string_heap = reinterpret_cast<const char*>(heap);
+    return true;
+  }
+
+  /**
+   * @brief Forget the attached image
+   */
+  void detach() {
+    *this = DuluxPaletteView();
+  }
+
+  bool isAttached() const {
+    return image != nullptr;
+  }
+  uint32_t getColorCount() const {
+    return color_count;
+  }
+  size_t getImageSize() const {
+    return image_size;
+  }
+  uint32_t getPaletteCrc() const {
+    return palette_crc;
+  }
+
+  /**
+   * @brief Size of the image as described by its sections (may be below the mapping size)
+   */
+  static size_t describedSize(const uint8_t* data, size_t available) {
+    if (available < DULUX_HEADER_SIZE) {
+      return 0;
+    }
+    auto const HEADER = load<DuluxBinaryHeader>(data);
+    if (HEADER.magic != DULUX_MAGIC_NUMBER || HEADER.version != DULUX_BINARY_VERSION_V2 ||
+        (uint64_t)HEADER.reserved + 4 > available) {
+      return 0;
+    }
+    uint32_t const SECTION_COUNT = load<uint32_t>(data + HEADER.reserved);
+    uint64_t end =
+        (uint64_t)HEADER.reserved + 4 + ((uint64_t)SECTION_COUNT * sizeof(DuluxSectionEntry));
+    if (end > available) {
+      return 0;
+    }
+    for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+      auto const ENTRY = load<DuluxSectionEntry>(data + HEADER.reserved + 4 +
+                                                 (i * sizeof(DuluxSectionEntry)));
+      uint64_t const SECTION_END = (uint64_t)ENTRY.offset + ENTRY.size;
+      end = SECTION_END > end ? SECTION_END : end;
+    }
+    return end <= available ? (size_t)end : 0;
+  }
+
+  /**
+   * @brief Locate an optional section (META, KDT3, ...) inside the image
+   * @param size_out Receives the section size in bytes
+   * @return Pointer to the section payload, or nullptr if absent or out of bounds
+   */
+  const uint8_t* section(uint32_t tag, uint32_t* size_out) const {
+    for (uint32_t i = 0; i < section_count; i++) {
+      auto const ENTRY = load<DuluxSectionEntry>(section_table + (i * sizeof(DuluxSectionEntry)));
+      if (ENTRY.tag == tag && (uint64_t)ENTRY.offset + ENTRY.size <= image_size) {
+        *size_out = ENTRY.size;
+        return image + ENTRY.offset;
+      }
+    }
+    *size_out = 0;
+    return nullptr;
+  }
+
+  // Column accessors - index must be below getColorCount()
+  const uint8_t* rgb(uint32_t index) const {
+    return rgb_column + (index * 3);
+  }
+  DuluxLabFixed lab(uint32_t index) const {
+    return load<DuluxLabFixed>(lab_column + (index * sizeof(DuluxLabFixed)));
+  }
+  uint16_t lrvScaled(uint32_t index) const {
+    return load<uint16_t>(lrv_column + (index * 2));
+  }
+  uint32_t id(uint32_t index) const {
+    return load<uint32_t>(id_column + (index * 4));
+  }
+  bool lightText(uint32_t index) const {
+    return (flag_column[index] & DULUX_FLAG_LIGHT_TEXT) != 0;
+  }
+
+  /**
+   * @brief Check whether names/codes are stored as plain strings in the image
+   */
+  bool hasInlineStrings() const {
+    return name_column != nullptr;
+  }
+
+  // In-image strings; nullptr when the palette is front-coded (see copyName())
+  const char* name(uint32_t index) const {
+    return heapString(name_column, index);
+  }
+  const char* code(uint32_t index) const {
+    return heapString(code_column, index);
+  }
+
+  /**
+   * @brief Copy (front-coded palettes: decode) a name into a caller buffer
+   * @return Length written, excluding the terminator
+   */
+  size_t copyName(uint32_t index, char* out, size_t out_size) const {
+    return copyString(name(index), name_fc, name_layout, index, out, out_size);
+  }
+  size_t copyCode(uint32_t index, char* out, size_t out_size) const {
+    return copyString(code(index), code_fc, code_layout, index, out, out_size);
+  }
+
+  /**
+   * @brief Exhaustive scan over the LAB/RGB columns with the shared match metric
+   * @param distance_out Receives the winning distance (optional)
+   * @return Index of the closest color, or getColorCount() if the view is empty
+   */
+  uint32_t findClosest(uint8_t r, uint8_t g, uint8_t b, float* distance_out = nullptr) const {
+    CIEDE2000::LAB target_lab;
+    rgbToLAB(r, g, b, target_lab);
+
+    float best_distance = 0.0f;
+    uint32_t const BEST = findClosestInRange(0, color_count, r, g, b, target_lab, best_distance);
+    if (distance_out) {
+      *distance_out = best_distance;
+    }
+    return BEST;
+  }
+
+  /**
+   * @brief The same scan over colors [lo, hi) only (one shard of DuluxParallelScan)
+   * @return Index of the closest color in the range, or getColorCount() if it is empty
+   */
+  uint32_t findClosestInRange(uint32_t lo, uint32_t hi, uint8_t r, uint8_t g, uint8_t b,
+                              const CIEDE2000::LAB& target_lab, float& best_distance) const {
+    uint32_t best_index = color_count;
+    best_distance = 999999.0f;
+
+    for (uint32_t i = lo; i < hi; i++) {
+      const uint8_t* candidate = rgb(i);
+      float const DISTANCE = duluxCandidateDistance(r, g, b, target_lab, candidate[0],
+                                                    candidate[1], candidate[2],
+                                                    duluxLabFromFixed(lab(i)));
+      if (DISTANCE < best_distance) {
+        best_distance = DISTANCE;
+        best_index = i;
+      }
+    }
+    return best_index;
+  }
+};
+
+#endif  // DULUX_PALETTE_VIEW_H
@@ -0,0 +1,295 @@
+/**
+ * @file dulux_parallel_scan.h
+ * @brief Palette scans split across every core
+ *
+ * A scan is cut into one shard per core. Each shard is reduced to its own
+ * best entry, and the shard winners are merged by distance, ties going to
+ * the lower palette index as in the plain scans, so the answer never
+ * differs from a scan on one core. findClosest() cuts a palette into
+ * contiguous index ranges; scan() runs any shard function, which is how
+ * DuluxExactScan spreads its L* window over the workers.
+ *
+ * On the ESP32-S3 one worker task is pinned to each core at begin() and
+ * sleeps on a semaphore between scans; the caller hands out the shards and
+ * blocks until they are done, so its own core is free for the worker pinned
+ * there. One scan runs at a time: a caller that finds the workers busy scans
+ * serially on its own core rather than waiting. The host build starts a
+ * std::thread per extra core and scans the first shard itself.
+ *
+ * A palette type only needs findClosestInRange() (see DuluxPaletteArena and
+ * DuluxPaletteView).
+ */
+
+#ifndef DULUX_PARALLEL_SCAN_H
+#define DULUX_PARALLEL_SCAN_H
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+
+#include "CIEDE2000.h"
+#include "dulux_match_metric.h"
+
+#if defined(ESP_PLATFORM)
+  #include <Arduino.h>
+  #include <freertos/FreeRTOS.h>
+  #include <freertos/semphr.h>
+  #include <freertos/task.h>
+#else
+  #include <thread>
+#endif
+
+// Shards (= workers) to use; may be predefined to override the core count
+#ifndef DULUX_PARALLEL_CORES
+  #if defined(ESP_PLATFORM)
+    #define DULUX_PARALLEL_CORES portNUM_PROCESSORS
+  #else
+    #define DULUX_PARALLEL_CORES std::max(1U, std::thread::hardware_concurrency())
+  #endif
+#endif
+
+#define DULUX_PARALLEL_MAX_SHARDS 8        // Upper bound on shards (one per core)
+#define DULUX_PARALLEL_MIN_COLORS 512      // Smaller scans run serially
+#define DULUX_PARALLEL_TASK_STACK 4096     // Bytes of stack per worker task
+#define DULUX_PARALLEL_TASK_PRIORITY 2     // Above loop(), below WiFi and the web server
+
+/**
+ * @brief Best entry of one shard
+ */
+struct DuluxScanShard {
+  uint32_t index;  // Palette index, or the color count if the shard was empty
+  float distance;
+
+  bool isBetterThan(const DuluxScanShard& other) const {
+    return distance < other.distance || (distance == other.distance && index < other.index);
+  }
+};
+
+/**
+ * @brief Counters since begin()
+ */
+struct DuluxParallelScanStats {
+  uint32_t parallel;  // Scans split across the workers
+  uint32_t serial;    // Scans run on the caller alone (small palette or workers busy)
+  uint32_t busy;      // Of those, scans that found another scan in progress
+};
+
+class DuluxParallelScan {
+ private:
+  // Type-erased shard job: runs shard `shard` of `shards` of the scan behind context
+  using ShardFunction = DuluxScanShard (*)(const void* context, uint32_t shard,
+                                           uint32_t shards);
+
+  struct Job {
+    ShardFunction function;
+    const void* context;
+    uint32_t work;  // Entries the whole scan covers
+  };
+
+  template <typename Shard>
+  static DuluxScanShard runShard(const void* context, uint32_t shard, uint32_t shards) {
+    return (*static_cast<const Shard*>(context))(shard, shards);
+  }
+
+  static uint32_t shardStart(uint32_t count, uint32_t shard, uint32_t shards) {
+    return (uint32_t)(((uint64_t)count * shard) / shards);
+  }
+
+  uint32_t shard_count{1};
+  bool started{false};
+  std::atomic<uint32_t> parallel_scans{0};
+  std::atomic<uint32_t> serial_scans{0};
+  std::atomic<uint32_t> busy_scans{0};
+
+#if defined(ESP_PLATFORM)
+  struct Worker {
+    DuluxParallelScan* owner;
+    uint32_t shard;
+    SemaphoreHandle_t start;
+    TaskHandle_t task;
+  };
+
+  Worker workers[DULUX_PARALLEL_MAX_SHARDS]{};
+  SemaphoreHandle_t done{nullptr};   // Given once by each worker per scan
+  SemaphoreHandle_t owner{nullptr};  // Held by the task whose scan the workers run
+  Job job{nullptr, nullptr, 0};
+  DuluxScanShard results[DULUX_PARALLEL_MAX_SHARDS]{};
+
+  static void workerTask(void* parameter) {
+    Worker* const WORKER = static_cast<Worker*>(parameter);
+    DuluxParallelScan* const SCAN = WORKER->owner;
+    for (;;) {
+      xSemaphoreTake(WORKER->start, portMAX_DELAY);
+      const Job& job = SCAN->job;
+      SCAN->results[WORKER->shard] =
+          job.function(job.context, WORKER->shard, SCAN->shard_count);
+      xSemaphoreGive(SCAN->done);
+    }
+  }
+
+  // Undo a begin() that failed part way: workers are idle on their start semaphores, so they
+  // are deleted before the semaphores they wait on
+  void stopWorkers() {
+    for (Worker& worker : workers) {
+      if (worker.task) {
+        vTaskDelete(worker.task);
+      }
+      if (worker.start) {
+        vSemaphoreDelete(worker.start);
+      }
+      worker = {};
+    }
+    if (done) {
+      vSemaphoreDelete(done);
+      done = nullptr;
+    }
+    if (owner) {
+      vSemaphoreDelete(owner);
+      owner = nullptr;
+    }
+  }
+#endif
+
+  DuluxScanShard run(const Job& job) {
+    if (!started || shard_count < 2 || job.work < DULUX_PARALLEL_MIN_COLORS) {
+      serial_scans.fetch_add(1, std::memory_order_relaxed);
+      return job.function(job.context, 0, 1);
+    }
+
+#if defined(ESP_PLATFORM)
+    if (xSemaphoreTake(owner, 0) != pdTRUE) {
+      busy_scans.fetch_add(1, std::memory_order_relaxed);
+      serial_scans.fetch_add(1, std::memory_order_relaxed);
+      return job.function(job.context, 0, 1);
+    }
+    this->job = job;
+    for (uint32_t i = 0; i < shard_count; i++) {
+      xSemaphoreGive(workers[i].start);
+    }
+    for (uint32_t i = 0; i < shard_count; i++) {
+      xSemaphoreTake(done, portMAX_DELAY);
+    }
+    DuluxScanShard shards[DULUX_PARALLEL_MAX_SHARDS];
+    std::copy(results, results + shard_count, shards);
+    xSemaphoreGive(owner);
+#else
+    DuluxScanShard shards[DULUX_PARALLEL_MAX_SHARDS];
+    std::thread threads[DULUX_PARALLEL_MAX_SHARDS];
+    for (uint32_t i = 1; i < shard_count; i++) {
+      threads[i] = std::thread(
+          [&shards, &job, i, this]() { shards[i] = job.function(job.context, i, shard_count); });
+    }
+    shards[0] = job.function(job.context, 0, shard_count);
+    for (uint32_t i = 1; i < shard_count; i++) {
+      threads[i].join();
+    }
+#endif
+
+    DuluxScanShard best = shards[0];
+    for (uint32_t i = 1; i < shard_count; i++) {
+      if (shards[i].isBetterThan(best)) {
+        best = shards[i];
+      }
+    }
+    parallel_scans.fetch_add(1, std::memory_order_relaxed);
+    return best;
+  }
+
+ public:
+  DuluxParallelScan() = default;
+  DuluxParallelScan(const DuluxParallelScan&) = delete;
+  DuluxParallelScan& operator=(const DuluxParallelScan&) = delete;
+
+  /**
+   * @brief Start one worker per core (host: only records the core count)
+   * @return false if the workers could not be created; whatever was created is freed, scans
+   *         run serially and begin() may be called again
+   */
+  bool begin() {
+    if (started) {
+      return true;
+    }
+    shard_count = std::min<uint32_t>(DULUX_PARALLEL_CORES, DULUX_PARALLEL_MAX_SHARDS);
+
+#if defined(ESP_PLATFORM)
+    done = xSemaphoreCreateCounting(DULUX_PARALLEL_MAX_SHARDS, 0);
+    owner = xSemaphoreCreateMutex();
+    if (!done || !owner) {
+      Serial.println("[ParallelScan] Cannot create semaphores - scanning serially");
+      stopWorkers();
+      return false;
+    }
+    for (uint32_t i = 0; i < shard_count; i++) {
+      workers[i] = {this, i, xSemaphoreCreateBinary(), nullptr};
+      // Worker i is pinned to core i; the handle is kept only to undo a failed begin()
+      if (!workers[i].start ||
+          xTaskCreatePinnedToCore(workerTask, "palette_scan", DULUX_PARALLEL_TASK_STACK,
+                                  &workers[i], DULUX_PARALLEL_TASK_PRIORITY, &workers[i].task,
+                                  (BaseType_t)i) != pdPASS) {
+        Serial.printf("[ParallelScan] Cannot start worker %u - scanning serially\n",
+                      (unsigned)i);
+        workers[i].task = nullptr;
+        stopWorkers();
+        return false;
+      }
+    }
+    Serial.printf("[ParallelScan] %u workers pinned, one per core\n", (unsigned)shard_count);
+#endif
+
+    started = true;
+    return true;
+  }
+
+  /**
+   * @brief Run a scan shard by shard and merge the shard winners
+   * @param work Entries the whole scan covers; smaller than DULUX_PARALLEL_MIN_COLORS runs
+   *        serially
+   * @param shard Callable DuluxScanShard(uint32_t shard, uint32_t shards) returning the best
+   *        entry of one shard; called concurrently, and as (0, 1) for a serial scan
+   */
+  template <typename Shard>
+  DuluxScanShard scan(uint32_t work, const Shard& shard) {
+    return run({runShard<Shard>, &shard, work});
+  }
+
+  /**
+   * @brief Closest palette entry under the shared metric, scanned shard by shard
+   * @param palette Anything with findClosestInRange(lo, hi, r, g, b, lab, distance)
+   *        and getColorCount()
+   * @param distance_out Receives the winning distance (optional)
+   * @return The index palette.findClosest() returns, or getColorCount() if empty
+   */
+  template <typename Palette>
+  uint32_t findClosest(const Palette& palette, uint8_t r, uint8_t g, uint8_t b,
+                       float* distance_out = nullptr) {
+    CIEDE2000::LAB lab;
+    rgbToLAB(r, g, b, lab);
+    uint32_t const COUNT = palette.getColorCount();
+    DuluxScanShard const BEST = scan(COUNT, [&](uint32_t shard, uint32_t shards) {
+      DuluxScanShard best{0, 0.0f};
+      best.index = palette.findClosestInRange(shardStart(COUNT, shard, shards),
+                                              shardStart(COUNT, shard + 1, shards), r, g, b,
+                                              lab, best.distance);
+      return best;
+    });
+    if (distance_out) {
+      *distance_out = BEST.distance;
+    }
+    return BEST.index;
+  }
+
+  bool isStarted() const {
+    return started;
+  }
+  uint32_t getShardCount() const {
+    return started ? shard_count : 1;
+  }
+  DuluxParallelScanStats getStats() const {
+    return {parallel_scans.load(std::memory_order_relaxed),
+            serial_scans.load(std::memory_order_relaxed),
+            busy_scans.load(std::memory_order_relaxed)};
+  }
+};
+
+#endif  // DULUX_PARALLEL_SCAN_H
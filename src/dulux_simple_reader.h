@@ -14,11 +14,17 @@
 #include <LittleFS.h>
 #include <math.h>
 
+#include <algorithm>
+
 #include "CIEDE2000.h"
+#include "dulux_front_coding.h"
+#include "dulux_match_metric.h"
+#include "dulux_palette_format.h"
+#include "psram_utils.h"
 
-// Binary format constants
-#define DULUX_MAGIC_NUMBER 0x584C5544  // "DULX" in little-endian
-#define DULUX_BINARY_VERSION 1
+#define DULUX_INDEX_SCAN_BUFFER 1024  // Chunk size used while building the offset index
+#define DULUX_SCAN_BATCH 64           // Colors per column read during a v2 scan
+#define DULUX_MAX_SECTIONS 32         // Upper bound accepted for the v2 section table
 
 /**
  * @brief Simple color structure for streaming access
@@ -43,7 +49,8 @@ struct SimpleColor {
  * @brief Simple streaming color database reader
  *
  * This class reads colors one at a time from the binary file
- * without loading the entire database into memory.
+ * without loading the entire database into memory. Both the row oriented
+ * v1 layout and the columnar v2 layout are accepted.
  */
 class DuluxSimpleReader {
  private:
@@ -51,6 +58,35 @@ class DuluxSimpleReader {
   uint32_t total_colors{0};
   uint32_t current_position{0};
   bool file_open{false};
+  uint32_t format_version{0};
+
+  // v1: file offset of every record, built once in openDatabase() (PSRAM)
+  PSRAMVector<uint32_t> entry_offsets;
+
+  // v2: absolute offsets of the column sections
+  struct V2Columns {
+    uint32_t rgb;
+    uint32_t lab;
+    uint32_t lrv;
+    uint32_t id;
+    uint32_t flags;
+    uint32_t name;
+    uint32_t code;
+    uint32_t strings;
+    uint32_t strings_size;
+    uint32_t name_fc;  // Front-coded sections (0 = plain NAME/CODE/STRS)
+    uint32_t code_fc;
+    DuluxFrontCodedLayout name_layout;
+    DuluxFrontCodedLayout code_layout;
+  } columns{};
+
+  // v2: full section table, kept for optional sections (META, KDT3)
+  DuluxSectionEntry sections[DULUX_MAX_SECTIONS]{};
+  uint32_t section_count{0};
+
+  // Palette identity, computed on first use (see dulux_palette_format.h)
+  uint32_t palette_crc{0};
+  bool palette_crc_valid{false};
 
   // Simple cache for last result
   struct ColorCache {
@@ -87,6 +123,295 @@ class DuluxSimpleReader {
     return true;
   }
 
+  /**
+   * @brief Record the file offset of every color entry in a single buffered pass
+   *
+   * Records are variable length (length-prefixed strings), so this is the only
+   * sequential walk over the file; afterwards any index resolves with one seek.
+   */
+  bool buildOffsetIndex() {
+    if (!PSRAMUtils::safe_reserve(entry_offsets, total_colors)) {
+      Serial.printf("Failed to allocate offset index for %u colors\n", total_colors);
+      return false;
+    }
+
+    uint8_t buffer[DULUX_INDEX_SCAN_BUFFER];
+    uint32_t chunk_start = DULUX_HEADER_SIZE;
+    size_t const FILE_SIZE = file.size();
+
+    while (entry_offsets.size() < total_colors && chunk_start < FILE_SIZE) {
+      file.seek(chunk_start);
+      size_t const CHUNK_LEN = file.read(buffer, sizeof(buffer));
+      size_t pos = 0;
+
+      // Consume every record that lies completely inside the chunk
+      while (entry_offsets.size() < total_colors) {
+        size_t cursor = pos + DULUX_FIXED_FIELDS_SIZE;
+        if (cursor >= CHUNK_LEN) {
+          break;
+        }
+        uint8_t const NAME_LEN = buffer[cursor] == 255 ? 0 : buffer[cursor];
+        cursor += 1 + NAME_LEN;
+        if (cursor >= CHUNK_LEN) {
+          break;
+        }
+        uint8_t const CODE_LEN = buffer[cursor] == 255 ? 0 : buffer[cursor];
+        cursor += 1 + CODE_LEN + 1;  // code bytes + light text flag
+        if (cursor > CHUNK_LEN) {
+          break;
+        }
+
+        entry_offsets.push_back(chunk_start + pos);
+        pos = cursor;
+      }
+
+      if (pos == 0) {
+        // Not even one record fits - the file is truncated
+        break;
+      }
+      chunk_start += pos;
+    }
+
+    if (entry_offsets.size() != total_colors) {
+      Serial.printf("Offset index incomplete: %u of %u records found\n", entry_offsets.size(),
+                    total_colors);
+      entry_offsets.clear();
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Load and validate the v2 section table referenced by header.reserved
+   */
+  bool loadSectionTable(uint32_t table_offset) {
+    section_count = 0;
+    if (!file.seek(table_offset) ||
+        file.readBytes(reinterpret_cast<char*>(&section_count), 4) != 4 ||
+        section_count == 0 || section_count > DULUX_MAX_SECTIONS) {
+      Serial.println("Failed to read v2 section table");
+      section_count = 0;
+      return false;
+    }
+
+    DuluxSectionEntry* table = sections;
+    size_t const TABLE_BYTES = section_count * sizeof(DuluxSectionEntry);
+    if (file.readBytes(reinterpret_cast<char*>(table), TABLE_BYTES) != TABLE_BYTES) {
+      Serial.println("Truncated v2 section table");
+      section_count = 0;
+      return false;
+    }
+
+    // Every column needs one fixed-size slot per color
+    struct Required {
+      uint32_t tag;
+      uint32_t stride;
+      uint32_t* target;
+    } const REQUIRED[] = {
+        {DULUX_SECTION_RGB, 3, &columns.rgb},
+        {DULUX_SECTION_LAB, sizeof(DuluxLabFixed), &columns.lab},
+        {DULUX_SECTION_LRV, 2, &columns.lrv},
+        {DULUX_SECTION_ID, 4, &columns.id},
+        {DULUX_SECTION_FLAGS, 1, &columns.flags},
+    };
+
+    for (const Required& req : REQUIRED) {
+      const DuluxSectionEntry* entry = duluxFindSection(table, section_count, req.tag);
+      if (!entry || entry->size < (uint64_t)req.stride * total_colors) {
+        Serial.printf("Missing or short v2 section 0x%08X\n", req.tag);
+        return false;
+      }
+      *req.target = entry->offset;
+    }
+
+    // Strings: front-coded sections when present, otherwise offset columns + heap
+    columns.name_fc = loadFrontCoded(DULUX_SECTION_NAME_FC, columns.name_layout);
+    columns.code_fc = loadFrontCoded(DULUX_SECTION_CODE_FC, columns.code_layout);
+    if (columns.name_fc && columns.code_fc) {
+      return true;
+    }
+    columns.name_fc = 0;
+    columns.code_fc = 0;
+
+    const DuluxSectionEntry* names = duluxFindSection(table, section_count, DULUX_SECTION_NAME);
+    const DuluxSectionEntry* codes = duluxFindSection(table, section_count, DULUX_SECTION_CODE);
+    const DuluxSectionEntry* strings = duluxFindSection(table, section_count, DULUX_SECTION_STRINGS);
+    if (!names || !codes || !strings || names->size < 4ULL * total_colors ||
+        codes->size < 4ULL * total_colors) {
+      Serial.println("Missing v2 name/code sections");
+      return false;
+    }
+    columns.name = names->offset;
+    columns.code = codes->offset;
+    columns.strings = strings->offset;
+    columns.strings_size = strings->size;
+    return true;
+  }
+
+  /**
+   * @brief Read and validate the header of a front-coded section
+   * @return Section offset, or 0 if absent or malformed
+   */
+  uint32_t loadFrontCoded(uint32_t tag, DuluxFrontCodedLayout& layout) {
+    const DuluxSectionEntry* entry = duluxFindSection(sections, section_count, tag);
+    DuluxFrontCodedHeader header{};
+    if (!entry || entry->size < sizeof(header) || !file.seek(entry->offset) ||
+        file.readBytes(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header) ||
+        !duluxFrontCodedLayout(header, entry->size, total_colors, layout)) {
+      return 0;
+    }
+    return entry->offset;
+  }
+
+  /**
+   * @brief Decode one front-coded string straight from the file
+   */
+  bool readFrontCoded(uint32_t section_offset, const DuluxFrontCodedLayout& layout,
+                      uint32_t index, char* buffer, size_t buffer_size) {
+    auto fetch = [this, section_offset](uint32_t offset, void* dest, size_t length) {
+      return file.seek(section_offset + offset) &&
+             file.read(static_cast<uint8_t*>(dest), length) == length;
+    };
+    return duluxFrontCodedDecode(fetch, layout, index, buffer, buffer_size) >= 0;
+  }
+
+  /**
+   * @brief Read the name or code of a v2 color, whichever string encoding is used
+   */
+  bool readStringV2(bool code, uint32_t index, char* buffer, size_t buffer_size) {
+    if (columns.name_fc) {
+      return code ? readFrontCoded(columns.code_fc, columns.code_layout, index, buffer, buffer_size)
+                  : readFrontCoded(columns.name_fc, columns.name_layout, index, buffer, buffer_size);
+    }
+    return readHeapString(code ? columns.code : columns.name, index, buffer, buffer_size);
+  }
+
+  /**
+   * @brief Read a NUL-terminated string from the v2 string heap into a fixed buffer
+   */
+  bool readHeapString(uint32_t column, uint32_t index, char* buffer, size_t buffer_size) {
+    uint32_t heap_offset = 0;
+    if (!file.seek(column + (index * 4)) ||
+        file.readBytes(reinterpret_cast<char*>(&heap_offset), 4) != 4 ||
+        heap_offset >= columns.strings_size) {
+      buffer[0] = '\0';
+      return false;
+    }
+
+    size_t const MAX_LEN = std::min<size_t>(buffer_size - 1, columns.strings_size - heap_offset);
+    file.seek(columns.strings + heap_offset);
+    size_t const BYTES_READ = file.readBytes(buffer, MAX_LEN);
+    buffer[BYTES_READ] = '\0';  // Strings are NUL-terminated; this also truncates long ones
+    return true;
+  }
+
+  /**
+   * @brief Assemble one color from the v2 columns
+   */
+  bool readColorV2(uint32_t index, SimpleColor& color) {
+    uint8_t rgb[3];
+    uint8_t flags = 0;
+
+    if (!file.seek(columns.rgb + (index * 3)) || file.read(rgb, 3) != 3 ||
+        !file.seek(columns.lrv + (index * 2)) ||
+        file.readBytes(reinterpret_cast<char*>(&color.lrv_scaled), 2) != 2 ||
+        !file.seek(columns.id + (index * 4)) ||
+        file.readBytes(reinterpret_cast<char*>(&color.id), 4) != 4 ||
+        !file.seek(columns.flags + index) || file.read(&flags, 1) != 1) {
+      Serial.printf("Failed to read v2 columns at position %u\n", index);
+      return false;
+    }
+
+    color.r = rgb[0];
+    color.g = rgb[1];
+    color.b = rgb[2];
+    color.light_text = (flags & DULUX_FLAG_LIGHT_TEXT) != 0;
+
+    if (!readStringV2(false, index, color.name, sizeof(color.name)) ||
+        !readStringV2(true, index, color.code, sizeof(color.code))) {
+      Serial.printf("Failed to read v2 strings at position %u\n", index);
+      return false;
+    }
+    return true;
+  }
+
+  bool readColorString(bool code, uint32_t index, char* buffer, size_t buffer_size) {
+    if (!file_open || index >= total_colors || buffer_size == 0) {
+      return false;
+    }
+    if (format_version == DULUX_BINARY_VERSION_V2) {
+      return readStringV2(code, index, buffer, buffer_size);
+    }
+
+    // v1: the name follows the fixed fields, the code follows the name
+    bool ok = file.seek(entry_offsets[index] + DULUX_FIXED_FIELDS_SIZE);
+    if (ok && code) {
+      uint8_t const NAME_LENGTH = file.read();
+      ok = NAME_LENGTH == 255 || file.seek(file.position() + NAME_LENGTH);
+    }
+    ok = ok && readStringToBuffer(buffer, buffer_size);
+
+    // Sequential v1 reads continue from the file position; put it back
+    if (current_position < total_colors) {
+      file.seek(entry_offsets[current_position]);
+    }
+    return ok;
+  }
+
+  /**
+   * @brief Columnar v2 scan: reads only the LAB and RGB columns in batches
+   * @return Index of the best match, or total_colors if nothing was checked
+   */
+  uint32_t scanClosestV2(uint8_t target_r, uint8_t target_g, uint8_t target_b,
+                         const CIEDE2000::LAB& target_lab, float& min_distance,
+                         uint32_t& colors_checked) {
+    DuluxLabFixed labs[DULUX_SCAN_BATCH];
+    uint8_t rgbs[DULUX_SCAN_BATCH * 3];
+    uint32_t best_index = total_colors;
+    unsigned long const START_TIME = millis();
+    const unsigned long MAX_SEARCH_TIME = 2000;  // Same budget as the v1 scan
+
+    for (uint32_t base = 0; base < total_colors; base += DULUX_SCAN_BATCH) {
+      if (millis() - START_TIME > MAX_SEARCH_TIME) {
+        Serial.printf("Search timeout after %ums, checked %u colors\n", MAX_SEARCH_TIME,
+                      colors_checked);
+        break;
+      }
+
+      uint32_t const COUNT = std::min<uint32_t>(DULUX_SCAN_BATCH, total_colors - base);
+      if (!file.seek(columns.lab + (base * sizeof(DuluxLabFixed))) ||
+          file.read(reinterpret_cast<uint8_t*>(labs), COUNT * sizeof(DuluxLabFixed)) !=
+              COUNT * sizeof(DuluxLabFixed) ||
+          !file.seek(columns.rgb + (base * 3)) || file.read(rgbs, COUNT * 3) != COUNT * 3) {
+        Serial.printf("Failed to read v2 scan batch at %u\n", base);
+        break;
+      }
+
+      for (uint32_t i = 0; i < COUNT; i++) {
+        const uint8_t* rgb = &rgbs[i * 3];
+        float const DISTANCE = duluxCandidateDistance(target_r, target_g, target_b, target_lab, rgb[0],
+                                                 rgb[1], rgb[2], duluxLabFromFixed(labs[i]));
+        colors_checked++;
+
+        if (DISTANCE < min_distance) {
+          min_distance = DISTANCE;
+          best_index = base + i;
+
+          // Early exit for very close matches
+          bool const IS_LIGHT =
+              duluxIsLightPair(target_r, target_g, target_b, rgb[0], rgb[1], rgb[2]);
+          if (duluxIsExcellentMatch(IS_LIGHT, DISTANCE)) {
+            Serial.printf("Excellent match found, stopping search\n");
+            return best_index;
+          }
+        }
+      }
+    }
+
+    return best_index;
+  }
+
  public:
   /**
    * @brief Constructor
@@ -137,7 +462,7 @@ class DuluxSimpleReader {
       return false;
     }
 
-    if (version != DULUX_BINARY_VERSION) {
+    if (!duluxIsSupportedVersion(version)) {
       Serial.printf("Invalid version: %u\n", version);
       file.close();
       return false;
@@ -145,9 +470,25 @@ class DuluxSimpleReader {
 
     total_colors = color_count;
     current_position = 0;
+    format_version = version;
+    palette_crc_valid = false;
+
+    unsigned long const INDEX_START = millis();
+    if (version == DULUX_BINARY_VERSION_V2) {
+      // Fixed-size columns: any index is addressable without an offset table
+      if (!loadSectionTable(reserved)) {
+        file.close();
+        return false;
+      }
+    } else if (!buildOffsetIndex()) {
+      file.close();
+      return false;
+    }
     file_open = true;
+    reset();
 
-    Serial.printf("Database opened: %u colors\n", total_colors);
+    Serial.printf("Database opened: %u colors, format v%u (index ready in %lums)\n", total_colors,
+                  format_version, millis() - INDEX_START);
     return true;
   }
 
@@ -158,6 +499,13 @@ class DuluxSimpleReader {
     return total_colors;
   }
 
+  /**
+   * @brief Get the on-disk format version of the open database
+   */
+  uint32_t getFormatVersion() const {
+    return format_version;
+  }
+
   /**
    * @brief Read the next color from the file
    */
@@ -166,6 +514,14 @@ class DuluxSimpleReader {
       return false;
     }
 
+    if (format_version == DULUX_BINARY_VERSION_V2) {
+      if (!readColorV2(current_position, color)) {
+        return false;
+      }
+      current_position++;
+      return true;
+    }
+
     // Read RGB
     int r = file.read();
     int g = file.read();
@@ -224,25 +580,74 @@ class DuluxSimpleReader {
       return false;
     }
 
-    // Calculate file position for this color
-    // Header: 16 bytes
-    // Each color entry size varies due to string lengths
-    // For now, do sequential read up to the index (not optimal but safe)
+    if (format_version == DULUX_BINARY_VERSION_V2) {
+      current_position = index;
+      return readNextColor(color);
+    }
 
-    if (!reset()) {
+    // Entries are variable length, so resolve the position through the offset index
+    if (!file.seek(entry_offsets[index])) {
       return false;
     }
+    current_position = index;
 
-    // Skip to the desired index
-    for (uint32_t i = 0; i < index; i++) {
-      SimpleColor temp{};
-      if (!readNextColor(temp)) {
-        return false;
+    return readNextColor(color);
+  }
+
+  /**
+   * @brief Read only the name of one color into a caller buffer
+   *
+   * Lets callers that rank by index (KD-tree, column scans) fetch strings for
+   * the winner alone; front-coded v2 names are decoded on demand.
+   */
+  bool readName(uint32_t index, char* buffer, size_t buffer_size) {
+    return readColorString(false, index, buffer, buffer_size);
+  }
+
+  /**
+   * @brief Read only the code of one color into a caller buffer
+   */
+  bool readCode(uint32_t index, char* buffer, size_t buffer_size) {
+    return readColorString(true, index, buffer, buffer_size);
+  }
+
+  /**
+   * @brief Palette identity used to key cached derived data
+   *
+   * v2 files answer from the META section; v1 files from the compiler
+   * trailer, otherwise by one buffered pass over the file (cached).
+   */
+  uint32_t getPaletteCrc() {
+    if (!file_open || palette_crc_valid) {
+      return palette_crc;
+    }
+
+    DuluxPaletteMeta meta{};
+    size_t const FILE_SIZE = file.size();
+    uint8_t tail[sizeof(DuluxV1Trailer)];
+    if (readSection(DULUX_SECTION_META, reinterpret_cast<uint8_t*>(&meta), sizeof(meta))) {
+      palette_crc = meta.palette_crc;
+    } else if (format_version == DULUX_BINARY_VERSION &&
+               FILE_SIZE >= DULUX_HEADER_SIZE + sizeof(tail) &&
+               file.seek(FILE_SIZE - sizeof(tail)) && file.read(tail, sizeof(tail)) == sizeof(tail) &&
+               duluxParseV1Trailer(tail, palette_crc)) {
+      // Trailer CRC already covers every byte before it
+    } else {
+      uint8_t buffer[DULUX_INDEX_SCAN_BUFFER];
+      palette_crc = 0;
+      file.seek(0);
+      size_t got = 0;
+      while ((got = file.read(buffer, sizeof(buffer))) > 0) {
+        palette_crc = duluxCrc32(palette_crc, buffer, got);
       }
     }
 
-    // Read the color at the index
-    return readNextColor(color);
+    // Sequential v1 reads continue from the file position; put it back
+    if (format_version == DULUX_BINARY_VERSION && current_position < total_colors) {
+      file.seek(entry_offsets[current_position]);
+    }
+    palette_crc_valid = true;
+    return palette_crc;
   }
 
   /**
@@ -252,6 +657,29 @@ class DuluxSimpleReader {
     return file_open;
   }
 
+  /**
+   * @brief Size of an optional v2 section (META, KDT3, ...)
+   * @return Size in bytes, 0 if the section is absent or the file is v1
+   */
+  uint32_t getSectionSize(uint32_t tag) const {
+    const DuluxSectionEntry* entry = duluxFindSection(sections, section_count, tag);
+    return entry ? entry->size : 0;
+  }
+
+  /**
+   * @brief Copy a whole v2 section into a caller-provided buffer
+   * @param buffer_size Must be at least getSectionSize(tag)
+   */
+  bool readSection(uint32_t tag, uint8_t* buffer, size_t buffer_size) {
+    const DuluxSectionEntry* entry = duluxFindSection(sections, section_count, tag);
+    if (!file_open || !entry || buffer_size < entry->size || !file.seek(entry->offset)) {
+      return false;
+    }
+    bool const OK = file.read(buffer, entry->size) == entry->size;
+    reset();  // Sequential readers expect the stream at the first record
+    return OK;
+  }
+
   /**
    * @brief Reset to beginning of color data
    */
@@ -261,7 +689,7 @@ class DuluxSimpleReader {
     }
 
     // Seek to start of color data (after 16-byte header)
-    file.seek(16);
+    file.seek(DULUX_HEADER_SIZE);
     current_position = 0;
     return true;
   }
@@ -294,10 +722,18 @@ class DuluxSimpleReader {
     rgbToLAB(target_r, target_g, target_b, targetLab);
 
     uint32_t colorsChecked = 0;
+
+    if (format_version == DULUX_BINARY_VERSION_V2) {
+      // Columnar scan over precomputed L*a*b*; strings are read for the winner only
+      uint32_t const BEST = scanClosestV2(target_r, target_g, target_b, targetLab, minDistance,
+                                          colorsChecked);
+      found = BEST < total_colors && getColorByIndex(BEST, result);
+    }
+
     unsigned long const START_TIME = millis();
     const unsigned long MAX_SEARCH_TIME = 2000;  // Max 2000ms search time for thorough search
 
-    while (readNextColor(currentColor)) {
+    while (format_version == DULUX_BINARY_VERSION && readNextColor(currentColor)) {
       // Timeout check for responsive live view
       if (millis() - START_TIME > MAX_SEARCH_TIME) {
         Serial.printf("Search timeout after %ums, checked %u colors\n", MAX_SEARCH_TIME,
@@ -305,25 +741,17 @@ class DuluxSimpleReader {
         break;
       }
       // Calculate distance - use simple RGB for whites/near-whites, CIEDE2000 for others
-      float distance = NAN;
-
-      // Check if both colors are light (potential whites)
       bool const IS_LIGHT_TARGET = (target_r > 200 && target_g > 200 && target_b > 200);
       bool const IS_LIGHT_CURRENT =
           (currentColor.r > 200 && currentColor.g > 200 && currentColor.b > 200);
 
-      if (IS_LIGHT_TARGET && IS_LIGHT_CURRENT) {
-        // Use simple RGB distance for whites/light colors (more accurate for close matches)
-        auto const DR = (float)(target_r - currentColor.r);
-        auto const DG = (float)(target_g - currentColor.g);
-        auto const DB = (float)(target_b - currentColor.b);
-        distance = sqrt((DR * DR) + (DG * DG) + (DB * DB));
-      } else {
-        // Use CIEDE2000 for other colors
-        CIEDE2000::LAB currentLab;
+      CIEDE2000::LAB currentLab{};
+      if (!(IS_LIGHT_TARGET && IS_LIGHT_CURRENT)) {
         rgbToLAB(currentColor.r, currentColor.g, currentColor.b, currentLab);
-        distance = (float)CIEDE2000::ciedE2000(targetLab, currentLab);
       }
+      float const distance = duluxCandidateDistance(target_r, target_g, target_b, targetLab,
+                                               currentColor.r, currentColor.g, currentColor.b,
+                                               currentLab);
 
       if (distance < minDistance) {
         minDistance = distance;
@@ -376,6 +804,11 @@ class DuluxSimpleReader {
       file.close();
       file_open = false;
     }
+    entry_offsets.clear();
+    entry_offsets.shrink_to_fit();
+    section_count = 0;
+    palette_crc_valid = false;
+    format_version = 0;
   }
 };
 
@@ -0,0 +1,89 @@
+/**
+ * @file dulux_spatial_order.h
+ * @brief Space-filling curve keys for ordering colors in L*a*b* space
+ *
+ * Colors that are close in Lab get close keys, so sorting by key keeps
+ * neighbours adjacent in memory (palette files, query batches). Portable:
+ * used by the firmware and the host palette compiler.
+ */
+
+#ifndef DULUX_SPATIAL_ORDER_H
+#define DULUX_SPATIAL_ORDER_H
+
+#include <stdint.h>
+
+#include "dulux_palette_format.h"
+
+#define DULUX_CURVE_BITS 10  // Bits per axis; keys use 3 * DULUX_CURVE_BITS bits
+
+/**
+ * @brief Quantize a fixed-point Lab value onto the curve grid
+ *
+ * L* covers 0..100 and a*, b* cover -128..128; each axis maps to
+ * 0..(2^DULUX_CURVE_BITS - 1).
+ */
+inline void duluxLabToCurveAxes(const DuluxLabFixed& lab, uint32_t axes[3]) {
+  const int32_t MAX_AXIS = (1 << DULUX_CURVE_BITS) - 1;
+  auto scale = [MAX_AXIS](int32_t value, int32_t low, int32_t high) {
+    value = value < low ? low : (value > high ? high : value);
+    return (uint32_t)(((value - low) * MAX_AXIS) / (high - low));
+  };
+  axes[0] = scale(lab.l, 0, 100 * DULUX_LAB_FIXED_SCALE);
+  axes[1] = scale(lab.a, -128 * DULUX_LAB_FIXED_SCALE, 128 * DULUX_LAB_FIXED_SCALE);
+  axes[2] = scale(lab.b, -128 * DULUX_LAB_FIXED_SCALE, 128 * DULUX_LAB_FIXED_SCALE);
+}
+
+/**
+ * @brief Z-order (Morton) key: plain bit interleave of the three axes
+ */
+inline uint32_t duluxMortonKey(const uint32_t axes[3]) {
+  uint32_t key = 0;
+  for (int bit = DULUX_CURVE_BITS - 1; bit >= 0; bit--) {
+    for (int axis = 0; axis < 3; axis++) {
+      key = (key << 1) | ((axes[axis] >> bit) & 1U);
+    }
+  }
+  return key;
+}
+
+/**
+ * @brief Hilbert key (Skilling's transpose algorithm)
+ *
+ * Unlike Morton order the Hilbert curve never jumps: consecutive keys are
+ * always neighbouring grid cells, which gives better scan locality.
+ */
+inline uint32_t duluxHilbertKey(const uint32_t axes[3]) {
+  uint32_t x[3] = {axes[0], axes[1], axes[2]};
+  uint32_t const HIGH_BIT = 1U << (DULUX_CURVE_BITS - 1);
+
+  // Inverse undo
+  for (uint32_t q = HIGH_BIT; q > 1; q >>= 1) {
+    uint32_t const P = q - 1;
+    for (int i = 0; i < 3; i++) {
+      if (x[i] & q) {
+        x[0] ^= P;
+      } else {
+        uint32_t const T = (x[0] ^ x[i]) & P;
+        x[0] ^= T;
+        x[i] ^= T;
+      }
+    }
+  }
+
+  // Gray encode
+  x[1] ^= x[0];
+  x[2] ^= x[1];
+  uint32_t t = 0;
+  for (uint32_t q = HIGH_BIT; q > 1; q >>= 1) {
+    if (x[2] & q) {
+      t ^= q - 1;
+    }
+  }
+  for (uint32_t& value : x) {
+    value ^= t;
+  }
+
+  return duluxMortonKey(x);  // Interleave the transposed form
+}
+
+#endif  // DULUX_SPATIAL_ORDER_H
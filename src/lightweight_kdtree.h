@@ -1,9 +1,24 @@
 /*!
  * @file lightweight_kdtree.h
  * @brief Lightweight, iterative K-D tree for embedded systems
- * Optimized for ESP32 with large color datasets (4500+ colors)
+ * Optimized for ESP32 with large color datasets (multi-brand catalogs of 100k+ colors)
  * Uses iterative construction to avoid stack overflow
  * Memory-optimized with contiguous allocation
+ *
+ * Points are indexed in fixed-point CIE L*a*b*, so Euclidean distance in the
+ * tree approximates perceptual difference. A query collects the
+ * KDTREE_RERANK_CANDIDATES nearest points and re-ranks them with the shared
+ * palette metric (dulux_match_metric.h), which is what the exhaustive scans
+ * use. The candidates are gathered by dE76, though, and the CIEDE2000 (or,
+ * between light colors, RGB) winner can lie outside them: on the Dulux
+ * palette about one random query in five gets a different paint than the
+ * exhaustive scan. Exact answers come from DuluxExactScan, which can take
+ * the tree's answer as its starting candidate.
+ *
+ * The tree is implicit (see DuluxKDTreeHeader): one PSRAM array of points,
+ * where each range larger than a leaf bucket is split by its middle point and
+ * children are found by index arithmetic. There are no child links, and a
+ * query walks it with a small fixed stack on the C stack - no heap use.
  */
 
 #ifndef LIGHTWEIGHT_KDTREE_H
@@ -11,12 +26,19 @@
 
 #include <Arduino.h>
 
+#include <LittleFS.h>
 #include <esp_heap_caps.h>
 
 #include <algorithm>
-#include <queue>
+#include <limits>
+#include <type_traits>
 #include <vector>
 
+#include "CIEDE2000.h"
+#include "dulux_match_metric.h"
+#include "dulux_palette_format.h"
+#include "dulux_spatial_order.h"
+
 // Custom PSRAM allocator for STL containers
 template <typename T>
 class PSRAMAllocator {
@@ -63,259 +85,764 @@ class PSRAMAllocator {
   }
 };
 
-// Type aliases for PSRAM-allocated vectors
-using PSRAMColorVector = std::vector<struct ColorPoint, PSRAMAllocator<struct ColorPoint>>;
-using PSRAMNodeVector = std::vector<struct KDNode, PSRAMAllocator<struct KDNode>>;
+#define KDTREE_ALL_BRANDS 0xFFFFFFFFU  // Brand mask accepting every point
+#define KDTREE_MAX_BRANDS 32           // Brand ids that fit in a mask
+#define KDTREE_RERANK_CANDIDATES 8     // Nearest L*a*b* points re-ranked with CIEDE2000
+#define KDTREE_STACK_DEPTH 32          // Pending ranges per query; 2^32 points need at most 32
+#define KDTREE_MAX_MATCHES 10          // Largest k accepted by findKNearest()
+#define KDTREE_MAX_BATCH 1024          // Largest query count accepted by findNearestBatch()
+#define KDTREE_NO_BUDGET 0             // KDTreeSearchOptions::max_visits: no limit
+#define KDTREE_NEIGHBOURHOOD 16        // Points per set kept by findNearestIncremental()
+#define KDTREE_NO_GUARD UINT32_MAX     // Neighbourhood already holds every eligible point
+#define KDTREE_PSRAM_RESERVE (2 * 1024 * 1024)  // PSRAM left to the rest of the firmware
+#define KDTREE_MIN_POINTS 500          // Smallest size limit the memory estimate may set
+#define KDTREE_BUILD_YIELD_POINTS 16384  // Points partitioned between yields while building
+// Candidates gathered for a k-nearest query: k plus the re-rank margin
+#define KDTREE_CANDIDATE_CAPACITY (KDTREE_MAX_MATCHES + KDTREE_RERANK_CANDIDATES - 1)
+static_assert(KDTREE_NEIGHBOURHOOD >= KDTREE_RERANK_CANDIDATES &&
+                  KDTREE_NEIGHBOURHOOD < KDTREE_CANDIDATE_CAPACITY,
+              "a neighbourhood walk gathers KDTREE_NEIGHBOURHOOD + 1 candidates");
+
+// Compact color point structure; Index is the width of palette indices and
+// tree positions (uint16_t: 12 bytes per point, uint32_t: 16 bytes)
+template <typename Index>
+struct BasicColorPoint {
+  uint8_t r, g, b;    // RGB values (3 bytes)
+  uint8_t brand;      // Palette the point belongs to (fills the padding byte)
+  Index index;        // Index in original database
+  DuluxLabFixed lab;  // Indexed coordinates, L*a*b* * 100 (6 bytes)
+
+  BasicColorPoint() : r(0), g(0), b(0), brand(0), index(0), lab{0, 0, 0} {
+  }
+  // L*a*b* derived from RGB exactly as the palette loaders and compiler do
+  BasicColorPoint(uint8_t r, uint8_t g, uint8_t b, Index idx, uint8_t brand = 0)
+      : r(r), g(g), b(b), brand(brand), index(idx), lab(labOf(r, g, b)) {
+  }
+  // For callers that already hold the palette's LAB column
+  BasicColorPoint(uint8_t r, uint8_t g, uint8_t b, const DuluxLabFixed& lab, Index idx,
+                  uint8_t brand = 0)
+      : r(r), g(g), b(b), brand(brand), index(idx), lab(lab) {
+  }
 
-// Compact color point structure
-struct ColorPoint {
-  uint8_t r, g, b;  // RGB values (3 bytes)
-  uint16_t index;   // Index in original database (2 bytes)
+  static DuluxLabFixed labOf(uint8_t r, uint8_t g, uint8_t b) {
+    CIEDE2000::LAB value;
+    rgbToLAB(r, g, b, value);
+    return duluxLabToFixed(value);
+  }
 
-  ColorPoint() : r(0), g(0), b(0), index(0) {
+  uint8_t getRed() const {
+    return r;
+  }
+  uint8_t getGreen() const {
+    return g;
+  }
+  uint8_t getBlue() const {
+    return b;
+  }
+  uint8_t getBrand() const {
+    return brand;
   }
-  ColorPoint(uint8_t r, uint8_t g, uint8_t b, uint16_t idx) : r(r), g(g), b(b), index(idx) {
+  Index getIndex() const {
+    return index;
   }
 };
 
-// Compact tree node structure
-struct KDNode {
-  ColorPoint point;  // Color data (5 bytes)
-  uint8_t axis{0};   // Splitting axis 0=R, 1=G, 2=B (1 byte)
-  uint16_t left{0};  // Index of left child (2 bytes, 0 = no child)
-  uint16_t right{0};  // Index of right child (2 bytes, 0 = no child)
+using ColorPoint = BasicColorPoint<uint16_t>;
+using WideColorPoint = BasicColorPoint<uint32_t>;
+static_assert(sizeof(ColorPoint) == 12, "16-bit points stay 12 bytes");
+static_assert(sizeof(WideColorPoint) == 16, "32-bit points take 16 bytes");
 
-  KDNode() = default;
+template <typename Index>
+using BasicColorVector =
+    std::vector<BasicColorPoint<Index>, PSRAMAllocator<BasicColorPoint<Index>>>;
+using PSRAMColorVector = BasicColorVector<uint16_t>;
+using WideColorVector = BasicColorVector<uint32_t>;
+
+/**
+ * @brief One result of LightweightKDTree::findKNearest()
+ */
+template <typename Index>
+struct BasicKDTreeMatch {
+  BasicColorPoint<Index> point;
+  float distance;  // Shared palette metric (CIEDE2000, RGB distance between light colors)
 };
 
-class LightweightKDTree {
- private:
-  PSRAMNodeVector nodes;
-  PSRAMColorVector points;
-  size_t node_count{0};
-  bool built{false};
-  size_t max_tree_size{0};  // Adaptive size limit based on available memory
+using KDTreeMatch = BasicKDTreeMatch<uint16_t>;
+using WideKDTreeMatch = BasicKDTreeMatch<uint32_t>;
 
-  // Build queue item for iterative construction
-  struct BuildItem {
-    uint16_t node_index;
-    size_t start;
-    size_t end;
-    uint8_t depth;
+/**
+ * @brief Cost of the last LightweightKDTree::build() (zero for a loaded tree)
+ */
+struct KDTreeBuildStats {
+  uint32_t points;             // Points arranged
+  uint32_t splits;             // Ranges split around their median
+  unsigned long arrange_us;    // Time spent arranging the implicit layout
+  uint32_t points_per_second;  // points / arrange time
+};
 
-    BuildItem(uint16_t ni, size_t s, size_t e, uint8_t d)
-        : node_index(ni), start(s), end(e), depth(d) {
-    }
+/**
+ * @brief One query of LightweightKDTree::findNearestBatch()
+ */
+struct KDTreeQuery {
+  CIEDE2000::LAB lab;  // Color to match
+  uint8_t r, g, b;     // The same color in sRGB; selects the metric's light-pair rule
+};
+
+/**
+ * @brief Palette attributes of one point, for filtered queries (see attachAttributes())
+ */
+struct KDTreeAttributes {
+  uint16_t lrv_scaled;  // LRV * 100
+  uint8_t flags;        // DULUX_FLAG_* bits
+};
+
+/**
+ * @brief Attribute constraints of a query; the default accepts every point
+ */
+struct KDTreeFilter {
+  uint16_t lrv_min{0};           // Lowest accepted LRV * 100
+  uint16_t lrv_max{UINT16_MAX};  // Highest accepted LRV * 100
+  uint8_t flags_mask{0};         // DULUX_FLAG_* bits that must equal those in flags_value
+  uint8_t flags_value{0};
+
+  bool isActive() const {
+    return lrv_min > 0 || lrv_max < UINT16_MAX || flags_mask != 0;
+  }
+  bool accepts(const KDTreeAttributes& attributes) const {
+    return attributes.lrv_scaled >= lrv_min && attributes.lrv_scaled <= lrv_max &&
+           ((attributes.flags ^ flags_value) & flags_mask) == 0;
+  }
+};
+
+/**
+ * @brief Per-query search options; the default is the exact, unfiltered search
+ *
+ * With epsilon > 0 a subtree is skipped when it cannot bring a candidate
+ * closer than the current pruning radius divided by (1 + epsilon). With a
+ * visit budget the walk stops after that many points. Either way, the
+ * candidates are gathered in L*a*b* and re-ranked with the shared metric as usual.
+ * A filter only lets matching points become candidates, and skips subtrees
+ * whose summary shows they hold none.
+ */
+struct KDTreeSearchOptions {
+  float epsilon{0.0f};                   // Allowed relative excess of the candidate radius
+  uint32_t max_visits{KDTREE_NO_BUDGET};  // Points to examine at most
+  KDTreeFilter filter{};                 // Attribute constraints (needs attachAttributes())
+};
+
+/**
+ * @brief What a query actually achieved under its KDTreeSearchOptions
+ */
+struct KDTreeSearchReport {
+  uint32_t visited;  // Points examined
+  // Proven bound: the candidate radius is within (1 + achieved_epsilon) of the exact
+  // one; 0 when nothing was skipped early, INFINITY if the budget ended before any bound
+  float achieved_epsilon;
+  bool budget_exhausted;
+};
+
+/**
+ * @brief One query's candidates, kept for LightweightKDTree::findNearestIncremental()
+ */
+template <typename Index>
+struct BasicKDTreeNeighbourhood {
+  DuluxLabFixed center;  // Where the points were gathered
+  Index positions[2 * KDTREE_NEIGHBOURHOOD];  // Tree positions, dark set then light set
+  uint8_t counts[2];     // Points kept in each set
+  uint32_t guard[2];     // Squared distance of the nearest point each set left out
+  uint32_t brand_mask;
+  bool light;            // Light target: light points were gathered separately
+  bool valid;
+  uint32_t visited;      // Points examined by the last query; 0 if it reused the neighbourhood
+};
+
+using KDTreeNeighbourhood = BasicKDTreeNeighbourhood<uint16_t>;
+
+// PSRAM a KD-tree may fill
+inline size_t kdTreeMemoryBudget() {
+  size_t const FREE_PSRAM = ESP.getFreePsram();
+  return FREE_PSRAM > KDTREE_PSRAM_RESERVE ? FREE_PSRAM - KDTREE_PSRAM_RESERVE : 0;
+}
+
+/**
+ * @brief Implicit KD-tree over BasicColorPoint<Index>
+ *
+ * Index bounds both the palette indices the points carry and the number of
+ * points (tree positions are Index too): LightweightKDTree holds up to 65,535
+ * points at 12 bytes each, WideKDTree up to 2^32 - 1 at 16 bytes each.
+ * planKDTree() chooses between them for a palette size.
+ *
+ * attachAttributes() adds per-point palette attributes and a summary of
+ * every range (LRV span, brands, flags present), numbered like a binary
+ * heap: the root range is node 1 and node n splits into nodes 2n and
+ * 2n + 1. Filtered queries and brand-restricted ones skip every subtree
+ * whose summary rules out all of its points.
+ */
+template <typename Index>
+class BasicKDTree {
+  static_assert(std::is_same<Index, uint16_t>::value || std::is_same<Index, uint32_t>::value,
+                "KD-tree indices are 16 or 32 bits wide");
+
+ public:
+  using Point = BasicColorPoint<Index>;
+  using PointVector = BasicColorVector<Index>;
+  using Match = BasicKDTreeMatch<Index>;
+  using Neighbourhood = BasicKDTreeNeighbourhood<Index>;
+
+  static constexpr size_t MAX_POINTS = std::numeric_limits<Index>::max();
+
+ private:
+  // What every point of one range carries; an empty range admits nothing
+  struct RangeSummary {
+    uint16_t lrv_min;
+    uint16_t lrv_max;
+    uint32_t brands;    // Bit n set if a point of brand n is in the range
+    uint8_t flags_any;  // OR of the points' flags
+    uint8_t flags_all;  // AND of the points' flags
   };
 
+  PointVector points;  // Implicit tree order, see DuluxKDTreeHeader
+  std::vector<KDTreeAttributes, PSRAMAllocator<KDTreeAttributes>> attributes;  // Per point
+  std::vector<RangeSummary, PSRAMAllocator<RangeSummary>> summaries;  // By heap node id
+  uint16_t leaf_size{DULUX_KD_LEAF_SIZE};
+  bool built{false};
+  KDTreeBuildStats build_stats{0, 0, 0, 0};
+  size_t max_tree_size{0};       // Adaptive size limit based on available memory
+  size_t point_cap{MAX_POINTS};  // Upper bound on indexed points regardless of memory
+
   // Get coordinate value for given axis
-  static uint8_t getCoordinate(const ColorPoint& p, uint8_t axis) {
+  static int16_t getCoordinate(const Point& p, uint8_t axis) {
     switch (axis) {
       case 0:
-        return p.r;
+        return p.lab.l;
       case 1:
-        return p.g;
+        return p.lab.a;
       case 2:
-        return p.b;
+        return p.lab.b;
       default:
-        return p.r;
+        return p.lab.l;
     }
   }
 
-  // Calculate squared Euclidean distance
-  static uint32_t distanceSquared(const ColorPoint& a, const ColorPoint& b) {
-    int32_t const DR = (int32_t)a.r - (int32_t)b.r;
-    int32_t const DG = (int32_t)a.g - (int32_t)b.g;
-    int32_t const DB = (int32_t)a.b - (int32_t)b.b;
-    return (uint32_t)((DR * DR) + (DG * DG) + (DB * DB));
+  // Squared Euclidean distance in fixed-point L*a*b* (CIE76 * 100, squared)
+  static uint32_t distanceSquared(const Point& a, const Point& b) {
+    int32_t const DL = (int32_t)a.lab.l - (int32_t)b.lab.l;
+    int32_t const DA = (int32_t)a.lab.a - (int32_t)b.lab.a;
+    int32_t const DB = (int32_t)a.lab.b - (int32_t)b.lab.b;
+    return (uint32_t)((DL * DL) + (DA * DA) + (DB * DB));
   }
 
-  // Iterative nearest neighbor search
-  void searchNearest(uint16_t node_index, const ColorPoint& target, ColorPoint& best,
-                     uint32_t& best_dist) const {
-    if (node_index == 0) {
-      return;
+  // The `limit` nearest points seen so far, kept as a max-heap on distance so
+  // the pruning radius (the worst kept candidate) is always at the root
+  struct CandidateSet {
+    struct Entry {
+      uint32_t dist;
+      Index position;  // Index in points
+      Point point;
+      bool operator<(const Entry& other) const {
+        return dist < other.dist;
+      }
+    };
+
+    Entry heap[KDTREE_CANDIDATE_CAPACITY];
+    uint8_t count{0};
+    uint8_t limit{KDTREE_RERANK_CANDIDATES};
+
+    // Pruning radius: distance of the worst kept candidate once the set is full
+    uint32_t bound() const {
+      return count < limit ? UINT32_MAX : heap[0].dist;
     }
 
-    // Use a stack for iterative traversal to avoid recursion
-    std::vector<uint16_t> stack;
-    stack.reserve(64);  // Reasonable depth limit
-    stack.push_back(node_index);
+    void offer(const Point& p, Index position, uint32_t d) {
+      if (count < limit) {
+        heap[count++] = {d, position, p};
+        std::push_heap(heap, heap + count);
+      } else if (d < heap[0].dist) {
+        std::pop_heap(heap, heap + count);
+        heap[count - 1] = {d, position, p};
+        std::push_heap(heap, heap + count);
+      }
+    }
+  };
 
-    while (!stack.empty() && stack.size() < 64) {  // Safety limit
-      uint16_t current = stack.back();
-      stack.pop_back();
+  static bool brandAccepted(const Point& p, uint32_t brand_mask) {
+    return p.brand < KDTREE_MAX_BRANDS && (brand_mask & (1U << p.brand)) != 0;
+  }
 
-      const KDNode& node = nodes[current - 1];  // Convert to 0-based index
+  static void include(RangeSummary& summary, const Point& p, const KDTreeAttributes& a) {
+    summary.lrv_min = std::min(summary.lrv_min, a.lrv_scaled);
+    summary.lrv_max = std::max(summary.lrv_max, a.lrv_scaled);
+    summary.brands |= p.brand < KDTREE_MAX_BRANDS ? (1U << p.brand) : 0;
+    summary.flags_any |= a.flags;
+    summary.flags_all &= a.flags;
+  }
 
-      // Check current node
-      uint32_t const DIST = distanceSquared(node.point, target);
-      if (DIST < best_dist) {
-        best_dist = DIST;
-        best = node.point;
-      }
+  static void merge(RangeSummary& summary, const RangeSummary& child) {
+    summary.lrv_min = std::min(summary.lrv_min, child.lrv_min);
+    summary.lrv_max = std::max(summary.lrv_max, child.lrv_max);
+    summary.brands |= child.brands;
+    summary.flags_any |= child.flags_any;
+    summary.flags_all &= child.flags_all;
+  }
 
-      // Determine which side to search first
-      uint8_t const TARGET_COORD = getCoordinate(target, node.axis);
-      uint8_t const NODE_COORD = getCoordinate(node.point, node.axis);
+  // False when no point of the range can pass both the brand mask and the filter
+  static bool admits(const RangeSummary& summary, uint32_t brand_mask, const KDTreeFilter& filter) {
+    uint8_t const MUST_SET = filter.flags_mask & filter.flags_value;
+    uint8_t const MUST_CLEAR = filter.flags_mask & ~filter.flags_value;
+    return (summary.brands & brand_mask) != 0 && summary.lrv_max >= filter.lrv_min &&
+           summary.lrv_min <= filter.lrv_max && (MUST_SET & ~summary.flags_any) == 0 &&
+           (MUST_CLEAR & summary.flags_all) == 0;
+  }
 
-      uint16_t firstChild = 0;
-      uint16_t secondChild = 0;
-      if (TARGET_COORD <= NODE_COORD) {
-        firstChild = node.left;
-        secondChild = node.right;
-      } else {
-        firstChild = node.right;
-        secondChild = node.left;
-      }
+  // Heap node ids needed by this tree: the lower child is never the smaller one,
+  // so following it gives the deepest path
+  size_t summaryCount() const {
+    size_t size = points.size();
+    size_t levels = 1;
+    while (size > leaf_size) {
+      size /= 2;
+      levels++;
+    }
+    return (size_t)1 << levels;
+  }
 
-      // Add children to stack (second child first so first child is processed first)
-      if (secondChild != 0) {
-        // Check if we need to search the other side
-        int32_t const AXIS_DIST = (int32_t)TARGET_COORD - (int32_t)NODE_COORD;
-        if ((uint32_t)(AXIS_DIST * AXIS_DIST) < best_dist) {
-          stack.push_back(secondChild);
+  // Fill summaries bottom-up: a node is finished after both of its children
+  void summarizeRanges() {
+    struct PendingNode {
+      size_t lo;
+      size_t hi;
+      uint32_t node;
+      bool children_done;
+    };
+    RangeSummary const EMPTY = {UINT16_MAX, 0, 0, 0, 0xFF};
+    std::vector<PendingNode> pending;
+    pending.push_back({0, points.size(), 1, false});
+
+    while (!pending.empty()) {
+      PendingNode const NODE = pending.back();
+      pending.pop_back();
+      RangeSummary& summary = summaries[NODE.node];
+      if (NODE.hi - NODE.lo <= leaf_size) {
+        summary = EMPTY;
+        for (size_t i = NODE.lo; i < NODE.hi; i++) {
+          include(summary, points[i], attributes[i]);
         }
+        continue;
       }
-
-      if (firstChild != 0) {
-        stack.push_back(firstChild);
+      size_t const MID = NODE.lo + ((NODE.hi - NODE.lo) / 2);
+      if (!NODE.children_done) {
+        pending.push_back({NODE.lo, NODE.hi, NODE.node, true});
+        pending.push_back({NODE.lo, MID, 2 * NODE.node, false});
+        pending.push_back({MID + 1, NODE.hi, (2 * NODE.node) + 1, false});
+        continue;
       }
+      summary = EMPTY;
+      include(summary, points[MID], attributes[MID]);
+      merge(summary, summaries[2 * NODE.node]);
+      merge(summary, summaries[(2 * NODE.node) + 1]);
     }
   }
 
-  // Build a balanced tree using iterative approach
-  bool buildBalancedTree() {
-    if (points.empty()) {
-      return false;
-    }
+  static bool isLight(const Point& p) {
+    return p.r > DULUX_LIGHT_CHANNEL_THRESHOLD && p.g > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+           p.b > DULUX_LIGHT_CHANNEL_THRESHOLD;
+  }
 
-    // Use iterative breadth-first construction
-    struct BuildTask {
-      size_t node_idx;
-      size_t start;
-      size_t end;
+  // Iterative nearest-candidates search; only points whose brand is in
+  // brand_mask become candidates, so pruning stays exact per brand.
+  // For light targets the shared metric scores light candidates by RGB
+  // distance, so they are collected in their own set (light_candidates)
+  // and cannot crowd out the CIEDE2000-scored ones.
+  // Approximate options skip ranges early; the closest of those bounds what
+  // was given up, which is reported as the achieved epsilon.
+  void searchNearest(const Point& target, uint32_t brand_mask, CandidateSet& candidates,
+                     CandidateSet* light_candidates,
+                     const KDTreeSearchOptions& options = KDTreeSearchOptions(),
+                     KDTreeSearchReport* report = nullptr) const {
+    // A subtree still to visit, with a lower bound on its squared distance
+    struct PendingRange {
+      Index lo;
+      Index hi;
       uint8_t depth;
+      uint32_t node;  // Heap id of the range, for its summary
+      uint32_t min_dist;
     };
 
-    std::queue<BuildTask> buildQueue;
-
-    // Start with root
-    buildQueue.push({0, 0, points.size(), 0});
-    node_count = 0;
+    auto bound = [&]() {
+      return light_candidates ? std::max(candidates.bound(), light_candidates->bound())
+                              : candidates.bound();
+    };
+    // A range is worth entering while it may hold a point closer than bound / (1 + epsilon)
+    float const EPSILON = std::max(0.0f, options.epsilon);
+    float const SHRINK = (1.0f + EPSILON) * (1.0f + EPSILON);  // Distances are squared
+    uint32_t skipped_min = UINT32_MAX;  // Nearest range given up without exact pruning
+    auto worthVisiting = [&](uint32_t min_dist) {
+      uint32_t const BOUND = bound();
+      if (min_dist >= BOUND) {
+        return false;  // Exact pruning: nothing in there can improve the candidates
+      }
+      if ((float)min_dist * SHRINK >= (float)BOUND) {
+        skipped_min = std::min(skipped_min, min_dist);
+        return false;
+      }
+      return true;
+    };
+    uint32_t examined = 0;
+    auto budgetLeft = [&]() {
+      return options.max_visits == KDTREE_NO_BUDGET || examined < options.max_visits;
+    };
+    // Summaries rule out subtrees only for a restricted query on a tree that has them
+    const KDTreeFilter& filter = options.filter;
+    bool const FILTERED = filter.isActive() && !attributes.empty();
+    bool const PRUNE = !summaries.empty() && (FILTERED || brand_mask != KDTREE_ALL_BRANDS);
+    auto eligible = [&](uint32_t node) {
+      return !PRUNE || admits(summaries[node], brand_mask, filter);
+    };
+    auto visit = [&](Index position) {
+      const Point& p = points[position];
+      examined++;
+      if (brandAccepted(p, brand_mask) && (!FILTERED || filter.accepts(attributes[position]))) {
+        CandidateSet& set = light_candidates && isLight(p) ? *light_candidates : candidates;
+        set.offer(p, position, distanceSquared(p, target));
+      }
+    };
 
-    while (!buildQueue.empty() && node_count < points.size()) {
-      BuildTask task = buildQueue.front();
-      buildQueue.pop();
+    // Each descent defers at most one far side per level, so the stack never
+    // holds more ranges than the tree is deep
+    PendingRange stack[KDTREE_STACK_DEPTH];
+    uint8_t top = 0;
+    stack[top++] = {0, (Index)points.size(), 0, 1, 0};
 
-      if (task.start >= task.end) {
+    bool stopped = false;
+    while (top > 0 && !stopped) {
+      PendingRange range = stack[--top];
+      if (!eligible(range.node) || !worthVisiting(range.min_dist)) {
         continue;
       }
 
-      // Choose splitting axis (cycle through R, G, B)
-      uint8_t const AXIS = task.depth % 3;
-
-      // Sort by current axis
-      std::sort(points.begin() + task.start, points.begin() + task.end,
-                [AXIS](const ColorPoint& a, const ColorPoint& b) {
-                  switch (AXIS) {
-                    case 0:
-                      return a.r < b.r;
-                    case 1:
-                      return a.g < b.g;
-                    case 2:
-                      return a.b < b.b;
-                    default:
-                      return a.r < b.r;
-                  }
-                });
-
-      // Find median
-      size_t median = task.start + ((task.end - task.start) / 2);
-
-      // Create node
-      if (task.node_idx < nodes.size()) {
-        KDNode& node = nodes[task.node_idx];
-        node.point = points[median];
-        node.axis = AXIS;
-        node.left = 0;
-        node.right = 0;
-
-        node_count++;
-
-        // Add children to queue if there's room and points
-        if (median > task.start && node_count < nodes.size()) {
-          size_t leftIdx = node_count;
-          node.left = leftIdx + 1;  // 1-based indexing
-          buildQueue.push({leftIdx, task.start, median, (uint8_t)(task.depth + 1)});
+      // Walk down toward the target, deferring the far side of every split
+      while (range.hi - range.lo > leaf_size) {
+        if (!budgetLeft()) {
+          break;
         }
+        Index const MID = range.lo + ((range.hi - range.lo) / 2);
+        uint8_t const AXIS = range.depth % 3;
+        const Point& split = points[MID];
+        visit(MID);
+
+        int32_t const AXIS_DIST =
+            (int32_t)getCoordinate(target, AXIS) - (int32_t)getCoordinate(split, AXIS);
+        uint32_t const FAR_DIST = std::max(range.min_dist, (uint32_t)(AXIS_DIST * AXIS_DIST));
+        uint8_t const DEPTH = range.depth + 1;
+        uint32_t const NODE = range.node;
+        PendingRange const LOWER = {range.lo, MID, DEPTH, 2 * NODE, range.min_dist};
+        PendingRange const UPPER = {(Index)(MID + 1), range.hi, DEPTH, (2 * NODE) + 1,
+                                    range.min_dist};
+        PendingRange far = AXIS_DIST <= 0 ? UPPER : LOWER;
+        range = AXIS_DIST <= 0 ? LOWER : UPPER;
+
+        far.min_dist = FAR_DIST;
+        if (far.hi > far.lo && eligible(far.node) && worthVisiting(FAR_DIST) &&
+            top < KDTREE_STACK_DEPTH) {
+          stack[top++] = far;
+        }
+        if (!eligible(range.node)) {
+          range.hi = range.lo;  // Nothing below can match: end the descent
+        }
+      }
 
-        if (median + 1 < task.end && node_count < nodes.size()) {
-          size_t rightIdx = node_count;
-          node.right = rightIdx + 1;  // 1-based indexing
-          buildQueue.push({rightIdx, median + 1, task.end, (uint8_t)(task.depth + 1)});
+      // Leaf bucket: contiguous points, scanned linearly
+      for (Index i = range.lo; i < range.hi; i++) {
+        if (!budgetLeft()) {
+          // The unvisited rest of this range and everything still stacked is given up
+          stopped = true;
+          skipped_min = std::min(skipped_min, range.min_dist);
+          break;
         }
+        visit(i);
+      }
+    }
+    for (uint8_t i = 0; stopped && i < top; i++) {
+      if (stack[i].min_dist < bound()) {
+        skipped_min = std::min(skipped_min, stack[i].min_dist);
       }
+    }
 
-      // Progress reporting every 500 nodes
-      if (node_count % 500 == 0) {
-        Serial.printf("[KDTree] Built %u/%u nodes (PSRAM: %u KB free)\n", node_count, points.size(),
-                      ESP.getFreePsram() / 1024);
-        yield();  // Allow other tasks to run
+    if (report) {
+      uint32_t const BOUND = bound();
+      report->visited = examined;
+      report->budget_exhausted = stopped;
+      report->achieved_epsilon = 0.0f;
+      if (skipped_min < BOUND) {
+        // Every point given up is at least sqrt(skipped_min) away
+        report->achieved_epsilon = BOUND == UINT32_MAX || skipped_min == 0
+                                       ? INFINITY
+                                       : sqrtf((float)BOUND / (float)skipped_min) - 1.0f;
+      }
+    }
+  }
+
+  // Take a query's candidates from the previous query's neighbourhood: the
+  // nearest of the kept points to the new target. Every point a set left out
+  // was at least guard from the old center, so at least guard - moved from the
+  // target; while the farthest candidate taken is closer than that, no point
+  // outside the neighbourhood can displace it.
+  bool gatherFromNeighbourhood(const Neighbourhood& hood, const Point& target,
+                               bool light, uint32_t brand_mask, CandidateSet* sets[2]) const {
+    if (!hood.valid || hood.light != light || hood.brand_mask != brand_mask) {
+      return false;
+    }
+    Point center;
+    center.lab = hood.center;
+    float const MOVED = sqrtf((float)distanceSquared(target, center));
+    uint8_t stored = 0;
+    for (uint8_t set = 0; set < 2; set++) {
+      CandidateSet& candidates = *sets[set];
+      for (uint8_t i = 0; i < hood.counts[set]; i++) {
+        Index const POSITION = hood.positions[stored++];
+        if (POSITION >= points.size()) {
+          return false;  // Neighbourhood of an earlier tree
+        }
+        candidates.offer(points[POSITION], POSITION, distanceSquared(points[POSITION], target));
+      }
+      if (hood.guard[set] == KDTREE_NO_GUARD) {
+        continue;
+      }
+      // One fixed-point unit of slack absorbs float rounding in the square roots
+      if (candidates.count < candidates.limit ||
+          sqrtf((float)candidates.heap[0].dist) + MOVED + 1.0f >= sqrtf((float)hood.guard[set])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Record a walk made with limit KDTREE_NEIGHBOURHOOD + 1: each set's extra
+  // (farthest) point becomes its guard, the rest the neighbourhood
+  static void remember(Neighbourhood& hood, const Point& target, bool light,
+                       uint32_t brand_mask, CandidateSet* sets[2]) {
+    hood.center = target.lab;
+    hood.light = light;
+    hood.brand_mask = brand_mask;
+    uint8_t stored = 0;
+    for (uint8_t set = 0; set < 2; set++) {
+      CandidateSet& candidates = *sets[set];
+      hood.guard[set] = KDTREE_NO_GUARD;
+      if (candidates.count > KDTREE_NEIGHBOURHOOD) {
+        hood.guard[set] = candidates.heap[0].dist;
+        std::pop_heap(candidates.heap, candidates.heap + candidates.count);
+        candidates.count--;
+      }
+      hood.counts[set] = candidates.count;
+      for (uint8_t i = 0; i < candidates.count; i++) {
+        hood.positions[stored++] = candidates.heap[i].position;
+      }
+    }
+    hood.valid = true;
+  }
+
+  // Gather candidates around target_lab and re-rank them with the shared metric
+  // (with hood, a still-valid previous neighbourhood replaces the walk; otherwise the walk's
+  // result is stored in hood for the next query)
+  size_t rankNearest(uint8_t r, uint8_t g, uint8_t b, const CIEDE2000::LAB& target_lab, size_t k,
+                     uint32_t brand_mask, Match* matches,
+                     Neighbourhood* hood = nullptr,
+                     const KDTreeSearchOptions& options = KDTreeSearchOptions(),
+                     KDTreeSearchReport* report = nullptr) const {
+    k = std::min<size_t>(k, KDTREE_MAX_MATCHES);
+    if (k == 0 || !matches) {
+      return 0;
+    }
+    if (options.filter.isActive() && attributes.empty()) {
+      Serial.println("[KDTree] Warning: Filtered query but no attributes attached");
+      return 0;
+    }
+
+    Point const TARGET(r, g, b, duluxLabToFixed(target_lab), 0);
+    CandidateSet candidates;
+    CandidateSet light_candidates;
+    uint8_t const LIMIT = (uint8_t)(k + KDTREE_RERANK_CANDIDATES - 1);
+    bool const LIGHT = isLight(TARGET);
+    candidates.limit = LIMIT;
+    light_candidates.limit = LIMIT;
+    if (k != 1 || options.filter.isActive()) {
+      hood = nullptr;  // Neighbourhoods are sized for unfiltered single-match queries
+    }
+
+    CandidateSet* sets[2] = {&candidates, &light_candidates};
+    if (hood && gatherFromNeighbourhood(*hood, TARGET, LIGHT, brand_mask, sets)) {
+      hood->visited = 0;
+    } else if (hood) {
+      // Walk (always exactly: the guard must be a true bound) for a wider
+      // neighbourhood, then keep the usual candidates out of it
+      for (CandidateSet* set : sets) {
+        set->count = 0;
+        set->limit = KDTREE_NEIGHBOURHOOD + 1;
+      }
+      KDTreeSearchReport walk{0, 0.0f, false};
+      searchNearest(TARGET, brand_mask, candidates, LIGHT ? &light_candidates : nullptr,
+                    KDTreeSearchOptions(), &walk);
+      hood->visited = walk.visited;
+      remember(*hood, TARGET, LIGHT, brand_mask, sets);
+      for (CandidateSet* set : sets) {
+        for (; set->count > LIMIT; set->count--) {
+          std::pop_heap(set->heap, set->heap + set->count);
+        }
+        set->limit = LIMIT;
       }
+    } else {
+      searchNearest(TARGET, brand_mask, candidates, LIGHT ? &light_candidates : nullptr, options,
+                    report);
+    }
 
-      // Safety check - if we're running low on memory, stop
-      if (ESP.getFreePsram() < 500 * 1024) {  // Keep 500KB PSRAM free
-        Serial.printf("[KDTree] Stopping at %u nodes to preserve PSRAM\n", node_count);
-        break;
+    Match ranked[2 * KDTREE_CANDIDATE_CAPACITY];
+    size_t ranked_count = 0;
+    for (const CandidateSet* set : {&candidates, &light_candidates}) {
+      for (uint8_t i = 0; i < set->count; i++) {
+        const Point& candidate = set->heap[i].point;
+        ranked[ranked_count++] = {
+            candidate, duluxCandidateDistance(r, g, b, target_lab, candidate.r, candidate.g,
+                                              candidate.b, duluxLabFromFixed(candidate.lab))};
       }
     }
 
-    return node_count > 0;
+    size_t const COUNT = std::min(k, ranked_count);
+    std::partial_sort(ranked, ranked + COUNT, ranked + ranked_count,
+                      [](const Match& x, const Match& y) {
+                        // Ties go to the earlier palette entry, as in the scans
+                        return x.distance < y.distance ||
+                               (x.distance == y.distance && x.point.index < y.point.index);
+                      });
+    std::copy(ranked, ranked + COUNT, matches);
+    return COUNT;
+  }
+
+  // Partition every range larger than a leaf on its axis around its middle point
+  // (nth_element: linear per range, O(n log n) overall, where sorting each range was
+  // O(n log^2 n)); both halves and the leaf buckets keep whatever order they end up in
+  bool buildImplicitTree() {
+    if (points.empty()) {
+      return false;
+    }
+
+    struct BuildRange {
+      size_t lo;
+      size_t hi;
+      uint8_t depth;
+    };
+    std::vector<BuildRange> pending;
+    pending.push_back({0, points.size(), 0});
+    unsigned long const START_US = micros();
+    size_t splits = 0;
+    size_t partitioned = 0;  // Points moved since the last yield
+
+    while (!pending.empty()) {
+      BuildRange const RANGE = pending.back();
+      pending.pop_back();
+      if (RANGE.hi - RANGE.lo <= leaf_size) {
+        continue;
+      }
+
+      // Choose splitting axis (cycle through L*, a*, b*)
+      uint8_t const AXIS = RANGE.depth % 3;
+      size_t const MID = RANGE.lo + ((RANGE.hi - RANGE.lo) / 2);
+      std::nth_element(points.begin() + RANGE.lo, points.begin() + MID,
+                       points.begin() + RANGE.hi, [AXIS](const Point& a, const Point& b) {
+                         return getCoordinate(a, AXIS) < getCoordinate(b, AXIS);
+                       });
+
+      pending.push_back({RANGE.lo, MID, (uint8_t)(RANGE.depth + 1)});
+      pending.push_back({MID + 1, RANGE.hi, (uint8_t)(RANGE.depth + 1)});
+      splits++;
+
+      // Yield by work done rather than split count: early splits are the large ones
+      partitioned += RANGE.hi - RANGE.lo;
+      if (partitioned >= KDTREE_BUILD_YIELD_POINTS) {
+        partitioned = 0;
+        yield();  // Allow other tasks to run
+      }
+    }
+
+    unsigned long const ARRANGE_US = micros() - START_US;
+    build_stats.points = points.size();
+    build_stats.splits = splits;
+    build_stats.arrange_us = ARRANGE_US;
+    build_stats.points_per_second =
+        (uint32_t)((points.size() * 1000000ULL) / std::max(ARRANGE_US, 1UL));
+    return true;
+  }
+
+  static DuluxKDPointRecord toRecord(const Point& point) {
+    DuluxKDPointRecord record{};
+    record.r = point.r;
+    record.g = point.g;
+    record.b = point.b;
+    record.index = point.index;
+    return record;
+  }
+
+  DuluxKDTreeHeader treeHeader() const {
+    DuluxKDTreeHeader header{};
+    header.leaf_size = leaf_size;
+    header.point_count = points.size();
+    return header;
   }
 
  public:
-  LightweightKDTree() : nodes(PSRAMAllocator<KDNode>()), points(PSRAMAllocator<ColorPoint>()) {
+  BasicKDTree() : points(PSRAMAllocator<Point>()) {
     // Calculate adaptive tree size based on available PSRAM
     calculateOptimalTreeSize();
   }
 
-  ~LightweightKDTree() {
+  ~BasicKDTree() {
     clear();
   }
 
   // Calculate optimal tree size based on available PSRAM
   void calculateOptimalTreeSize() {
     size_t const FREE_PSRAM = ESP.getFreePsram();
-    size_t const FREE_HEAP = ESP.getFreeHeap();
 
-    // Reserve 2MB for other operations, use remaining for KD-tree
-    size_t const AVAILABLE_MEMORY =
-        FREE_PSRAM > 2 * 1024 * 1024 ? FREE_PSRAM - (2 * 1024 * 1024) : 0;
+    // The implicit layout stores nothing but the points
+    max_tree_size = kdTreeMemoryBudget() / sizeof(Point);
 
-    // Each tree node uses sizeof(KDNode) + sizeof(ColorPoint) bytes
-    size_t const BYTES_PER_POINT = sizeof(KDNode) + sizeof(ColorPoint);
-    max_tree_size = AVAILABLE_MEMORY / BYTES_PER_POINT;
-
-    // Cap at reasonable maximum (4500 colors total in database)
-    max_tree_size = std::min<size_t>(max_tree_size, 4500);
+    // Cap at the configured maximum (the index width unless a caller lowers it)
+    max_tree_size = std::min<size_t>(max_tree_size, point_cap);
 
     // Ensure minimum viable tree size
-    max_tree_size = std::max<size_t>(max_tree_size, 500);
+    max_tree_size = std::max<size_t>(max_tree_size, KDTREE_MIN_POINTS);
 
-    Serial.printf("[KDTree] Available PSRAM: %u KB, Optimal tree size: %u colors\n",
-                  FREE_PSRAM / 1024, max_tree_size);
+    Serial.printf("[KDTree] Available PSRAM: %u KB, Optimal tree size: %u colors (%u-bit)\n",
+                  FREE_PSRAM / 1024, max_tree_size, (unsigned)(sizeof(Index) * 8));
+  }
+
+  /**
+   * @brief Lower (or restore) the point cap applied by build(); defaults to MAX_POINTS
+   */
+  void setPointCap(size_t cap) {
+    point_cap = std::min<size_t>(cap, MAX_POINTS);
   }
 
   void clear() {
-    nodes.clear();
     points.clear();
-    node_count = 0;
+    attributes.clear();
+    summaries.clear();
+    leaf_size = DULUX_KD_LEAF_SIZE;
+    build_stats = {0, 0, 0, 0};
     built = false;
   }
 
+  /**
+   * @brief Empty the tree and return its storage to the heap
+   */
+  void release() {
+    clear();
+    points.shrink_to_fit();
+    attributes.shrink_to_fit();
+    summaries.shrink_to_fit();
+  }
+
   // Build tree from color points using iterative method with adaptive sizing
-  bool build(const PSRAMColorVector& input_points) {
+  bool build(const PointVector& input_points) {
     Serial.println("[KDTree] Starting PSRAM-optimized iterative tree construction...");
     unsigned long const START_TIME = millis();
 
@@ -334,14 +861,14 @@ class LightweightKDTree {
                   input_points.size(), max_tree_size);
 
     // Check PSRAM allocation specifically
-    size_t const REQUIRED_MEMORY = actualPoints * (sizeof(KDNode) + sizeof(ColorPoint));
+    size_t const REQUIRED_MEMORY = actualPoints * sizeof(Point);
     size_t const FREE_PSRAM = ESP.getFreePsram();
 
     Serial.printf("[KDTree] Required: %u KB, Available PSRAM: %u KB\n", REQUIRED_MEMORY / 1024,
                   FREE_PSRAM / 1024);
 
     if (REQUIRED_MEMORY > FREE_PSRAM * 0.8) {  // Use only 80% of available PSRAM
-      actualPoints = (FREE_PSRAM * 0.8) / (sizeof(KDNode) + sizeof(ColorPoint));
+      actualPoints = (FREE_PSRAM * 0.8) / sizeof(Point);
       Serial.printf("[KDTree] Reducing size to %u colors to fit in PSRAM\n", actualPoints);
     }
 
@@ -360,18 +887,18 @@ class LightweightKDTree {
         points.push_back(input_points[i]);
       }
 
-      nodes.clear();
-      nodes.resize(actualPoints);
-
       Serial.printf("[KDTree] PSRAM allocation successful for %u points\n", actualPoints);
 
-      // Build a proper balanced tree iteratively
-      if (buildBalancedTree()) {
+      // Arrange the points into the implicit balanced layout
+      if (buildImplicitTree()) {
         built = true;
         unsigned long const BUILD_TIME = millis() - START_TIME;
 
         Serial.printf("[KDTree] Tree built successfully in %u ms\n", BUILD_TIME);
-        Serial.printf("[KDTree] Nodes: %u, Memory: %u KB PSRAM\n", node_count,
+        Serial.printf("[KDTree] Arranged %u points in %lu us (%u points/s, %u splits)\n",
+                      (unsigned)build_stats.points, build_stats.arrange_us,
+                      (unsigned)build_stats.points_per_second, (unsigned)build_stats.splits);
+        Serial.printf("[KDTree] Nodes: %u, Memory: %u KB PSRAM\n", points.size(),
                       getMemoryUsage() / 1024);
         Serial.printf("[KDTree] Remaining PSRAM: %u KB\n", ESP.getFreePsram() / 1024);
 
@@ -386,35 +913,422 @@ class LightweightKDTree {
     return false;
   }
 
+  /**
+   * @brief Adopt a tree prebuilt by the palette compiler (KDT3 section) or a snapshot
+   * @param tree DuluxKDTreeHeader and its point records, may be unaligned
+   *        (e.g. memory-mapped flash)
+   * @param size Bytes available at tree
+   * @param palette_size Number of colors in the palette the records index into
+   * @param lab_of Callable DuluxLabFixed(uint32_t index, uint8_t r, uint8_t g, uint8_t b)
+   *        returning the palette's own L*a*b* of an entry (records carry RGB only)
+   * @return true if the records form a usable tree
+   */
+  template <typename LabOf>
+  bool loadPrebuilt(const uint8_t* tree, size_t size, size_t palette_size, LabOf lab_of) {
+    unsigned long const START_TIME = millis();
+    clear();
+
+    DuluxKDTreeHeader header{};
+    if (!tree || size < sizeof(header)) {
+      Serial.println("[KDTree] Error: Prebuilt tree header missing");
+      return false;
+    }
+    memcpy(&header, tree, sizeof(header));
+    size_t const COUNT = header.point_count;
+    if (header.leaf_size == 0 || COUNT == 0 || COUNT > MAX_POINTS ||
+        size < sizeof(header) + (COUNT * sizeof(DuluxKDPointRecord))) {
+      Serial.println("[KDTree] Error: Empty, oversized or truncated prebuilt tree");
+      return false;
+    }
+
+    try {
+      points.resize(COUNT);
+    } catch (const std::exception& e) {
+      Serial.printf("[KDTree] Error allocating prebuilt tree: %s\n", e.what());
+      clear();
+      return false;
+    }
+
+    const uint8_t* records = tree + sizeof(header);
+    for (size_t i = 0; i < COUNT; i++) {
+      DuluxKDPointRecord record;
+      memcpy(&record, records + (i * sizeof(DuluxKDPointRecord)), sizeof(record));
+
+      // Reject indices that would read outside the palette
+      if (record.index >= palette_size) {
+        Serial.printf("[KDTree] Error: Invalid prebuilt point %u\n", (unsigned)i);
+        clear();
+        return false;
+      }
+      points[i] = Point(record.r, record.g, record.b,
+                        lab_of(record.index, record.r, record.g, record.b), record.index);
+    }
+
+    leaf_size = header.leaf_size;
+    built = true;
+    Serial.printf("[KDTree] Loaded %u prebuilt points in %lu ms (%u KB PSRAM)\n",
+                  (unsigned)points.size(), millis() - START_TIME,
+                  (unsigned)(getMemoryUsage() / 1024));
+    return true;
+  }
+
+  /**
+   * @brief Persist the built tree so the next boot can skip construction
+   * @param palette_crc Identity of the palette the tree indexes
+   * @param requested_points Points the build was asked to index (tree parameter)
+   *
+   * Written to a temporary file and renamed, so a reset mid-write never
+   * leaves a half-written snapshot under the real name.
+   */
+  bool saveSnapshot(const char* path, uint32_t palette_crc, uint32_t color_count,
+                    uint32_t requested_points) const {
+    if (!built || points.empty()) {
+      return false;
+    }
+    unsigned long const START_TIME = millis();
+    DuluxKDTreeHeader const TREE = treeHeader();
+
+    DuluxKDSnapshotHeader header{};
+    header.magic = DULUX_KD_SNAPSHOT_MAGIC;
+    header.version = DULUX_KD_SNAPSHOT_VERSION;
+    header.palette_crc = palette_crc;
+    header.color_count = color_count;
+    header.requested_points = requested_points;
+    header.node_count = points.size();
+    header.nodes_crc = duluxCrc32(0, reinterpret_cast<const uint8_t*>(&TREE), sizeof(TREE));
+    for (const Point& point : points) {
+      if (point.index > UINT16_MAX) {
+        // Records hold 16-bit palette indices; a wide tree that needs more is rebuilt instead
+        Serial.printf("[KDTree] Index %u does not fit a snapshot record\n", (unsigned)point.index);
+        return false;
+      }
+      DuluxKDPointRecord const RECORD = toRecord(point);
+      header.nodes_crc =
+          duluxCrc32(header.nodes_crc, reinterpret_cast<const uint8_t*>(&RECORD), sizeof(RECORD));
+    }
+
+    String const TEMP_PATH = String(path) + ".tmp";
+    File file = LittleFS.open(TEMP_PATH, "w");
+    if (!file) {
+      Serial.printf("[KDTree] Cannot create snapshot %s\n", TEMP_PATH.c_str());
+      return false;
+    }
+
+    bool ok = file.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) ==
+                  sizeof(header) &&
+              file.write(reinterpret_cast<const uint8_t*>(&TREE), sizeof(TREE)) == sizeof(TREE);
+    DuluxKDPointRecord batch[64];
+    for (size_t start = 0; ok && start < points.size(); start += 64) {
+      size_t const COUNT = std::min<size_t>(64, points.size() - start);
+      for (size_t i = 0; i < COUNT; i++) {
+        batch[i] = toRecord(points[start + i]);
+      }
+      size_t const BYTES = COUNT * sizeof(DuluxKDPointRecord);
+      ok = file.write(reinterpret_cast<const uint8_t*>(batch), BYTES) == BYTES;
+    }
+    file.close();
+
+    if (!ok || (LittleFS.exists(path) && !LittleFS.remove(path)) ||
+        !LittleFS.rename(TEMP_PATH, path)) {
+      Serial.printf("[KDTree] Failed to write snapshot %s\n", path);
+      LittleFS.remove(TEMP_PATH);
+      return false;
+    }
+
+    Serial.printf("[KDTree] Snapshot saved: %u points, %u bytes in %lu ms\n",
+                  (unsigned)points.size(),
+                  (unsigned)(sizeof(header) + sizeof(TREE) +
+                             (points.size() * sizeof(DuluxKDPointRecord))),
+                  millis() - START_TIME);
+    return true;
+  }
+
+  /**
+   * @brief Load a snapshot written by saveSnapshot() if it matches the palette
+   * @param lab_of As for loadPrebuilt()
+   * @return false if missing, stale (palette or parameters changed) or corrupt
+   */
+  template <typename LabOf>
+  bool loadSnapshot(const char* path, uint32_t palette_crc, uint32_t color_count,
+                    uint32_t requested_points, LabOf lab_of) {
+    if (!LittleFS.exists(path)) {
+      return false;
+    }
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+      return false;
+    }
+
+    DuluxKDSnapshotHeader header{};
+    if (file.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != DULUX_KD_SNAPSHOT_MAGIC || header.version != DULUX_KD_SNAPSHOT_VERSION) {
+      Serial.printf("[KDTree] Snapshot %s unreadable - rebuilding\n", path);
+      file.close();
+      return false;
+    }
+    if (header.palette_crc != palette_crc || header.color_count != color_count ||
+        header.requested_points != requested_points) {
+      Serial.printf("[KDTree] Snapshot is stale (CRC 0x%08X vs 0x%08X, %u vs %u points)\n",
+                    header.palette_crc, palette_crc, header.requested_points, requested_points);
+      file.close();
+      return false;
+    }
+
+    // One read of the whole tree into a PSRAM staging buffer
+    if (header.node_count == 0 || header.node_count > MAX_POINTS) {
+      file.close();
+      return false;
+    }
+    size_t const BYTES =
+        sizeof(DuluxKDTreeHeader) + ((size_t)header.node_count * sizeof(DuluxKDPointRecord));
+    auto* records =
+        static_cast<uint8_t*>(heap_caps_malloc(BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (!records) {
+      file.close();
+      return false;
+    }
+    bool const READ_OK = file.read(records, BYTES) == BYTES;
+    file.close();
+
+    bool const LOADED = READ_OK && duluxCrc32(0, records, BYTES) == header.nodes_crc &&
+                        loadPrebuilt(records, BYTES, color_count, lab_of);
+    heap_caps_free(records);
+    if (!LOADED) {
+      Serial.printf("[KDTree] Snapshot %s corrupt - rebuilding\n", path);
+    }
+    return LOADED;
+  }
+
+  /**
+   * @brief Store palette attributes and range summaries for filtered queries
+   * @param fetch Callable bool(uint32_t index, uint8_t brand, KDTreeAttributes& attributes)
+   *        returning the attributes of one palette entry
+   * @return false if the tree is not built, an entry cannot be read or PSRAM runs out
+   *
+   * Call after every build or load; clear() drops the attributes with the points.
+   */
+  template <typename Fetch>
+  bool attachAttributes(Fetch fetch) {
+    if (!built || points.empty()) {
+      return false;
+    }
+    unsigned long const START_TIME = millis();
+    try {
+      attributes.resize(points.size());
+      summaries.resize(summaryCount());
+    } catch (const std::exception& e) {
+      Serial.printf("[KDTree] Error allocating attributes: %s\n", e.what());
+      attributes.clear();
+      summaries.clear();
+      return false;
+    }
+    for (size_t i = 0; i < points.size(); i++) {
+      if (!fetch(points[i].index, points[i].brand, attributes[i])) {
+        Serial.printf("[KDTree] Cannot read attributes of color %u\n", (unsigned)points[i].index);
+        attributes.clear();
+        summaries.clear();
+        return false;
+      }
+    }
+    summarizeRanges();
+    Serial.printf("[KDTree] Attributes attached: %u ranges summarized in %lu ms, %u KB PSRAM\n",
+                  (unsigned)summaries.size(), millis() - START_TIME,
+                  (unsigned)(getAttributeMemoryUsage() / 1024));
+    return true;
+  }
+
   // Find nearest neighbor using proper KD-tree search
-  ColorPoint findNearest(uint8_t r, uint8_t g, uint8_t b) const {
-    if (!built || node_count == 0) {
+  Point findNearest(uint8_t r, uint8_t g, uint8_t b) const {
+    Point best;
+    findNearest(r, g, b, KDTREE_ALL_BRANDS, best);
+    return best;
+  }
+
+  /**
+   * @brief Best match among the brands selected by brand_mask
+   * @param brand_mask Bit n set accepts points tagged with brand n
+   * @param distance_out Optional match distance (shared palette metric)
+   * @param options Exact by default; see KDTreeSearchOptions
+   * @param report Receives the work done and the accuracy achieved (optional)
+   * @return false if the tree is empty or holds no point of the selected brands
+   */
+  bool findNearest(uint8_t r, uint8_t g, uint8_t b, uint32_t brand_mask, Point& best,
+                   float* distance_out = nullptr,
+                   const KDTreeSearchOptions& options = KDTreeSearchOptions(),
+                   KDTreeSearchReport* report = nullptr) const {
+    Match match;
+    if (findKNearest(r, g, b, 1, brand_mask, &match, options, report) == 0) {
+      return false;
+    }
+    best = match.point;
+    if (distance_out) {
+      *distance_out = match.distance;
+    }
+    return true;
+  }
+
+  /**
+   * @brief The k best matches among the brands in brand_mask, best first
+   * @param k Matches wanted, clamped to KDTREE_MAX_MATCHES
+   * @param matches Output array with room for k entries
+   * @return Number of matches written (fewer than k if the selection is smaller)
+   *
+   * One traversal serves any k and any brand combination: the nearest
+   * k + KDTREE_RERANK_CANDIDATES - 1 points in L*a*b* are kept in a bounded
+   * max-heap whose root is the pruning radius, and rejected brands never
+   * tighten it. The survivors are re-ranked with duluxCandidateDistance().
+   * Approximate options (KDTreeSearchOptions) loosen that pruning.
+   */
+  size_t findKNearest(uint8_t r, uint8_t g, uint8_t b, size_t k, uint32_t brand_mask,
+                      Match* matches,
+                      const KDTreeSearchOptions& options = KDTreeSearchOptions(),
+                      KDTreeSearchReport* report = nullptr) const {
+    if (!built || points.empty()) {
       Serial.println("[KDTree] Warning: Tree not built or empty");
-      return {};
+      return 0;
     }
+    CIEDE2000::LAB target_lab;
+    rgbToLAB(r, g, b, target_lab);
+    return rankNearest(r, g, b, target_lab, k, brand_mask, matches, nullptr, options, report);
+  }
 
-    ColorPoint const TARGET(r, g, b, 0);
-    ColorPoint best = nodes[0].point;  // Start with root
-    uint32_t bestDist = distanceSquared(TARGET, best);
+  /**
+   * @brief findNearest() for a stream of nearby queries, such as live sensor readings
+   * @param hood State carried between queries; start with valid = false. Its visited
+   *        field reports the points this query examined (0 when nothing was walked).
+   * @return false if the tree is empty or holds no point of the selected brands
+   *
+   * Each walk keeps the KDTREE_NEIGHBOURHOOD nearest points per set plus the
+   * distance of the next one (the guard): every point left out is at least
+   * that far from the query. The next query takes its candidates from the
+   * kept points without touching the tree, provided its farthest candidate
+   * is closer than the guard minus how far the query moved - then no point
+   * outside could have displaced it. The answer is always the one
+   * findNearest() gives (up to exact ties in L*a*b* distance).
+   */
+  bool findNearestIncremental(uint8_t r, uint8_t g, uint8_t b, uint32_t brand_mask,
+                              Neighbourhood& hood, Point& best,
+                              float* distance_out = nullptr) const {
+    if (!built || points.empty()) {
+      hood.valid = false;
+      return false;
+    }
+    CIEDE2000::LAB target_lab;
+    rgbToLAB(r, g, b, target_lab);
+    Match match;
+    if (rankNearest(r, g, b, target_lab, 1, brand_mask, &match, &hood) == 0) {
+      return false;
+    }
+    best = match.point;
+    if (distance_out) {
+      *distance_out = match.distance;
+    }
+    return true;
+  }
 
-    // Use proper KD-tree search if we have a complete tree
-    if (node_count > 1) {
-      searchNearest(1, TARGET, best, bestDist);  // 1-based indexing
+  /**
+   * @brief Best match for each query, written to results in input order
+   * @param count Number of queries, at most KDTREE_MAX_BATCH
+   * @param results Output array with room for count entries
+   * @param options Applied to every query (the budget is per query)
+   * @param report Receives the total points examined, the worst achieved
+   *        epsilon and whether any query ran out of budget (optional)
+   * @return Queries that found a match; the others get distance INFINITY
+   *
+   * The queries are answered in Hilbert-curve order through L*a*b* rather than
+   * input order, so consecutive traversals descend into the same subtrees
+   * while those points are still in cache. Each answer is the same as
+   * findNearest() would give with the same options.
+   */
+  size_t findNearestBatch(const KDTreeQuery* queries, size_t count, uint32_t brand_mask,
+                          Match* results,
+                          const KDTreeSearchOptions& options = KDTreeSearchOptions(),
+                          KDTreeSearchReport* report = nullptr) const {
+    if (report) {
+      *report = {0, 0.0f, false};
+    }
+    if (!built || points.empty() || !queries || !results || count > KDTREE_MAX_BATCH) {
+      return 0;
     }
 
-    return best;
+    // Curve key in the high word, query position in the low word
+    std::vector<uint64_t, PSRAMAllocator<uint64_t>> order;
+    try {
+      order.reserve(count);
+    } catch (const std::exception& e) {
+      Serial.printf("[KDTree] Error allocating batch order: %s\n", e.what());
+      return 0;
+    }
+    for (size_t i = 0; i < count; i++) {
+      uint32_t axes[3];
+      duluxLabToCurveAxes(duluxLabToFixed(queries[i].lab), axes);
+      order.push_back(((uint64_t)duluxHilbertKey(axes) << 32) | i);
+    }
+    std::sort(order.begin(), order.end());
+
+    size_t matched = 0;
+    for (uint64_t const ENTRY : order) {
+      const KDTreeQuery& query = queries[(uint32_t)ENTRY];
+      Match& result = results[(uint32_t)ENTRY];
+      KDTreeSearchReport query_report{0, 0.0f, false};
+      if (rankNearest(query.r, query.g, query.b, query.lab, 1, brand_mask, &result, nullptr,
+                      options, &query_report) == 1) {
+        matched++;
+      } else {
+        result = {Point(), INFINITY};
+      }
+      if (report) {
+        report->visited += query_report.visited;
+        report->achieved_epsilon =
+            std::max(report->achieved_epsilon, query_report.achieved_epsilon);
+        report->budget_exhausted = report->budget_exhausted || query_report.budget_exhausted;
+      }
+    }
+    return matched;
   }
 
   // Get tree statistics
   size_t getNodeCount() const {
-    return node_count;
+    return points.size();
   }
   bool isBuilt() const {
     return built;
   }
+  const KDTreeBuildStats& getBuildStats() const {
+    return build_stats;
+  }
   size_t getMemoryUsage() const {
-    return node_count * sizeof(KDNode) + points.size() * sizeof(ColorPoint);
+    return (points.size() * sizeof(Point)) + getAttributeMemoryUsage();
+  }
+  bool hasAttributes() const {
+    return !attributes.empty();
+  }
+  size_t getAttributeMemoryUsage() const {
+    return (attributes.size() * sizeof(KDTreeAttributes)) +
+           (summaries.size() * sizeof(RangeSummary));
   }
 };
 
+using LightweightKDTree = BasicKDTree<uint16_t>;
+using WideKDTree = BasicKDTree<uint32_t>;
+
+/**
+ * @brief Tree variant and size chosen by planKDTree()
+ */
+struct KDTreePlan {
+  uint8_t index_bits;  // 16: LightweightKDTree, 32: WideKDTree
+  size_t points;       // Points that fit in PSRAM; less than the palette means a partial index
+  size_t bytes;        // PSRAM those points take
+};
+
+/**
+ * @brief Pick the compact 16-bit tree when it can index the whole palette, else the 32-bit one
+ */
+inline KDTreePlan planKDTree(size_t palette_size) {
+  bool const WIDE = palette_size > LightweightKDTree::MAX_POINTS;
+  size_t const BYTES_PER_POINT = WIDE ? sizeof(WideColorPoint) : sizeof(ColorPoint);
+  size_t const POINTS = std::min(palette_size, kdTreeMemoryBudget() / BYTES_PER_POINT);
+  return {(uint8_t)(WIDE ? 32 : 16), POINTS, POINTS * BYTES_PER_POINT};
+}
+
 #endif  // LIGHTWEIGHT_KDTREE_H
@@ -36,6 +36,16 @@
 #include "TCS3430AutoGain.h"  // Using new auto-gain library instead of DFRobot
 #include "WString.h"
 #include "WiFiType.h"
+#include "dulux_exact_scan.h"
+#include "dulux_live_matcher.h"
+#include "dulux_match_cache.h"
+#include "dulux_palette_arena.h"
+#include "dulux_palette_catalog.h"
+#include "dulux_palette_hotswap.h"
+#include "dulux_palette_lut.h"
+#include "dulux_palette_mapping.h"
+#include "dulux_palette_upload.h"
+#include "dulux_parallel_scan.h"
 #include "dulux_simple_reader.h"
 #include "esp32-hal-gpio.h"
 #include "esp32-hal-psram.h"
@@ -62,39 +72,9 @@
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-// Use lightweight KD-tree optimized for embedded systems
-#if ENABLE_KDTREE
-  #include "lightweight_kdtree.h"
-#else
-  // Define ColorPoint and PSRAMColorVector when KD-tree is disabled
-  struct ColorPoint {
-  private:
-    uint8_t r;        // Red value
-    uint8_t g;        // Green value
-    uint8_t b;        // Blue value
-    uint16_t index;   // Index in original database (2 bytes)
-
-  public:
-    ColorPoint() : r(0), g(0), b(0), index(0) {}
-    ColorPoint(uint8_t red, uint8_t green, uint8_t blue, uint16_t idx)
-      : r(red), g(green), b(blue), index(idx) {}
-
-    // Accessor methods (clang-tidy fix for public member variables)
-    uint8_t getRed() const { return r; }
-    uint8_t getGreen() const { return g; }
-    uint8_t getBlue() const { return b; }
-    uint16_t getIndex() const { return index; }
-
-    // Setter methods
-    void setRed(uint8_t red) { r = red; }
-    void setGreen(uint8_t green) { g = green; }
-    void setBlue(uint8_t blue) { b = blue; }
-    void setIndex(uint16_t idx) { index = idx; }
-  };
-
-  // Use the same allocator type as psram_utils.h for consistency
-  using PSRAMColorVector = PSRAMVector<ColorPoint>;
-#endif
+// Lightweight KD-tree optimized for embedded systems; also supplies ColorPoint
+// and the palette catalog index when the single-palette tree is disabled
+#include "lightweight_kdtree.h"
 #include <UMS3.h>
 
 // Color Calibration System
@@ -104,9 +84,12 @@
 // Constants for magic numbers and string literals (clang-tidy optimization)
 namespace {
 constexpr int HTTP_OK = 200;
+constexpr int HTTP_ACCEPTED = 202;
 constexpr int HTTP_BAD_REQUEST = 400;
 constexpr int HTTP_NOT_FOUND = 404;
+constexpr int HTTP_PAYLOAD_TOO_LARGE = 413;
 constexpr int HTTP_TOO_MANY_REQUESTS = 429;
+constexpr int HTTP_SERVICE_UNAVAILABLE = 503;
 constexpr int HTTP_SERVER_PORT = 80;
 constexpr int SERIAL_BAUD_RATE = 115200;
 constexpr int BYTES_PER_KB = 1024;
@@ -118,6 +101,11 @@ constexpr int MAX_COLOR_SAMPLES = 10;
 constexpr int MAX_SAMPLE_DELAY = 50;
 constexpr float MAX_IR_COMPENSATION = 2.0f;
 constexpr int LARGE_COLOR_DB_THRESHOLD = 1000;
+constexpr size_t BATCH_MATCH_MAX_BODY = 32768;  // JSON body of /api/color-match-batch
+constexpr float SEARCH_MAX_EPSILON = 4.0f;       // Largest ?epsilon= of the KD-tree endpoints
+constexpr long SEARCH_MAX_BUDGET = 65535;        // Largest ?budget= (points per query)
+constexpr float SEARCH_LRV_SCALE = 100.0f;       // ?lrvMin= / ?lrvMax= to palette LRV * 100
+constexpr float SEARCH_LRV_MAX = 100.0f;         // Largest LRV a filter can name
 
 // Common string literals to reduce duplication
 constexpr const char* JSON_CONTENT_TYPE = "application/json";
@@ -865,8 +853,44 @@ void handleSetFloatSetting(AsyncWebServerRequest *request, const String& paramNa
 // Simple binary color database reader
 // Color database instances (mutable - maintains file state and cache)
 static DuluxSimpleReader simpleColorDB;
+// Zero-copy palette mapped from the flash partition (preferred when present)
+static DuluxPaletteMapping mappedPalette;
+// Whole palette bulk-loaded into one PSRAM block (used when no partition is mapped)
+static DuluxPaletteArena arenaPalette;
 #if ENABLE_KDTREE
 static LightweightKDTree kdTreeColorDB;
+// KD-tree matching of consecutive live readings, reusing the previous neighbourhood (loop() only)
+static DuluxLiveMatcher liveMatcher;
+#endif
+#if ENABLE_EXACT_SCAN
+// L*-sorted copy of the palette for the bound-pruned exact scan
+static DuluxExactScan exactScan;
+#endif
+#if ENABLE_MATCH_CACHE
+// Recent answers by quantized L*a*b*, shared by single, capture and batch matching
+static DuluxMatchCache matchCache;
+#endif
+#if ENABLE_PARALLEL_SCAN
+// One worker per core for the exact scan and the exhaustive mapped-palette and arena scans
+static DuluxParallelScan parallelScan;
+#endif
+#if ENABLE_PALETTE_LUT
+// Offline-computed answers per quantized RGB cell for the active palette
+static DuluxPaletteLut paletteLut;
+#endif
+#if ENABLE_PALETTE_HOTSWAP
+// Palette loaded at runtime via /api/palette-reload; once published it takes precedence
+static DuluxPaletteHotSwap paletteHotSwap;
+#endif
+#if ENABLE_PALETTE_UPLOAD
+// One streaming palette upload at a time; owner is the request whose body is being written
+static DuluxPaletteUpload paletteUpload;
+static AsyncWebServerRequest *paletteUploadOwner = nullptr;
+static bool paletteUploadAccepted = false;
+#endif
+#if ENABLE_PALETTE_CATALOG
+// Brand palettes listed in the catalog manifest, searched through one shared index
+static DuluxPaletteCatalog paletteCatalog;
 #endif
 
 // Legacy compatibility structure (for fallback colors only)
@@ -914,6 +938,315 @@ using PSRAMColorMatchVector = PSRAMVector<ColorMatch>;
 
 // Color database will use only dulux.bin - no fallback database
 
+// Number of colors in the active palette (mapped partition or LittleFS file)
+static size_t paletteColorCount() {
+  if (mappedPalette.isMapped()) {
+    return mappedPalette.getView().getColorCount();
+  }
+  if (arenaPalette.isLoaded()) {
+    return arenaPalette.getColorCount();
+  }
+  return simpleColorDB.isOpen() ? simpleColorDB.getColorCount() : 0;
+}
+
+// Identity of the active palette (keys cached derived data such as the KD-tree snapshot)
+static uint32_t paletteCrc() {
+  if (mappedPalette.isMapped()) {
+    return mappedPalette.getView().getPaletteCrc();
+  }
+  if (arenaPalette.isLoaded()) {
+    return arenaPalette.getPaletteCrc();
+  }
+  return simpleColorDB.isOpen() ? simpleColorDB.getPaletteCrc() : 0;
+}
+
+// Read the RGB values of one palette entry from whichever backend is active
+static bool readPaletteRGB(size_t index, uint8_t &red, uint8_t &green, uint8_t &blue) {
+  if (mappedPalette.isMapped()) {
+    const DuluxPaletteView &view = mappedPalette.getView();
+    if (index >= view.getColorCount()) {
+      return false;
+    }
+    const uint8_t *rgb = view.rgb(index);
+    red = rgb[0];
+    green = rgb[1];
+    blue = rgb[2];
+    return true;
+  }
+  if (arenaPalette.isLoaded()) {
+    if (index >= arenaPalette.getColorCount()) {
+      return false;
+    }
+    const DuluxArenaRecord &record = arenaPalette.record(index);
+    red = record.r;
+    green = record.g;
+    blue = record.b;
+    return true;
+  }
+
+  SimpleColor color{};
+  if (!simpleColorDB.getColorByIndex(index, color)) {
+    return false;
+  }
+  red = color.r;
+  green = color.g;
+  blue = color.b;
+  return true;
+}
+
+#if ENABLE_KDTREE || ENABLE_EXACT_SCAN
+// The palette's own L*a*b* of an entry readPaletteRGB() returned r, g, b for; the v1
+// streaming reader has no LAB column and converts the same way the compiler does
+static DuluxLabFixed paletteLab(size_t index, uint8_t red, uint8_t green, uint8_t blue) {
+  if (mappedPalette.isMapped()) {
+    return mappedPalette.getView().lab(index);
+  }
+  if (arenaPalette.isLoaded()) {
+    return arenaPalette.record(index).lab;
+  }
+  return ColorPoint::labOf(red, green, blue);
+}
+#endif
+
+#if ENABLE_KDTREE && ENABLE_KDTREE_FILTERS
+// Read the LRV (* 100) and DULUX_FLAG_* bits of one palette entry
+static bool readPaletteAttributes(size_t index, uint16_t &lrvScaled, uint8_t &flags) {
+  if (mappedPalette.isMapped()) {
+    const DuluxPaletteView &view = mappedPalette.getView();
+    if (index >= view.getColorCount()) {
+      return false;
+    }
+    lrvScaled = view.lrvScaled(index);
+    flags = view.lightText(index) ? DULUX_FLAG_LIGHT_TEXT : 0;
+    return true;
+  }
+  if (arenaPalette.isLoaded()) {
+    if (index >= arenaPalette.getColorCount()) {
+      return false;
+    }
+    const DuluxArenaRecord &record = arenaPalette.record(index);
+    lrvScaled = record.lrv_scaled;
+    flags = record.flags;
+    return true;
+  }
+
+  SimpleColor color{};
+  if (!simpleColorDB.getColorByIndex(index, color)) {
+    return false;
+  }
+  lrvScaled = color.lrv_scaled;
+  flags = color.light_text ? DULUX_FLAG_LIGHT_TEXT : 0;
+  return true;
+}
+#endif
+
+#if ENABLE_EXACT_SCAN
+// Index the active palette for the exact scan, with the same L*a*b* the plain scans use
+static bool buildExactScan() {
+  return exactScan.build(paletteColorCount(), [](uint32_t index, uint8_t &red, uint8_t &green,
+                                                 uint8_t &blue, DuluxLabFixed &lab) {
+    if (!readPaletteRGB(index, red, green, blue)) {
+      return false;
+    }
+    lab = paletteLab(index, red, green, blue);
+    return true;
+  });
+}
+#endif
+
+// Decode the name and code of one palette entry into caller buffers
+static bool copyPaletteStrings(size_t index, char *name, size_t name_size, char *code,
+                               size_t code_size) {
+  if (mappedPalette.isMapped()) {
+    const DuluxPaletteView &view = mappedPalette.getView();
+    if (index >= view.getColorCount()) {
+      return false;
+    }
+    view.copyName(index, name, name_size);
+    view.copyCode(index, code, code_size);
+    return true;
+  }
+  if (arenaPalette.isLoaded()) {
+    if (index >= arenaPalette.getColorCount()) {
+      return false;
+    }
+    arenaPalette.copyName(index, name, name_size);
+    arenaPalette.copyCode(index, code, code_size);
+    return true;
+  }
+  return simpleColorDB.readName(index, name, name_size) &&
+         simpleColorDB.readCode(index, code, code_size);
+}
+
+#if ENABLE_PALETTE_HOTSWAP
+// Palette scopes currently open; the boot palette is released only while this is 0
+static std::atomic<uint32_t> paletteReaders{0};
+#endif
+
+#if ENABLE_KDTREE
+// A tree short of the palette (capped by KDTREE_MAX_COLORS or its 16-bit index) never answers
+// alone, since the true match may be a color it lacks; it still seeds the exact scan
+static bool kdtreeCoversPalette() {
+  return kdTreeColorDB.isBuilt() && kdTreeColorDB.getNodeCount() == paletteColorCount();
+}
+#endif
+
+/**
+ * @brief The palette one request matches against and names from
+ *
+ * Once a hot-swapped palette is published every new scope gets it and keeps
+ * it alive for the request. Until then the scope stands for the boot palette
+ * and its indexes. Every open scope counts as a reader, so
+ * releaseSupersededBootPalette() never frees the boot palette under a
+ * request, including one that falls back to it. Take one scope per request
+ * and pass it along, so matching and naming always see the same palette.
+ */
+class PaletteScope {
+ public:
+  PaletteScope() {
+#if ENABLE_PALETTE_HOTSWAP
+    // Counted before looking: the releaser either sees this reader or it sees the new palette
+    paletteReaders.fetch_add(1);
+    live_palette = paletteHotSwap.acquire();
+#endif
+  }
+  ~PaletteScope() {
+#if ENABLE_PALETTE_HOTSWAP
+    paletteReaders.fetch_sub(1);
+#endif
+  }
+  PaletteScope(const PaletteScope &) = delete;
+  PaletteScope &operator=(const PaletteScope &) = delete;
+
+  // Hot-swapped palette, or nullptr for the boot palette
+  const DuluxLivePalette *live() const {
+    return live_palette.get();
+  }
+  // Match cache generation of this palette (the boot palette is 0)
+  uint32_t generation() const {
+    return live_palette ? live_palette->getGeneration() : 0;
+  }
+
+  size_t colorCount() const {
+    return live_palette ? live_palette->getPalette().getColorCount() : paletteColorCount();
+  }
+
+  bool readRGB(size_t index, uint8_t &red, uint8_t &green, uint8_t &blue) const {
+    if (!live_palette) {
+      return readPaletteRGB(index, red, green, blue);
+    }
+    const DuluxPaletteArena &palette = live_palette->getPalette();
+    if (index >= palette.getColorCount()) {
+      return false;
+    }
+    const DuluxArenaRecord &record = palette.record(index);
+    red = record.r;
+    green = record.g;
+    blue = record.b;
+    return true;
+  }
+
+  // Decode the name and code of one entry into caller buffers
+  bool copyStrings(size_t index, char *name, size_t name_size, char *code,
+                   size_t code_size) const {
+    if (!live_palette) {
+      return copyPaletteStrings(index, name, name_size, code, code_size);
+    }
+    const DuluxPaletteArena &palette = live_palette->getPalette();
+    if (index >= palette.getColorCount()) {
+      return false;
+    }
+    palette.copyName(index, name, name_size);
+    palette.copyCode(index, code, code_size);
+    return true;
+  }
+
+  // Format one entry as "Name (CODE)"; strings are decoded for this entry only
+  bool describe(size_t index, String &out) const {
+    char name[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    char code[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    if (!copyStrings(index, name, sizeof(name), code, sizeof(code))) {
+      return false;
+    }
+    out = String(name) + " (" + String(code) + ")";
+    return true;
+  }
+
+#if ENABLE_KDTREE
+  // KD-tree of this palette, or nullptr if it has none
+  const LightweightKDTree *tree() const {
+    if (live_palette) {
+      return live_palette->isTreeIndexed() ? &live_palette->getTree() : nullptr;
+    }
+    return settings.enableKdtree && kdtreeCoversPalette() ? &kdTreeColorDB : nullptr;
+  }
+#endif
+
+#if ENABLE_EXACT_SCAN
+  // Exact scan of this palette, or nullptr if it has none
+  const DuluxExactScan *exact() const {
+    if (live_palette) {
+      return live_palette->isExactIndexed() ? &live_palette->getExactScan() : nullptr;
+    }
+    return exactScan.isBuilt() ? &exactScan : nullptr;
+  }
+#endif
+
+ private:
+  std::shared_ptr<const DuluxLivePalette> live_palette;
+};
+
+#if ENABLE_KDTREE
+// Adopt the KD-tree precomputed by the palette compiler (KDT3 section), if the palette has one
+static bool loadPrebuiltKDTree() {
+  size_t const COLOR_COUNT = paletteColorCount();
+
+  if (mappedPalette.isMapped()) {
+    uint32_t size = 0;
+    const uint8_t *records = mappedPalette.getView().section(DULUX_SECTION_KDTREE, &size);
+    return records && kdTreeColorDB.loadPrebuilt(records, size, COLOR_COUNT, paletteLab);
+  }
+  if (arenaPalette.isLoaded()) {
+    uint32_t size = 0;
+    const uint8_t *records = arenaPalette.section(DULUX_SECTION_KDTREE, &size);
+    return records && kdTreeColorDB.loadPrebuilt(records, size, COLOR_COUNT, paletteLab);
+  }
+
+  uint32_t const SIZE = simpleColorDB.getSectionSize(DULUX_SECTION_KDTREE);
+  if (SIZE == 0) {
+    return false;
+  }
+  PSRAMByteVector records(SIZE);
+  return simpleColorDB.readSection(DULUX_SECTION_KDTREE, records.data(), records.size()) &&
+         kdTreeColorDB.loadPrebuilt(records.data(), SIZE, COLOR_COUNT, paletteLab);
+}
+
+// Points a KD-tree build is asked to index (part of the snapshot key)
+static uint32_t kdtreeRequestedPoints() {
+  return (uint32_t)min(paletteColorCount(), (size_t)settings.kdtreeMaxColors);
+}
+
+// Restore the tree saved by a previous boot if it was built from this palette
+static bool loadKDTreeSnapshot() {
+#if ENABLE_KDTREE_SNAPSHOT
+  return kdTreeColorDB.loadSnapshot(KDTREE_SNAPSHOT_PATH, paletteCrc(), paletteColorCount(),
+                                    kdtreeRequestedPoints(), paletteLab);
+#else
+  return false;
+#endif
+}
+
+#if ENABLE_KDTREE_FILTERS
+// Give the tree (however it was obtained) the LRV and flags that filtered matches test
+static bool attachKDTreeAttributes() {
+  return kdTreeColorDB.attachAttributes(
+      [](uint32_t index, uint8_t /*brand*/, KDTreeAttributes &attributes) {
+        return readPaletteAttributes(index, attributes.lrv_scaled, attributes.flags);
+      });
+}
+#endif
+#endif
+
 // Load color database from binary file with optimized memory usage
 static bool loadColorDatabase() {
   Logger::info(String("=== Starting binary color database load process ==="));
@@ -948,13 +1281,47 @@ static bool loadColorDatabase() {
 
   Logger::info("Memory check complete, proceeding with binary file loading...");
 
-  // Try to open binary database first (preferred method)
-  Logger::info("Attempting to open binary color database: /dulux.bin");
-  if (simpleColorDB.openDatabase("/dulux.bin")) {
+  bool paletteReady = false;
+#if ENABLE_MAPPED_PALETTE
+  // Zero-copy palette partition first: no file reads, no heap or PSRAM for the palette
+  Logger::info("Attempting to map palette partition: " PALETTE_PARTITION_LABEL);
+  paletteReady = mappedPalette.map(PALETTE_PARTITION_LABEL);
+  if (!paletteReady) {
+    Logger::info("No mapped palette available - falling back to LittleFS");
+  }
+#endif
+
+#if ENABLE_PALETTE_ARENA
+  // Bulk-load the file into PSRAM: a few large reads, no per-record file I/O afterwards
+  if (!paletteReady) {
+    Logger::info("Bulk-loading /dulux.bin into PSRAM arena");
+    paletteReady = arenaPalette.load("/dulux.bin");
+    if (paletteReady) {
+      const DuluxArenaStats &stats = arenaPalette.getStats();
+      char arenaMsg[128];
+      sprintf(arenaMsg, "Arena loaded: %u bytes in %u reads, read %lums, parse %lums",
+              (unsigned)stats.bytes_read, (unsigned)stats.read_calls, stats.read_us / 1000,
+              stats.parse_us / 1000);
+      Logger::info(arenaMsg);
+    } else {
+      Logger::warn("PSRAM arena load failed - falling back to streaming reader");
+    }
+  }
+#endif
+
+  // Otherwise open the binary database file
+  if (!paletteReady) {
+    Logger::info("Attempting to open binary color database: /dulux.bin");
+    paletteReady = simpleColorDB.openDatabase("/dulux.bin");
+  }
+
+  if (paletteReady) {
     unsigned long const LOAD_TIME = millis() - START_TIME;
-    size_t const COLOR_COUNT = simpleColorDB.getColorCount();
+    size_t const COLOR_COUNT = paletteColorCount();
 
-    Logger::info("Binary color database opened successfully!");
+    Logger::info(mappedPalette.isMapped()   ? "Palette partition mapped successfully!"
+                 : arenaPalette.isLoaded() ? "Palette loaded into PSRAM arena successfully!"
+                                           : "Binary color database opened successfully!");
     char colorMsg[64];
     sprintf(colorMsg, "Colors available: %zu", COLOR_COUNT);
     Logger::info(colorMsg);
@@ -985,7 +1352,13 @@ static bool loadColorDatabase() {
     settings.enableKdtree = shouldUseKdtree;
 
 #if ENABLE_KDTREE
-    if (shouldUseKdtree) {
+    if (shouldUseKdtree && loadPrebuiltKDTree()) {
+      Logger::info("Using prebuilt KD-tree from palette (" + String(kdTreeColorDB.getNodeCount()) +
+                   " nodes) - skipping on-device construction");
+    } else if (shouldUseKdtree && loadKDTreeSnapshot()) {
+      Logger::info("Restored KD-tree snapshot (" + String(kdTreeColorDB.getNodeCount()) +
+                   " nodes) in " + String(millis() - START_TIME) + "ms since load start");
+    } else if (shouldUseKdtree) {
       // Initialize KD-tree with data from binary database
       Logger::info("Building lightweight KD-tree for optimized color search...");
       unsigned long const KD_START_TIME = millis();
@@ -1016,6 +1389,12 @@ static bool loadColorDatabase() {
                 effectiveColorCount, COLOR_COUNT);
         Logger::warn(String(limitMsg));
       }
+      // The main tree stores 16-bit palette indices (multi-brand catalogs use the wide tree)
+      if (effectiveColorCount > LightweightKDTree::MAX_POINTS) {
+        Logger::warn("Limiting KD-tree to " + String((unsigned)LightweightKDTree::MAX_POINTS) +
+                     " colors (16-bit index); use the palette catalog for larger sets");
+        effectiveColorCount = LightweightKDTree::MAX_POINTS;
+      }
 
       // Create vector of color points for the lightweight KD-tree
       PSRAMColorVector colorPoints;
@@ -1040,9 +1419,11 @@ static bool loadColorDatabase() {
           break;
         }
 
-        SimpleColor color{};
-        if (simpleColorDB.getColorByIndex(i, color)) {
-          ColorPoint point(color.r, color.g, color.b, (uint16_t)i);
+        uint8_t red = 0;
+        uint8_t green = 0;
+        uint8_t blue = 0;
+        if (readPaletteRGB(i, red, green, blue)) {
+          ColorPoint point(red, green, blue, paletteLab(i, red, green, blue), (uint16_t)i);
           colorPoints.push_back(point);
           loadedCount++;
 
@@ -1103,6 +1484,7 @@ static bool loadColorDatabase() {
       } else {
         Logger::info(String("Starting lightweight KD-tree construction..."));
 
+        kdTreeColorDB.setPointCap((size_t)settings.kdtreeMaxColors);
         if (kdTreeColorDB.build(colorPoints)) {
           unsigned long const KD_LOAD_TIME = millis() - KD_START_TIME;
           size_t const MEMORY_USAGE = kdTreeColorDB.getMemoryUsage();
@@ -1110,6 +1492,8 @@ static bool loadColorDatabase() {
           Logger::info("?? KD-tree built successfully in " + String(KD_LOAD_TIME) + "ms");
           Logger::info("?? KD-tree stats: " + String(kdTreeColorDB.getNodeCount()) + " nodes, " +
                        String(MEMORY_USAGE) + " bytes");
+          Logger::info("?? KD-tree layout: " +
+                       String(kdTreeColorDB.getBuildStats().points_per_second) + " points/s");
           Logger::info("?? Search performance: O(log " + String(loadedCount) + ") vs O(" +
                        String(loadedCount) + ") linear");
           Logger::info("?? PSRAM after KD-tree: " + String(ESP.getFreePsram() / BYTES_PER_KB) +
@@ -1120,6 +1504,14 @@ static bool loadColorDatabase() {
           Logger::info("? Estimated search speedup: " + String(speedupFactor, 1) +
                        "x faster than linear search");
 
+#if ENABLE_KDTREE_SNAPSHOT
+          // Next boot loads this with one read instead of rebuilding
+          if (!kdTreeColorDB.saveSnapshot(KDTREE_SNAPSHOT_PATH, paletteCrc(), COLOR_COUNT,
+                                          kdtreeRequestedPoints())) {
+            Logger::warn("Could not save KD-tree snapshot - tree will be rebuilt next boot");
+          }
+#endif
+
         } else {
           Logger::error("Failed to build KD-tree - falling back to binary database only");
           Logger::warn("This may indicate insufficient memory or corrupted color data");
@@ -1131,10 +1523,44 @@ static bool loadColorDatabase() {
       Logger::info(String("KD-tree disabled by optimization logic - using binary database only"));
       Logger::info(String("This provides optimal performance for current configuration"));
     }
+
+#if ENABLE_KDTREE_FILTERS
+    if (settings.enableKdtree && kdTreeColorDB.isBuilt() && !attachKDTreeAttributes()) {
+      Logger::warn("KD-tree attributes unavailable - LRV and light-text filters disabled");
+    }
+#endif
+    if (settings.enableKdtree && kdTreeColorDB.isBuilt() && !kdtreeCoversPalette()) {
+      Logger::warn("KD-tree holds " + String(kdTreeColorDB.getNodeCount()) + " of " +
+                   String(COLOR_COUNT) + " colors - it seeds the exact scan but never answers");
+    }
 #else
     Logger::info(String("KD-tree disabled at compile time - using binary database only"));
 #endif
 
+#if ENABLE_EXACT_SCAN
+    if (!buildExactScan()) {
+      Logger::warn("Exact scan index unavailable - exhaustive searches use the plain scan");
+    }
+#endif
+#if ENABLE_PARALLEL_SCAN
+    // The exact scan splits its L* window between the workers; the plain scans split the palette
+    if (parallelScan.begin()) {
+#if ENABLE_EXACT_SCAN
+      exactScan.setWorkers(&parallelScan);
+#endif
+#if ENABLE_PALETTE_HOTSWAP
+      paletteHotSwap.setScanWorkers(&parallelScan);
+#endif
+    } else {
+      Logger::warn("Parallel scan workers unavailable - exhaustive scans use one core");
+    }
+#endif
+#if ENABLE_PALETTE_LUT
+    if (!paletteLut.load(PALETTE_LUT_PATH, paletteCrc(), paletteColorCount())) {
+      Logger::info("No lookup table for this palette - build one with palette_compiler --lut");
+    }
+#endif
+
     return true;
   }
 
@@ -1144,6 +1570,80 @@ static bool loadColorDatabase() {
   Logger::error(String("JSON fallback is not supported in this version"));
   return false;
 }
+
+#if ENABLE_PALETTE_CATALOG
+// Mount the brand palettes listed in the manifest and index them together.
+// Manifest: {"palettes":[{"brand":"Dulux","file":"/dulux.bin"},{"brand":"...","file":"..."}]}
+static bool loadPaletteCatalog() {
+  if (!LittleFS.exists(PALETTE_CATALOG_MANIFEST)) {
+    Logger::info("No palette catalog manifest (" PALETTE_CATALOG_MANIFEST ") - single palette only");
+    return false;
+  }
+  File manifest = LittleFS.open(PALETTE_CATALOG_MANIFEST, "r");
+  if (!manifest) {
+    Logger::warn("Cannot open palette catalog manifest");
+    return false;
+  }
+  JsonDocument doc;
+  DeserializationError const ERROR = deserializeJson(doc, manifest);
+  manifest.close();
+  if (ERROR) {
+    Logger::warn("Invalid palette catalog manifest: " + String(ERROR.c_str()));
+    return false;
+  }
+
+  unsigned long const START_TIME = millis();
+  paletteCatalog.unmountAll();
+  for (JsonObject entry : doc["palettes"].as<JsonArray>()) {
+    const char *brand = entry["brand"] | "";
+    const char *file = entry["file"] | "";
+    if (paletteCatalog.mount(brand, file) < 0) {
+      Logger::warn("Skipping catalog palette " + String(brand) + " (" + String(file) + ")");
+    }
+  }
+  if (paletteCatalog.getPaletteCount() == 0) {
+    Logger::warn("Palette catalog manifest lists no loadable palettes");
+    return false;
+  }
+  if (!paletteCatalog.buildIndex(ENABLE_KDTREE_FILTERS)) {
+    Logger::error("Failed to build palette catalog index");
+    paletteCatalog.unmountAll();
+    return false;
+  }
+
+  char catalogMsg[128];
+  sprintf(catalogMsg, "Palette catalog ready: %u brands, %u colors, %u-bit index %u KB in %lums",
+          (unsigned)paletteCatalog.getPaletteCount(), (unsigned)paletteCatalog.getTotalColors(),
+          (unsigned)paletteCatalog.getIndexBits(),
+          (unsigned)(paletteCatalog.getIndexMemoryUsage() / BYTES_PER_KB), millis() - START_TIME);
+  Logger::info(catalogMsg);
+  return true;
+}
+
+// Brand mask from a comma-separated list of brand names ("all" or empty = every brand)
+static uint32_t parseCatalogBrandMask(const String &brands) {
+  if (brands.length() == 0 || brands.equalsIgnoreCase("all")) {
+    return paletteCatalog.allBrandsMask();
+  }
+  uint32_t mask = 0;
+  int start = 0;
+  while (start <= (int)brands.length()) {
+    int end = brands.indexOf(',', start);
+    if (end < 0) {
+      end = brands.length();
+    }
+    String brand = brands.substring(start, end);
+    brand.trim();
+    int const ID = paletteCatalog.findBrand(brand.c_str());
+    if (ID >= 0) {
+      mask |= DuluxPaletteCatalog::brandMask((uint8_t)ID);
+    }
+    start = end + 1;
+  }
+  return mask;
+}
+#endif
+
 // Calculate color distance using CIEDE2000 algorithm
 float calculateColorDistance(uint8_t red1, uint8_t green1, uint8_t blue1, uint8_t red2, uint8_t green2,
                                     uint8_t blue2) {
@@ -1183,36 +1683,183 @@ static String findClosestDuluxColor(uint8_t red, uint8_t green, uint8_t blue) {
   String searchMethod = "Unknown";
   String result = "Unknown Color";
 
+  // Hot-swapped palette if one is live (kept alive even if a newer one is published
+  // mid-search), else the boot palette, which stays loaded until this search is done
+  PaletteScope const PALETTE;
+#if ENABLE_PALETTE_HOTSWAP
+  if (const DuluxLivePalette *const LIVE = PALETTE.live()) {
+    const DuluxPaletteArena &palette = LIVE->getPalette();
+#if ENABLE_MATCH_CACHE
+    // Keyed by generation, so answers for an earlier palette never hit
+    uint64_t const LIVE_KEY = DuluxMatchCache::keyFor(red, green, blue, LIVE->getGeneration());
+    uint32_t best = palette.getColorCount();
+    float distance = 0.0f;
+    if (!matchCache.lookup(LIVE_KEY, best, distance)) {
+      best = LIVE->findClosest(red, green, blue, &distance);
+      if (best < palette.getColorCount()) {
+        matchCache.insert(LIVE_KEY, best, distance);
+      }
+    }
+    uint32_t const BEST = best;
+#else
+    uint32_t const BEST = LIVE->findClosest(red, green, blue);
+#endif
+    if (PALETTE.describe(BEST, result)) {
+      if (settings.debugColorMatching) {
+        Logger::debug("Live palette gen " + String(LIVE->getGeneration()) + " (" +
+                      (LIVE->isExactIndexed() ? "exact scan" : "plain scan") + ") matched " +
+                      result + " in " + String(micros() - SEARCH_START_TIME) + "us");
+      }
+      return result;
+    }
+  }
+#endif
+
+#if ENABLE_PALETTE_LUT
+  // Precomputed table: exact for most cells; boundary cells are refined from the cell's hint
+  uint32_t lutIndex = 0;
+  bool const LUT_EXACT = paletteLut.lookup(red, green, blue, lutIndex);
+  if (LUT_EXACT && PALETTE.describe(lutIndex, result)) {
+    if (settings.debugColorMatching) {
+      Logger::debug("Lookup table hit in " + String(micros() - SEARCH_START_TIME) + "us: " +
+                    result);
+    }
+    return result;
+  }
+#endif
+
+#if ENABLE_MATCH_CACHE
+  // Main palette answers: a repeat of a recently matched color skips every search below
+  uint64_t const CACHE_KEY = DuluxMatchCache::keyFor(red, green, blue, 0);
+  uint32_t cachedIndex = 0;
+  float cachedDistance = 0.0f;
+  if (matchCache.lookup(CACHE_KEY, cachedIndex, cachedDistance) &&
+      PALETTE.describe(cachedIndex, result)) {
+    if (settings.debugColorMatching) {
+      Logger::debug("Match cache hit in " + String(micros() - SEARCH_START_TIME) + "us, dE " +
+                    String(cachedDistance, 2) + ": " + result);
+    }
+    return result;
+  }
+  auto cacheResult = [&](uint32_t index, float distance) {
+    matchCache.insert(CACHE_KEY, index, distance);
+  };
+#else
+  auto cacheResult = [](uint32_t /*index*/, float /*distance*/) {};
+#endif
+
+#if ENABLE_EXACT_SCAN
+  // Exact scan: the true optimum under the shared metric. A close first candidate (the lookup
+  // table cell's hint, else the KD-tree's answer) tightens its bounds from the start
+  if (exactScan.isBuilt()) {
+    uint32_t seed = DULUX_EXACT_NO_SEED;
+#if ENABLE_PALETTE_LUT
+    if (paletteLut.isLoaded()) {
+      seed = lutIndex;
+    }
+#endif
+#if ENABLE_KDTREE
+    ColorPoint hint;
+    if (seed == DULUX_EXACT_NO_SEED && settings.enableKdtree && kdTreeColorDB.isBuilt() &&
+        kdTreeColorDB.findNearest(red, green, blue, KDTREE_ALL_BRANDS, hint)) {
+      seed = hint.getIndex();
+    }
+#endif
+    searchMethod = "Exact Scan";
+    float distance = 0.0f;
+    uint32_t const BEST = exactScan.findClosest(red, green, blue, &distance, nullptr, seed);
+    if (PALETTE.describe(BEST, result)) {
+      cacheResult(BEST, distance);
+      if (settings.debugColorMatching) {
+        Logger::debug("Exact scan completed in " + String(micros() - SEARCH_START_TIME) +
+                      "us, seed " + String(seed) + " dE " + String(distance, 2) + ": " +
+                      result);
+      }
+      return result;
+    }
+  }
+#endif
+
 #if ENABLE_KDTREE
-  // Try KD-tree search first (fastest - O(log n) average case) if enabled and built
-  if (settings.enableKdtree && kdTreeColorDB.isBuilt()) {
+  // KD-tree alone is approximate (its dE76 candidates can miss the CIEDE2000 winner), so it
+  // only answers when the exact scan is unavailable, and only if it holds the whole palette
+  if (settings.enableKdtree && kdtreeCoversPalette()) {
     searchMethod = "KD-Tree";
     Logger::info("?? Using KD-tree search for RGB(" + String(red) + "," + String(green) + "," + String(blue) + ")");
-    ColorPoint const CLOSEST = kdTreeColorDB.findNearest(red, green, blue);
-    Logger::info("?? KD-tree returned index: " + String(CLOSEST.getIndex()) + " RGB(" + String(CLOSEST.getRed()) + "," + String(CLOSEST.getGreen()) + "," + String(CLOSEST.getBlue()) + ")");
-    if (CLOSEST.getIndex() > 0) {
-      // Get the full color data using the index
-      SimpleColor color{};
-      if (simpleColorDB.getColorByIndex(CLOSEST.getIndex(), color)) {
-        result = String(color.name) + " (" + String(color.code) + ")";
-        Logger::info("?? KD-tree final result: " + result);
-
-        if (settings.debugColorMatching) {
-          unsigned long const SEARCH_TIME = micros() - SEARCH_START_TIME;
-          Logger::debug("KD-tree search completed in " + String(SEARCH_TIME) +
-                        "�s. Best match: " + result);
-        }
-        return result;
+    ColorPoint closest;
+    float distance = 0.0f;
+    // Index 0 is a valid palette entry, so success is reported separately from the point
+    if (kdTreeColorDB.findNearest(red, green, blue, KDTREE_ALL_BRANDS, closest, &distance) &&
+        PALETTE.describe(closest.getIndex(), result)) {
+      cacheResult(closest.getIndex(), distance);
+      if (settings.debugColorMatching) {
+        unsigned long const SEARCH_TIME = micros() - SEARCH_START_TIME;
+        Logger::debug("KD-tree search completed in " + String(SEARCH_TIME) + "us, index " +
+                      String(closest.getIndex()) + " dE " + String(distance, 2) + ": " + result);
       }
+      return result;
     }
     Logger::warn("KD-tree search failed, falling back to binary database");
   } else if (settings.enableKdtree && !kdTreeColorDB.isBuilt()) {
     Logger::warn("KD-tree enabled but not built - check initialization");
+  } else if (settings.enableKdtree) {
+    Logger::info("KD-tree covers part of the palette only, using the exhaustive scan");
   } else {
     Logger::info("?? KD-tree disabled, using binary database search");
   }
 #endif
 
+  // Mapped palette: exhaustive scan straight over the flash-resident LAB/RGB columns
+  if (mappedPalette.isMapped()) {
+    float distance = 0.0f;
+#if ENABLE_PARALLEL_SCAN
+    uint32_t const BEST =
+        parallelScan.findClosest(mappedPalette.getView(), red, green, blue, &distance);
+#else
+    uint32_t const BEST = mappedPalette.getView().findClosest(red, green, blue, &distance);
+#endif
+    if (PALETTE.describe(BEST, result)) {
+      cacheResult(BEST, distance);
+      searchMethod = "Mapped Palette";
+      char resultMsg[128];
+      sprintf(resultMsg, "? Mapped palette match: %s (dE %.2f) for RGB(%d,%d,%d)", result.c_str(),
+              distance, red, green, blue);
+      Logger::info(resultMsg);
+
+      if (settings.debugColorMatching) {
+        unsigned long const SEARCH_TIME = micros() - SEARCH_START_TIME;
+        Logger::debug("Mapped palette search completed in " + String(SEARCH_TIME) +
+                      "us. Best match: " + result);
+      }
+      return result;
+    }
+  }
+
+  // PSRAM arena: exhaustive scan over the in-memory record table, no file I/O
+  if (arenaPalette.isLoaded()) {
+    float distance = 0.0f;
+#if ENABLE_PARALLEL_SCAN
+    uint32_t const BEST = parallelScan.findClosest(arenaPalette, red, green, blue, &distance);
+#else
+    uint32_t const BEST = arenaPalette.findClosest(red, green, blue, &distance);
+#endif
+    if (PALETTE.describe(BEST, result)) {
+      cacheResult(BEST, distance);
+      searchMethod = "PSRAM Palette";
+      char resultMsg[128];
+      sprintf(resultMsg, "? PSRAM palette match: %s (dE %.2f) for RGB(%d,%d,%d)", result.c_str(),
+              distance, red, green, blue);
+      Logger::info(resultMsg);
+
+      if (settings.debugColorMatching) {
+        unsigned long const SEARCH_TIME = micros() - SEARCH_START_TIME;
+        Logger::debug("PSRAM palette search completed in " + String(SEARCH_TIME) +
+                      "us. Best match: " + result);
+      }
+      return result;
+    }
+  }
+
   // Fallback to simple binary database with optimized search (O(n) but optimized)
   Logger::info("?? Starting binary database search for RGB(" + String(red) + "," + String(green) + "," + String(blue) + ")");
   SimpleColor closestColor{};
@@ -1290,6 +1937,50 @@ static String findClosestDuluxColor(uint8_t red, uint8_t green, uint8_t blue) {
   return result;
 }
 
+// Name a live reading with the answer findClosestDuluxColor() gives, without its per-call
+// logging. Exact lookup table cells answer directly. Otherwise the KD-tree answer, from the
+// previous reading's candidates while they are provably still nearest, seeds the exact scan
+// (or is the answer when there is none, as in the full path); the rest takes the full path.
+static String findLiveColorName(uint8_t red, uint8_t green, uint8_t blue) {
+#if ENABLE_KDTREE
+  // The shortcuts below index the boot palette; a hot-swapped one takes the full path
+  PaletteScope const PALETTE;
+  bool const HOTSWAP_LIVE = PALETTE.live() != nullptr;
+  String result;
+#if ENABLE_PALETTE_LUT
+  uint32_t lutIndex = 0;
+  bool const LUT_EXACT = !HOTSWAP_LIVE && paletteLut.lookup(red, green, blue, lutIndex);
+  if (LUT_EXACT && PALETTE.describe(lutIndex, result)) {
+    return result;
+  }
+#else
+  bool const LUT_EXACT = false;
+#endif
+#if ENABLE_EXACT_SCAN
+  bool const REFINED = exactScan.isBuilt();
+#else
+  bool const REFINED = false;
+#endif
+  // Unrefined, the tree's answer stands, which a tree short of the palette cannot give
+  if (!HOTSWAP_LIVE && !LUT_EXACT && settings.enableKdtree && kdTreeColorDB.isBuilt() &&
+      (REFINED || kdtreeCoversPalette())) {
+    ColorPoint closest;
+    if (liveMatcher.match(kdTreeColorDB, red, green, blue, closest)) {
+      uint32_t best = closest.getIndex();
+#if ENABLE_EXACT_SCAN
+      if (REFINED) {
+        best = exactScan.findClosest(red, green, blue, nullptr, nullptr, best);
+      }
+#endif
+      if (PALETTE.describe(best, result)) {
+        return result;
+      }
+    }
+  }
+#endif
+  return findClosestDuluxColor(red, green, blue);
+}
+
 // Performance monitoring and optimization analysis
 static void analyzeSystemPerformance() {
   Logger::info("=== SYSTEM PERFORMANCE ANALYSIS ===");
@@ -1314,21 +2005,41 @@ static void analyzeSystemPerformance() {
 
   // Color database analysis
   Logger::info("?? Color Database Performance:");
-  size_t const COLOR_COUNT = simpleColorDB.isOpen() ? simpleColorDB.getColorCount() : 0;
+  PaletteScope const PALETTE;
+  size_t const COLOR_COUNT = PALETTE.colorCount();
   Logger::info("  Colors loaded: " + String(COLOR_COUNT));
 
   // Search method analysis
   String activeMethod = "Basic Classification";
   String performanceNote = "Minimal functionality";
 
+  if (const DuluxLivePalette *const LIVE = PALETTE.live()) {
+    activeMethod = "Hot-swapped Palette (generation " + String(LIVE->getGeneration()) + ")";
+    performanceNote = LIVE->isExactIndexed()
+                          ? String("Exact scan, bound-pruned")
+                          : "O(" + String(COLOR_COUNT) + ") in-memory scan";
+  } else
+#if ENABLE_EXACT_SCAN
+  if (exactScan.isBuilt()) {
+    activeMethod = "Exact Scan";
+    performanceNote = "L* window over " + String(COLOR_COUNT) + " colors, bound-pruned";
+  } else
+#endif
 #if ENABLE_KDTREE
-  if (settings.enableKdtree && kdTreeColorDB.isBuilt()) {
-    activeMethod = "KD-Tree Search";
+  if (settings.enableKdtree && kdtreeCoversPalette()) {
+    activeMethod = "KD-Tree Search (approximate)";
     float logN = static_cast<float>(log2(COLOR_COUNT));
     performanceNote = "O(log " + String(COLOR_COUNT) + ") � " + String(logN, 1) + " operations";
   } else
 #endif
-      if (simpleColorDB.isOpen()) {
+      if (mappedPalette.isMapped()) {
+    activeMethod = "Mapped Palette Search";
+    performanceNote = "O(" + String(COLOR_COUNT) + ") zero-copy flash scan";
+  } else if (arenaPalette.isLoaded()) {
+    activeMethod = "PSRAM Palette Search";
+    performanceNote = "O(" + String(COLOR_COUNT) + ") in-memory scan, " +
+                      String(arenaPalette.getStats().block_bytes / BYTES_PER_KB) + " KB PSRAM";
+  } else if (simpleColorDB.isOpen()) {
     activeMethod = "Binary Database Search";
     performanceNote = "O(" + String(COLOR_COUNT) + ") optimized operations";
   } else {
@@ -1705,6 +2416,30 @@ static void handleColorNameAPI(AsyncWebServerRequest *request) {
   doc["colorNameBasedOnR"] = colorLookup.lastR;
   doc["colorNameBasedOnG"] = colorLookup.lastG;
   doc["colorNameBasedOnB"] = colorLookup.lastB;
+#if ENABLE_KDTREE
+  const DuluxLiveMatcherStats &LIVE_STATS = liveMatcher.getStats();
+  doc["liveSearches"] = LIVE_STATS.searches;
+  doc["liveUnchanged"] = LIVE_STATS.unchanged;
+  doc["liveReused"] = LIVE_STATS.reused;
+  doc["liveWalked"] = LIVE_STATS.walked;
+  doc["liveVisited"] = LIVE_STATS.visited;
+  doc["liveSwitched"] = LIVE_STATS.switched;
+#endif
+#if ENABLE_MATCH_CACHE
+  DuluxMatchCacheStats const CACHE_STATS = matchCache.getStats();
+  doc["cacheHits"] = CACHE_STATS.hits;
+  doc["cacheMisses"] = CACHE_STATS.misses;
+  doc["cacheEvictions"] = CACHE_STATS.evictions;
+  doc["cacheBusy"] = CACHE_STATS.busy;
+  doc["cacheCapacity"] = DuluxMatchCache::getCapacity();
+#endif
+#if ENABLE_PARALLEL_SCAN
+  DuluxParallelScanStats const SCAN_STATS = parallelScan.getStats();
+  doc["scanShards"] = parallelScan.getShardCount();
+  doc["scanParallel"] = SCAN_STATS.parallel;
+  doc["scanSerial"] = SCAN_STATS.serial;
+  doc["scanBusy"] = SCAN_STATS.busy;
+#endif
 
   String response;  // Removed const - ArduinoJson needs to write to it
   serializeJson(doc, response);
@@ -1776,6 +2511,717 @@ static void handleForceColorLookup(AsyncWebServerRequest *request) {
                " | Duration: " + String(LOOKUP_DURATION) + "�s");
 }
 
+#if ENABLE_KDTREE || ENABLE_PALETTE_CATALOG
+// Attribute filter of the KD-tree and catalog endpoints: ?lrvMin= and ?lrvMax= (LRV 0-100,
+// inclusive) and ?lightText=true|false; none of them means every color qualifies
+static KDTreeFilter searchFilterFrom(AsyncWebServerRequest *request) {
+  KDTreeFilter filter;
+  if (request->hasParam("lrvMin")) {
+    float const LRV =
+        constrain(request->getParam("lrvMin")->value().toFloat(), 0.0f, SEARCH_LRV_MAX);
+    filter.lrv_min = (uint16_t)lroundf(LRV * SEARCH_LRV_SCALE);
+  }
+  if (request->hasParam("lrvMax")) {
+    float const LRV =
+        constrain(request->getParam("lrvMax")->value().toFloat(), 0.0f, SEARCH_LRV_MAX);
+    filter.lrv_max = (uint16_t)lroundf(LRV * SEARCH_LRV_SCALE);
+  }
+  if (request->hasParam("lightText")) {
+    String const VALUE = request->getParam("lightText")->value();
+    filter.flags_mask = DULUX_FLAG_LIGHT_TEXT;
+    filter.flags_value = VALUE == "true" || VALUE == "1" ? DULUX_FLAG_LIGHT_TEXT : 0;
+  }
+  return filter;
+}
+
+// Echo an active filter back in LRV units
+static void addSearchFilter(JsonDocument &doc, const KDTreeFilter &filter) {
+  if (!filter.isActive()) {
+    return;
+  }
+  doc["filter"]["lrvMin"] = filter.lrv_min / SEARCH_LRV_SCALE;
+  doc["filter"]["lrvMax"] = filter.lrv_max / SEARCH_LRV_SCALE;
+  if (filter.flags_mask & DULUX_FLAG_LIGHT_TEXT) {
+    doc["filter"]["lightText"] = (filter.flags_value & DULUX_FLAG_LIGHT_TEXT) != 0;
+  }
+}
+#endif
+
+#if ENABLE_KDTREE
+// Handle top-k match API: /api/color-matches?r=..&g=..&b=..[&k=5]
+// Accuracy/latency knobs of the KD-tree endpoints: ?epsilon= (relative radius slack) and
+// ?budget= (points examined per query); both absent means the exact search
+static KDTreeSearchOptions searchOptionsFrom(AsyncWebServerRequest *request) {
+  KDTreeSearchOptions options;
+  if (request->hasParam("epsilon")) {
+    options.epsilon =
+        constrain(request->getParam("epsilon")->value().toFloat(), 0.0f, SEARCH_MAX_EPSILON);
+  }
+  if (request->hasParam("budget")) {
+    options.max_visits =
+        (uint32_t)constrain(request->getParam("budget")->value().toInt(), 0L, SEARCH_MAX_BUDGET);
+  }
+  options.filter = searchFilterFrom(request);
+  return options;
+}
+
+// Requested and achieved accuracy; an unbounded result (budget ran out first) is null
+static void addSearchReport(JsonDocument &doc, const KDTreeSearchOptions &options,
+                            const KDTreeSearchReport &report) {
+  doc["epsilon"] = options.epsilon;
+  doc["budget"] = options.max_visits;
+  addSearchFilter(doc, options.filter);
+  doc["visited"] = report.visited;
+  doc["budgetExhausted"] = report.budget_exhausted;
+  if (std::isinf(report.achieved_epsilon)) {
+    doc["achievedEpsilon"] = nullptr;
+  } else {
+    doc["achievedEpsilon"] = report.achieved_epsilon;
+  }
+}
+
+static void handleColorMatches(AsyncWebServerRequest *request) {
+  PaletteScope const PALETTE;
+  const LightweightKDTree *const TREE = PALETTE.tree();
+  if (TREE == nullptr) {
+    request->send(HTTP_NOT_FOUND, "application/json",
+                  "{\"error\":\"KD-tree not built for the whole palette\"}");
+    return;
+  }
+  if (!request->hasParam("r") || !request->hasParam("g") || !request->hasParam("b")) {
+    request->send(HTTP_BAD_REQUEST, "application/json", "{\"error\":\"Missing r, g or b\"}");
+    return;
+  }
+  uint8_t const RED = (uint8_t)constrain(request->getParam("r")->value().toInt(), 0, 255);
+  uint8_t const GREEN = (uint8_t)constrain(request->getParam("g")->value().toInt(), 0, 255);
+  uint8_t const BLUE = (uint8_t)constrain(request->getParam("b")->value().toInt(), 0, 255);
+  size_t const K =
+      request->hasParam("k")
+          ? (size_t)constrain(request->getParam("k")->value().toInt(), 1, KDTREE_MAX_MATCHES)
+          : 5;
+
+  KDTreeSearchOptions const OPTIONS = searchOptionsFrom(request);
+  if (OPTIONS.filter.isActive() && !TREE->hasAttributes()) {
+    request->send(HTTP_SERVICE_UNAVAILABLE, "application/json",
+                  "{\"error\":\"KD-tree has no attributes for filtering\"}");
+    return;
+  }
+
+  // One traversal returns all k; the gap between the first two is the match's confidence margin
+  unsigned long const SEARCH_START = micros();
+  std::array<KDTreeMatch, KDTREE_MAX_MATCHES> matches;
+  KDTreeSearchReport report{};
+  size_t const COUNT =
+      TREE->findKNearest(RED, GREEN, BLUE, K, KDTREE_ALL_BRANDS, matches.data(), OPTIONS, &report);
+  unsigned long const SEARCH_DURATION = micros() - SEARCH_START;
+
+  JsonDocument doc;
+  JsonArray results = doc["matches"].to<JsonArray>();
+  for (size_t i = 0; i < COUNT; i++) {
+    char name[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    char code[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    uint16_t const INDEX = matches[i].point.getIndex();
+    if (!PALETTE.copyStrings(INDEX, name, sizeof(name), code, sizeof(code))) {
+      continue;
+    }
+    JsonObject match = results.add<JsonObject>();
+    match["name"] = name;
+    match["code"] = code;
+    match["index"] = INDEX;
+    match["rgb"]["r"] = matches[i].point.getRed();
+    match["rgb"]["g"] = matches[i].point.getGreen();
+    match["rgb"]["b"] = matches[i].point.getBlue();
+    match["deltaE"] = matches[i].distance;
+  }
+  if (COUNT >= 2) {
+    doc["margin"] = matches[1].distance - matches[0].distance;
+  }
+  addSearchReport(doc, OPTIONS, report);
+  doc["searchDuration"] = SEARCH_DURATION;
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+
+// Collect the JSON body of a batch match; handleColorMatchBatch runs once it is complete
+static void handleColorMatchBatchBody(AsyncWebServerRequest *request, uint8_t *data, size_t len,
+                                      size_t index, size_t total) {
+  if (index == 0 && total <= BATCH_MATCH_MAX_BODY) {
+    request->_tempObject = malloc(total + 1);  // Freed with the request
+  }
+  auto *body = static_cast<char *>(request->_tempObject);
+  if (body != nullptr && index + len <= total) {
+    memcpy(body + index, data, len);
+    body[index + len] = '\0';
+  }
+}
+
+#if ENABLE_EXACT_SCAN
+// Replace tree answers with the exact scan's, each seeded with the tree's own answer
+static void refineBatchMatches(const DuluxExactScan &scan, const KDTreeQuery *queries,
+                               KDTreeMatch *matches, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (std::isinf(matches[i].distance)) {
+      continue;
+    }
+    const KDTreeQuery &query = queries[i];
+    float distance = 0.0f;
+    uint32_t const BEST = scan.findClosest(query.lab, query.r, query.g, query.b, &distance,
+                                           nullptr, matches[i].point.getIndex());
+    if (BEST != matches[i].point.getIndex()) {
+      matches[i].point = ColorPoint();
+      matches[i].point.index = (uint16_t)BEST;
+    }
+    matches[i].distance = distance;
+  }
+}
+#endif
+
+// Handle batch match API: POST /api/color-match-batch with {"rgb":[[r,g,b],...]} or
+// {"lab":[[L,a,b],...]}; results come back in input order
+// One batch entry: three numbers, in the ranges the fixed-point palette L*a*b*, the exact scan's
+// bounds and the match cache keys are built for
+static bool isValidBatchColor(JsonArrayConst color, bool is_lab) {
+  if (color.size() != 3) {
+    return false;
+  }
+  for (size_t axis = 0; axis < 3; axis++) {
+    JsonVariantConst const VALUE = color[axis];
+    if (!is_lab) {
+      if (!VALUE.is<int>() || VALUE.as<int>() < 0 || VALUE.as<int>() > RGB_MAX_INT) {
+        return false;
+      }
+      continue;
+    }
+    if (!VALUE.is<float>()) {
+      return false;
+    }
+    float const COMPONENT = VALUE.as<float>();
+    float const LOW = axis == 0 ? 0.0f : -128.0f;
+    float const HIGH = axis == 0 ? 100.0f : 127.0f;
+    if (!(COMPONENT >= LOW && COMPONENT <= HIGH)) {  // Also rejects NaN
+      return false;
+    }
+  }
+  return true;
+}
+
+static void handleColorMatchBatch(AsyncWebServerRequest *request) {
+  PaletteScope const PALETTE;
+  const LightweightKDTree *const TREE = PALETTE.tree();
+  if (TREE == nullptr) {
+    request->send(HTTP_NOT_FOUND, "application/json",
+                  "{\"error\":\"KD-tree not built for the whole palette\"}");
+    return;
+  }
+  const auto *body = static_cast<const char *>(request->_tempObject);
+  if (body == nullptr) {
+    request->send(HTTP_PAYLOAD_TOO_LARGE, "application/json",
+                  "{\"error\":\"Missing body or larger than " + String(BATCH_MATCH_MAX_BODY) +
+                      " bytes\"}");
+    return;
+  }
+  JsonDocument input;
+  if (deserializeJson(input, body) != DeserializationError::Ok) {
+    request->send(HTTP_BAD_REQUEST, "application/json", "{\"error\":\"Invalid JSON\"}");
+    return;
+  }
+  bool const IS_LAB = input["lab"].is<JsonArrayConst>();
+  JsonArrayConst const COLORS =
+      IS_LAB ? input["lab"].as<JsonArrayConst>() : input["rgb"].as<JsonArrayConst>();
+  if (COLORS.isNull() || COLORS.size() == 0 || COLORS.size() > KDTREE_MAX_BATCH) {
+    request->send(HTTP_BAD_REQUEST, "application/json",
+                  "{\"error\":\"Expected an rgb or lab array of 1-" +
+                      String(KDTREE_MAX_BATCH) + " colors\"}");
+    return;
+  }
+
+  size_t const COUNT = COLORS.size();
+  std::vector<KDTreeQuery, PSRAMAllocator<KDTreeQuery>> queries(COUNT);
+  std::vector<KDTreeMatch, PSRAMAllocator<KDTreeMatch>> matches(COUNT);
+  for (size_t i = 0; i < COUNT; i++) {
+    JsonArrayConst const COLOR = COLORS[i];
+    if (!isValidBatchColor(COLOR, IS_LAB)) {
+      request->send(HTTP_BAD_REQUEST, "application/json",
+                    "{\"error\":\"Color " + String(i) +
+                        (IS_LAB ? " is not [L,a,b] with L 0-100, a and b -128-127\"}"
+                                : " is not [r,g,b] with integers 0-255\"}"));
+      return;
+    }
+    KDTreeQuery &query = queries[i];
+    if (IS_LAB) {
+      query.lab = {COLOR[0].as<double>(), COLOR[1].as<double>(), COLOR[2].as<double>()};
+      labToRGB(query.lab, query.r, query.g, query.b);
+    } else {
+      query.r = COLOR[0].as<uint8_t>();
+      query.g = COLOR[1].as<uint8_t>();
+      query.b = COLOR[2].as<uint8_t>();
+      rgbToLAB(query.r, query.g, query.b, query.lab);
+    }
+  }
+
+  KDTreeSearchOptions const OPTIONS = searchOptionsFrom(request);
+  if (OPTIONS.filter.isActive() && !TREE->hasAttributes()) {
+    request->send(HTTP_SERVICE_UNAVAILABLE, "application/json",
+                  "{\"error\":\"KD-tree has no attributes for filtering\"}");
+    return;
+  }
+  // Unfiltered, unbounded requests get the answers /api/color-name gives: the tree's, then
+  // the exact scan's seeded with them where there is one
+  bool const EXACT = !OPTIONS.filter.isActive() && OPTIONS.epsilon == 0.0f &&
+                     OPTIONS.max_visits == KDTREE_NO_BUDGET;
+#if ENABLE_EXACT_SCAN
+  const DuluxExactScan *const EXACT_SCAN = EXACT ? PALETTE.exact() : nullptr;
+  bool const REFINED = EXACT_SCAN != nullptr;
+#else
+  bool const REFINED = false;
+#endif
+  KDTreeSearchReport report{};
+  unsigned long const SEARCH_START = micros();
+#if ENABLE_MATCH_CACHE
+  // Cached colors are answered here; only the rest go through the tree, compacted in place.
+  // The cache holds unfiltered answers, so filtered batches bypass it entirely.
+  bool const UNFILTERED = !OPTIONS.filter.isActive();
+  uint32_t const GENERATION = PALETTE.generation();
+  // Only answers a single lookup would also give are cached: refined ones, or tree ones where
+  // the boot palette's tree is what single lookups use
+  bool const CACHEABLE = REFINED || (EXACT && !PALETTE.live());
+  std::vector<uint64_t, PSRAMAllocator<uint64_t>> keys(COUNT);
+  std::vector<uint16_t, PSRAMAllocator<uint16_t>> pending(COUNT);  // Input position per miss
+  size_t misses = 0;
+  size_t cached = 0;
+  for (size_t i = 0; i < COUNT; i++) {
+    const KDTreeQuery &query = queries[i];
+    keys[i] = DuluxMatchCache::keyFor(query.lab, query.r, query.g, query.b, GENERATION);
+    uint32_t index = 0;
+    float distance = 0.0f;
+    if (UNFILTERED && matchCache.lookup(keys[i], index, distance)) {
+      matches[i] = {ColorPoint(), distance};
+      matches[i].point.index = (uint16_t)index;
+      cached++;
+    } else {
+      pending[misses] = (uint16_t)i;
+      queries[misses++] = query;
+    }
+  }
+  std::vector<KDTreeMatch, PSRAMAllocator<KDTreeMatch>> found(misses);
+  size_t const MATCHED =
+      cached + TREE->findNearestBatch(queries.data(), misses, KDTREE_ALL_BRANDS, found.data(),
+                                      OPTIONS, &report);
+#if ENABLE_EXACT_SCAN
+  if (EXACT_SCAN) {
+    refineBatchMatches(*EXACT_SCAN, queries.data(), found.data(), misses);
+  }
+#endif
+  // Approximate answers are served but never cached for other callers
+  for (size_t i = 0; i < misses; i++) {
+    matches[pending[i]] = found[i];
+    if (CACHEABLE && !std::isinf(found[i].distance)) {
+      matchCache.insert(keys[pending[i]], found[i].point.getIndex(), found[i].distance);
+    }
+  }
+#else
+  size_t const MATCHED = TREE->findNearestBatch(queries.data(), COUNT, KDTREE_ALL_BRANDS,
+                                                matches.data(), OPTIONS, &report);
+#if ENABLE_EXACT_SCAN
+  if (EXACT_SCAN) {
+    refineBatchMatches(*EXACT_SCAN, queries.data(), matches.data(), COUNT);
+  }
+#endif
+#endif
+  unsigned long const SEARCH_DURATION = micros() - SEARCH_START;
+
+  JsonDocument doc;
+  JsonArray results = doc["matches"].to<JsonArray>();
+  for (size_t i = 0; i < COUNT; i++) {
+    JsonObject match = results.add<JsonObject>();
+    char name[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    char code[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    uint16_t const INDEX = matches[i].point.getIndex();
+    if (std::isinf(matches[i].distance) ||
+        !PALETTE.copyStrings(INDEX, name, sizeof(name), code, sizeof(code))) {
+      continue;  // Empty object keeps the positions aligned with the input
+    }
+    match["name"] = name;
+    match["code"] = code;
+    match["index"] = INDEX;
+    match["deltaE"] = matches[i].distance;
+  }
+  doc["count"] = COUNT;
+  doc["matched"] = MATCHED;
+#if ENABLE_MATCH_CACHE
+  doc["cached"] = cached;
+#endif
+  doc["refined"] = REFINED;
+  addSearchReport(doc, OPTIONS, report);
+  doc["searchDuration"] = SEARCH_DURATION;
+  doc["perColorMicros"] = (float)SEARCH_DURATION / (float)COUNT;
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+#endif
+
+#if ENABLE_EXACT_SCAN
+// Handle exact match audit API: /api/color-match-exact?r=..&g=..&b=.. (true optimum, no time budget)
+static void handleExactColorMatch(AsyncWebServerRequest *request) {
+  PaletteScope const PALETTE;
+  const DuluxExactScan *const EXACT_SCAN = PALETTE.exact();
+  if (!EXACT_SCAN) {
+    request->send(HTTP_NOT_FOUND, "application/json", "{\"error\":\"Exact scan not built\"}");
+    return;
+  }
+  if (!request->hasParam("r") || !request->hasParam("g") || !request->hasParam("b")) {
+    request->send(HTTP_BAD_REQUEST, "application/json", "{\"error\":\"Missing r, g or b\"}");
+    return;
+  }
+  uint8_t const RED = (uint8_t)constrain(request->getParam("r")->value().toInt(), 0, 255);
+  uint8_t const GREEN = (uint8_t)constrain(request->getParam("g")->value().toInt(), 0, 255);
+  uint8_t const BLUE = (uint8_t)constrain(request->getParam("b")->value().toInt(), 0, 255);
+
+  unsigned long const SEARCH_START = micros();
+  float distance = 0.0f;
+  DuluxExactScanStats stats{};
+  uint32_t const BEST = EXACT_SCAN->findClosest(RED, GREEN, BLUE, &distance, &stats);
+  unsigned long const SEARCH_DURATION = micros() - SEARCH_START;
+
+  char name[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+  char code[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+  uint8_t red = 0;
+  uint8_t green = 0;
+  uint8_t blue = 0;
+  if (!PALETTE.copyStrings(BEST, name, sizeof(name), code, sizeof(code)) ||
+      !PALETTE.readRGB(BEST, red, green, blue)) {
+    request->send(HTTP_NOT_FOUND, "application/json", "{\"error\":\"No match\"}");
+    return;
+  }
+
+  JsonDocument doc;
+  doc["name"] = name;
+  doc["code"] = code;
+  doc["index"] = BEST;
+  doc["rgb"]["r"] = red;
+  doc["rgb"]["g"] = green;
+  doc["rgb"]["b"] = blue;
+  doc["deltaE"] = distance;
+  doc["evaluated"] = stats.evaluated;
+  doc["window"] = stats.window;
+  doc["paletteSize"] = EXACT_SCAN->getColorCount();
+  doc["searchDuration"] = SEARCH_DURATION;
+#if ENABLE_KDTREE
+  // Audit the fast path against the exact answer
+  ColorPoint closest;
+  const LightweightKDTree *const TREE = PALETTE.tree();
+  if (TREE && TREE->findNearest(RED, GREEN, BLUE, KDTREE_ALL_BRANDS, closest)) {
+    doc["kdtreeIndex"] = closest.getIndex();
+    doc["kdtreeAgrees"] = closest.getIndex() == BEST;
+  }
+#endif
+#if ENABLE_PALETTE_LUT
+  // The LUT maps into the boot palette only
+  if (!PALETTE.live() && paletteLut.isLoaded()) {
+    uint32_t lutIndex = 0;
+    bool const LUT_EXACT = paletteLut.lookup(RED, GREEN, BLUE, lutIndex);
+    doc["lutIndex"] = lutIndex;
+    doc["lutExact"] = LUT_EXACT;
+    doc["lutAgrees"] = !LUT_EXACT || lutIndex == BEST;
+  }
+#endif
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+#endif
+
+#if ENABLE_PALETTE_HOTSWAP
+static const char *hotSwapStateName(DuluxHotSwapState state) {
+  switch (state) {
+    case DuluxHotSwapState::BUILDING:
+      return "building";
+    case DuluxHotSwapState::PUBLISHED:
+      return "published";
+    case DuluxHotSwapState::FAILED:
+      return "failed";
+    default:
+      return "idle";
+  }
+}
+
+// Handle palette reload: /api/palette-reload?file=/new.bin loads and indexes in the background
+static void handlePaletteReload(AsyncWebServerRequest *request) {
+  String const FILE_PATH =
+      request->hasParam("file") ? request->getParam("file")->value() : String("/dulux.bin");
+  if (!FILE_PATH.startsWith("/") || !LittleFS.exists(FILE_PATH)) {
+    request->send(HTTP_NOT_FOUND, "application/json", "{\"error\":\"Palette file not found\"}");
+    return;
+  }
+  if (!paletteHotSwap.requestReload(FILE_PATH.c_str(), ENABLE_KDTREE && settings.enableKdtree,
+                                    ENABLE_EXACT_SCAN)) {
+    request->send(HTTP_TOO_MANY_REQUESTS, "application/json",
+                  "{\"error\":\"Palette reload already in progress\"}");
+    return;
+  }
+  Logger::info("Palette reload started for " + FILE_PATH + " - current palette keeps serving");
+  request->send(HTTP_ACCEPTED, "application/json", "{\"state\":\"building\"}");
+}
+
+// Handle palette reload status: state of the last reload and the live generation
+static void handlePaletteReloadStatus(AsyncWebServerRequest *request) {
+  JsonDocument doc;
+  doc["state"] = hotSwapStateName(paletteHotSwap.getState());
+  doc["file"] = paletteHotSwap.getPendingPath();
+  doc["generation"] = paletteHotSwap.getGeneration();
+  doc["buildMs"] = paletteHotSwap.getLastBuildMs();
+  if (std::shared_ptr<const DuluxLivePalette> const LIVE = paletteHotSwap.acquire()) {
+    doc["colors"] = LIVE->getPalette().getColorCount();
+    doc["crc"] = LIVE->getPalette().getPaletteCrc();
+    doc["kdtree"] = LIVE->isTreeIndexed();
+    doc["exactScan"] = LIVE->isExactIndexed();
+  }
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+
+// Free the boot palette and its indexes once a hot-swapped palette has replaced them. Called
+// from loop(); runs once, at a moment no palette scope is open. Scopes opened later get the
+// hot-swapped palette, since a publication is never undone.
+static void releaseSupersededBootPalette() {
+  static bool released = false;
+  if (released || !paletteHotSwap.acquire() || paletteReaders.load() != 0) {
+    return;
+  }
+  released = true;
+  size_t const FREE_BEFORE = ESP.getFreePsram();
+#if ENABLE_KDTREE
+  liveMatcher.reset();
+  kdTreeColorDB.release();
+#endif
+#if ENABLE_EXACT_SCAN
+  exactScan.release();
+#endif
+#if ENABLE_PALETTE_LUT
+  paletteLut.release();
+#endif
+  mappedPalette.unmap();
+  arenaPalette.release();
+  simpleColorDB.close();
+  Logger::info("Boot palette released after hot swap - " +
+               String((ESP.getFreePsram() - FREE_BEFORE) / BYTES_PER_KB) + " KB PSRAM freed");
+}
+#endif
+
+#if ENABLE_PALETTE_UPLOAD
+// Upload targets are palette files in the LittleFS root: "/name.bin", never a file the firmware
+// keeps for itself (snapshot, lookup table, catalog manifest, web UI), whatever its extension
+static bool isUploadablePalettePath(const String &path) {
+  static const char *const RESERVED[] = {KDTREE_SNAPSHOT_PATH, PALETTE_LUT_PATH,
+                                         PALETTE_CATALOG_MANIFEST, "/index.html", "/index.css",
+                                         "/index.js"};
+  if (!path.startsWith("/") || !path.endsWith(".bin") || path.length() <= strlen("/.bin") ||
+      path.indexOf('/', 1) >= 0 || path.indexOf("..") >= 0) {
+    return false;
+  }
+  for (const char *reserved : RESERVED) {
+    if (path.equalsIgnoreCase(reserved)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Upload body callback: each chunk is written to LittleFS and parsed before the next arrives,
+// so RAM use is one chunk regardless of palette size
+static void handlePaletteUploadChunk(AsyncWebServerRequest *request, const String &filename,
+                                     size_t index, uint8_t *data, size_t len, bool final) {
+  if (index == 0) {
+    if (paletteUploadOwner != nullptr) {
+      return;  // Another upload is streaming; this request is answered with 429
+    }
+    String const TARGET =
+        request->hasParam("file") ? request->getParam("file")->value() : String("/palette_upload.bin");
+    if (!isUploadablePalettePath(TARGET)) {
+      Logger::warn("Palette upload rejected: " + TARGET + " is not a palette file name");
+      return;
+    }
+    if (simpleColorDB.isOpen() && TARGET == "/dulux.bin") {
+      Logger::warn("Palette upload rejected: /dulux.bin is open by the streaming reader");
+      return;
+    }
+    size_t const FREE_BYTES = LittleFS.totalBytes() - LittleFS.usedBytes();
+    if (request->contentLength() > FREE_BYTES) {
+      Logger::warn("Palette upload rejected: " + String(request->contentLength()) +
+                   " bytes but only " + String(FREE_BYTES) + " free");
+      return;
+    }
+    if (!paletteUpload.begin(TARGET.c_str())) {
+      Logger::warn("Palette upload rejected: " + String(paletteUpload.getError()));
+      return;
+    }
+    paletteUploadOwner = request;
+    paletteUploadAccepted = false;
+    Logger::info("Streaming palette upload " + filename + " -> " + TARGET);
+    request->onDisconnect([request]() {
+      if (paletteUploadOwner == request) {
+        paletteUpload.abort();
+        paletteUploadOwner = nullptr;
+      }
+    });
+  }
+
+  if (paletteUploadOwner != request) {
+    return;
+  }
+  paletteUpload.write(data, len);
+  if (final) {
+    paletteUploadAccepted = paletteUpload.finish();
+  }
+}
+
+// Upload completion: report the result and optionally hot-swap the new palette in
+static void handlePaletteUploadDone(AsyncWebServerRequest *request) {
+  if (paletteUploadOwner != request) {
+    request->send(HTTP_TOO_MANY_REQUESTS, "application/json",
+                  "{\"error\":\"Upload rejected or another upload in progress\"}");
+    return;
+  }
+  paletteUploadOwner = nullptr;
+
+  JsonDocument doc;
+  doc["file"] = paletteUpload.getTarget();
+  doc["bytes"] = paletteUpload.getBytesReceived();
+  if (!paletteUploadAccepted) {
+    doc["error"] = paletteUpload.getError();
+    String response;
+    serializeJson(doc, response);
+    request->send(HTTP_BAD_REQUEST, "application/json", response);
+    return;
+  }
+  doc["colors"] = paletteUpload.getColorCount();
+  doc["crc"] = paletteUpload.getPaletteCrc();
+#if ENABLE_PALETTE_HOTSWAP
+  bool const ACTIVATE =
+      !request->hasParam("activate") || request->getParam("activate")->value() != "0";
+  doc["activating"] =
+      ACTIVATE && paletteHotSwap.requestReload(paletteUpload.getTarget(),
+                                               ENABLE_KDTREE && settings.enableKdtree,
+                                               ENABLE_EXACT_SCAN);
+#endif
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+#endif
+
+#if ENABLE_PALETTE_CATALOG
+// Handle catalog match API: /api/catalog-match?r=..&g=..&b=..[&brand=Dulux,Resene|all]
+static void handleCatalogMatch(AsyncWebServerRequest *request) {
+  if (!paletteCatalog.isIndexed()) {
+    request->send(HTTP_NOT_FOUND, "application/json", "{\"error\":\"Palette catalog not loaded\"}");
+    return;
+  }
+  if (!request->hasParam("r") || !request->hasParam("g") || !request->hasParam("b")) {
+    request->send(HTTP_BAD_REQUEST, "application/json", "{\"error\":\"Missing r, g or b\"}");
+    return;
+  }
+  uint8_t const RED = (uint8_t)constrain(request->getParam("r")->value().toInt(), 0, 255);
+  uint8_t const GREEN = (uint8_t)constrain(request->getParam("g")->value().toInt(), 0, 255);
+  uint8_t const BLUE = (uint8_t)constrain(request->getParam("b")->value().toInt(), 0, 255);
+  String const BRANDS = request->hasParam("brand") ? request->getParam("brand")->value() : "";
+  uint32_t const MASK = parseCatalogBrandMask(BRANDS);
+  if (MASK == 0) {
+    request->send(HTTP_BAD_REQUEST, "application/json", "{\"error\":\"Unknown brand\"}");
+    return;
+  }
+  KDTreeSearchOptions options;
+  options.filter = searchFilterFrom(request);
+  if (options.filter.isActive() && !paletteCatalog.hasFilters()) {
+    request->send(HTTP_SERVICE_UNAVAILABLE, "application/json",
+                  "{\"error\":\"Catalog index has no attributes for filtering\"}");
+    return;
+  }
+
+  unsigned long const SEARCH_START = micros();
+  DuluxCatalogMatch match{};
+  bool const FOUND = paletteCatalog.findNearest(RED, GREEN, BLUE, MASK, match, options);
+  unsigned long const SEARCH_DURATION = micros() - SEARCH_START;
+
+  char name[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+  char code[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+  if (!FOUND || !paletteCatalog.describe(match, name, sizeof(name), code, sizeof(code))) {
+    request->send(HTTP_NOT_FOUND, "application/json", "{\"error\":\"No match\"}");
+    return;
+  }
+  const DuluxArenaRecord &record = paletteCatalog.palette(match.brand).record(match.index);
+
+  JsonDocument doc;
+  doc["brand"] = paletteCatalog.getBrandName(match.brand);
+  doc["name"] = name;
+  doc["code"] = code;
+  doc["index"] = match.index;
+  doc["rgb"]["r"] = record.r;
+  doc["rgb"]["g"] = record.g;
+  doc["rgb"]["b"] = record.b;
+  doc["distance"] = match.distance;
+  doc["lrv"] = record.lrv_scaled / SEARCH_LRV_SCALE;
+  addSearchFilter(doc, options.filter);
+  doc["searchDuration"] = SEARCH_DURATION;
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+
+// Handle palette catalog listing: mounted brands and their sizes
+static void handlePaletteCatalog(AsyncWebServerRequest *request) {
+  JsonDocument doc;
+  doc["indexed"] = paletteCatalog.isIndexed();
+  doc["totalColors"] = paletteCatalog.getTotalColors();
+  doc["indexBits"] = paletteCatalog.getIndexBits();
+  doc["indexKB"] = paletteCatalog.getIndexMemoryUsage() / BYTES_PER_KB;
+  const KDTreeBuildStats& BUILD_STATS = paletteCatalog.getIndexBuildStats();
+  doc["indexBuildUs"] = BUILD_STATS.arrange_us;
+  doc["indexPointsPerSecond"] = BUILD_STATS.points_per_second;
+  JsonArray palettes = doc["palettes"].to<JsonArray>();
+  for (uint8_t i = 0; i < paletteCatalog.getPaletteCount(); i++) {
+    JsonObject palette = palettes.add<JsonObject>();
+    palette["brand"] = paletteCatalog.getBrandName(i);
+    palette["colors"] = paletteCatalog.palette(i).getColorCount();
+    palette["crc"] = paletteCatalog.palette(i).getPaletteCrc();
+  }
+
+  String response;
+  serializeJson(doc, response);
+  AsyncWebServerResponse *apiResponse =
+      request->beginResponse(HTTP_OK, "application/json", response);
+  apiResponse->addHeader("Access-Control-Allow-Origin", "*");
+  request->send(apiResponse);
+}
+#endif
+
 // Handle color capture and storage API endpoint
 static void handleCaptureColor(AsyncWebServerRequest *request) {
   Logger::debug("Handling color capture request");
@@ -2959,6 +4405,11 @@ void setup() {
     Logger::error("Could not load color database - color matching may not work");
   }
 
+#if ENABLE_PALETTE_CATALOG
+  // Additional brands for cross-brand matching (independent of the primary palette)
+  loadPaletteCatalog();
+#endif
+
   // Connect to WiFi or start AP mode
   if (!connectToWiFiOrStartAP()) {
     Logger::error("Failed to establish network connectivity - system may not function properly");
@@ -3004,6 +4455,33 @@ void setup() {
   server.on("/api/force-color-lookup", HTTP_GET, handleForceColorLookup);
   Logger::debug("Route registered: /api/force-color-lookup -> handleForceColorLookup (immediate "
                 "color name lookup)");
+#if ENABLE_KDTREE
+  server.on("/api/color-matches", HTTP_GET, handleColorMatches);
+  Logger::debug("Route registered: /api/color-matches -> handleColorMatches (top-k matches)");
+  server.on("/api/color-match-batch", HTTP_POST, handleColorMatchBatch, nullptr,
+            handleColorMatchBatchBody);
+  Logger::debug("Route registered: /api/color-match-batch -> handleColorMatchBatch");
+#endif
+#if ENABLE_EXACT_SCAN
+  server.on("/api/color-match-exact", HTTP_GET, handleExactColorMatch);
+  Logger::debug("Route registered: /api/color-match-exact -> handleExactColorMatch (audit)");
+#endif
+#if ENABLE_PALETTE_HOTSWAP
+  server.on("/api/palette-reload", HTTP_POST, handlePaletteReload);
+  Logger::debug("Route registered: /api/palette-reload -> handlePaletteReload (background swap)");
+  server.on("/api/palette-status", HTTP_GET, handlePaletteReloadStatus);
+  Logger::debug("Route registered: /api/palette-status -> handlePaletteReloadStatus");
+#endif
+#if ENABLE_PALETTE_UPLOAD
+  server.on("/api/palette-upload", HTTP_POST, handlePaletteUploadDone, handlePaletteUploadChunk);
+  Logger::debug("Route registered: /api/palette-upload -> streaming palette upload");
+#endif
+#if ENABLE_PALETTE_CATALOG
+  server.on("/api/catalog-match", HTTP_GET, handleCatalogMatch);
+  Logger::debug("Route registered: /api/catalog-match -> handleCatalogMatch (multi-brand match)");
+  server.on("/api/palettes", HTTP_GET, handlePaletteCatalog);
+  Logger::debug("Route registered: /api/palettes -> handlePaletteCatalog");
+#endif
 
   server.on("/api/capture-color", HTTP_POST, handleCaptureColor);
   Logger::debug("Route registered: /api/capture-color -> handleCaptureColor (capture and store color)");
@@ -3736,6 +5214,9 @@ void loop() {
 
   // Handle all periodic checks (auto-gain, warnings, logging, etc.)
   handlePeriodicChecks(timers);
+#if ENABLE_PALETTE_HOTSWAP
+  releaseSupersededBootPalette();
+#endif
 
   // Read sensor data with dynamic auto-exposure (replaces settings lock approach)
   // Rate limit auto-exposure optimization to prevent excessive logging
@@ -3790,9 +5271,10 @@ void loop() {
   // Update the fast API data for the web server
   updateFastApiData(SENSOR_DATA, FINAL_COLOR);
 
-  // DISABLED: Automatic color name lookup to improve performance
-  // Color matching now only happens when user clicks "Capture Color" button
-  // handleColorNameLookup(finalColor);
+#if ENABLE_LIVE_NAMING
+  // Name every reading; consecutive readings are matched incrementally (DuluxLiveMatcher)
+  handleColorNameLookup(FINAL_COLOR);
+#endif
 
   // Log periodic status updates
   logPeriodicStatus(SENSOR_DATA, FINAL_COLOR, timers);
@@ -4776,7 +6258,7 @@ void handleColorNameLookup(const ColorRGB& color) {
       colorLookup.lastB = color.b;
 
       unsigned long const searchStart = micros();
-      String const colorName = findClosestDuluxColor(color.r, color.g, color.b);
+      String const colorName = findLiveColorName(color.r, color.g, color.b);
       unsigned long const searchTime = micros() - searchStart;
 
       // Thread-safe update of color name data
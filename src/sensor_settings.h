@@ -137,10 +137,28 @@
 // =============================================================================
 
 // Memory Management
-#define ENABLE_KDTREE 0               // 🌳 Enable KD-tree 1=ON, 0=OFF (default: 1) - TEMPORARILY DISABLED DUE TO BUG
-#define KDTREE_MAX_COLORS 4500        // 📊 Maximum colors in KD-tree (default: 4500)
+#define ENABLE_KDTREE 1               // 🌳 Enable L*a*b* KD-tree with CIEDE2000 re-ranking 1=ON, 0=OFF (default: 1)
+#define KDTREE_MAX_COLORS 8192        // 📊 Maximum colors in KD-tree; must cover the palette for exact results (default: 8192)
 #define PSRAM_SAFETY_MARGIN_KB 2048   // 💾 PSRAM to keep free in KB (default: 2048)
 #define KDTREE_LOAD_TIMEOUT_MS 20000  // ⏱️ KD-tree build timeout in ms (default: 20000)
+#define ENABLE_KDTREE_SNAPSHOT 1      // 💾 Save built KD-tree to LittleFS, reload on boot 1=ON, 0=OFF (default: 1)
+#define KDTREE_SNAPSHOT_PATH "/kdtree.snap"  // 💾 Snapshot file, keyed by palette CRC (default: "/kdtree.snap")
+#define ENABLE_EXACT_SCAN 1           // 🎯 L*-sorted, bound-pruned exact CIEDE2000 scan 1=ON, 0=OFF (default: 1)
+#define ENABLE_LIVE_NAMING 1          // 🏷️ Name every live reading in loop(), reusing the last KD-tree neighbourhood 1=ON, 0=OFF (default: 1)
+#define ENABLE_PALETTE_LUT 1          // ⚡ Precomputed nearest-paint table for quantized RGB 1=ON, 0=OFF (default: 1)
+#define PALETTE_LUT_PATH "/dulux.lut"  // ⚡ Table from palette_compiler --lut, keyed by palette CRC (default: "/dulux.lut")
+#define ENABLE_MATCH_CACHE 1          // 🗃️ Cache recent matches by quantized L*a*b* (0.25 steps) 1=ON, 0=OFF (default: 1)
+#define ENABLE_KDTREE_FILTERS 1       // 🔎 LRV and light-text summaries per KD-tree range for filtered matches 1=ON, 0=OFF (default: 1)
+#define ENABLE_PARALLEL_SCAN 1        // 🧵 Split exact and exhaustive palette scans across both cores 1=ON, 0=OFF (default: 1)
+
+// Palette Storage
+#define ENABLE_MAPPED_PALETTE 1            // 🗺️ Prefer zero-copy flash partition palette 1=ON, 0=OFF (default: 1)
+#define PALETTE_PARTITION_LABEL "palette"  // 🗺️ Partition holding the v2 palette image (default: "palette")
+#define ENABLE_PALETTE_ARENA 1             // 💾 Bulk-load dulux.bin into one PSRAM block 1=ON, 0=OFF (default: 1)
+#define ENABLE_PALETTE_HOTSWAP 1           // 🔄 Allow palette reload + background reindex without reboot 1=ON, 0=OFF (default: 1)
+#define ENABLE_PALETTE_UPLOAD 1            // 📤 Stream palette uploads over HTTP straight to LittleFS 1=ON, 0=OFF (default: 1)
+#define ENABLE_PALETTE_CATALOG 1           // 🎨 Mount extra brand palettes behind one index 1=ON, 0=OFF (default: 1)
+#define PALETTE_CATALOG_MANIFEST "/palettes.json"  // 🎨 Brand/file list for the catalog (default: "/palettes.json")
 
 // Search Performance
 #define KDTREE_SEARCH_TIMEOUT_MS 50    // 🔍 KD-tree search timeout in ms (default: 50)
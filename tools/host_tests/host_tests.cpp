@@ -0,0 +1,390 @@
+/**
+ * @file host_tests.cpp
+ * @brief Host checks of the palette search, lookup table and upload parser
+ *
+ * Every check compares the optimized code with the plain definition of the
+ * right answer on generated palettes:
+ * - DuluxExactScan against a brute-force scan under the shared metric, for
+ *   random RGB, the palette's own colors and L*a*b* targets on the edges of
+ *   the accepted range, unseeded, seeded and split across worker threads.
+ * - The uniform cells of palette_compiler's buildLut() against a brute-force
+ *   scan of every RGB value in a sample of cells.
+ * - DuluxPaletteUpload fed a v1 file split at every chunk boundary, plus
+ *   truncated and corrupted copies, which must leave the target untouched.
+ *
+ * Build and run (from the repository root):
+ *   g++ -std=c++17 -O2 -pthread -Isrc -Itools/host_tests/stubs \
+ *       tools/host_tests/host_tests.cpp src/CIEDE2000.cpp -o host_tests && ./host_tests
+ *
+ * stubs/ stands in for the Arduino, LittleFS and ESP-IDF declarations the
+ * firmware headers use. Exits with 1 if any check failed.
+ */
+
+// Shard count the exact scan is split into, independent of the host's cores
+#define DULUX_PARALLEL_CORES 3U
+
+// The compiler's command-line helpers are compiled in but not called from here
+#define PALETTE_COMPILER_NO_MAIN
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "../palette_compiler/palette_compiler.cpp"
+#pragma GCC diagnostic pop
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <random>
+
+#include "dulux_exact_scan.h"
+#include "dulux_palette_upload.h"
+
+namespace {
+
+constexpr uint32_t TEST_SEED = 20240611;
+constexpr size_t SCAN_PALETTE_COLORS = 2000;   // Above DULUX_PARALLEL_MIN_COLORS
+constexpr size_t LUT_PALETTE_COLORS = 150;     // Few colors; buildLut() still fills all 2^18 cells
+constexpr size_t UPLOAD_PALETTE_COLORS = 24;   // A few hundred bytes: every split is tried
+constexpr size_t RANDOM_QUERIES = 3000;
+constexpr size_t LUT_SAMPLED_CELLS = 3000;
+
+int failures = 0;
+
+void check(bool condition, const char* format, ...) {
+  if (condition) {
+    return;
+  }
+  failures++;
+  if (failures > 20) {
+    return;  // The count is still reported
+  }
+  va_list args;
+  va_start(args, format);
+  printf("  FAIL: ");
+  vprintf(format, args);
+  printf("\n");
+  va_end(args);
+}
+
+/**
+ * @brief Random palette in source order; about one color in six is light
+ *
+ * Names vary in length (including empty) so the v1 parser sees every
+ * string shape.
+ */
+std::vector<PaletteEntry> makePalette(size_t count, std::mt19937& random) {
+  std::uniform_int_distribution<int> channel(0, 255);
+  std::uniform_int_distribution<int> light_channel(DULUX_LIGHT_CHANNEL_THRESHOLD + 1, 255);
+  std::vector<PaletteEntry> entries;
+  while (entries.size() < count) {
+    PaletteEntry entry;
+    bool const LIGHT = random() % 6 == 0;
+    entry.r = (uint8_t)(LIGHT ? light_channel(random) : channel(random));
+    entry.g = (uint8_t)(LIGHT ? light_channel(random) : channel(random));
+    entry.b = (uint8_t)(LIGHT ? light_channel(random) : channel(random));
+    entry.name = std::string(entries.size() % 7 == 0 ? 0 : 1 + (random() % 30), 'n');
+    entry.code = "C" + std::to_string(entries.size());
+    entry.lrv_scaled = (uint16_t)(random() % 10001);
+    entry.id = (uint32_t)entries.size();
+    entry.light_text = random() % 2 == 0;
+    entries.push_back(entry);
+    if (entries.size() == count) {
+      dedupe(entries);
+    }
+  }
+  computeLabAndOrder(entries, DULUX_ORDER_SOURCE);
+  return entries;
+}
+
+struct BruteForceMatch {
+  uint32_t index;
+  float distance;
+};
+
+// The plain scan: every entry scored, ties to the lower index
+BruteForceMatch bruteForce(const std::vector<PaletteEntry>& entries, const CIEDE2000::LAB& lab,
+                           uint8_t r, uint8_t g, uint8_t b) {
+  BruteForceMatch best{(uint32_t)entries.size(), INFINITY};
+  for (size_t i = 0; i < entries.size(); i++) {
+    const PaletteEntry& entry = entries[i];
+    float const DISTANCE = duluxCandidateDistance(r, g, b, lab, entry.r, entry.g, entry.b,
+                                                  duluxLabFromFixed(entry.lab));
+    if (DISTANCE < best.distance) {
+      best = {(uint32_t)i, DISTANCE};
+    }
+  }
+  return best;
+}
+
+bool buildScan(DuluxExactScan& scan, const std::vector<PaletteEntry>& entries) {
+  return scan.build((uint32_t)entries.size(),
+                    [&entries](uint32_t index, uint8_t& r, uint8_t& g, uint8_t& b,
+                               DuluxLabFixed& lab) {
+                      const PaletteEntry& entry = entries[index];
+                      r = entry.r;
+                      g = entry.g;
+                      b = entry.b;
+                      lab = entry.lab;
+                      return true;
+                    });
+}
+
+// One query against the scan, unseeded and seeded; returns false on any disagreement
+bool scanAgrees(const DuluxExactScan& scan, const std::vector<PaletteEntry>& entries,
+                const CIEDE2000::LAB& lab, uint8_t r, uint8_t g, uint8_t b, uint32_t seed) {
+  BruteForceMatch const EXPECTED = bruteForce(entries, lab, r, g, b);
+  float distance = 0.0f;
+  uint32_t const UNSEEDED = scan.findClosest(lab, r, g, b, &distance);
+  bool ok = UNSEEDED == EXPECTED.index && distance == EXPECTED.distance;
+  uint32_t const SEEDED = scan.findClosest(lab, r, g, b, &distance, nullptr, seed);
+  ok = ok && SEEDED == EXPECTED.index && distance == EXPECTED.distance;
+  check(ok, "exact scan Lab(%.2f,%.2f,%.2f) RGB(%u,%u,%u): %u/%u (seed %u), brute force %u",
+        lab.l, lab.a, lab.b, r, g, b, UNSEEDED, SEEDED, seed, EXPECTED.index);
+  return ok;
+}
+
+size_t runScanQueries(const DuluxExactScan& scan, const std::vector<PaletteEntry>& entries,
+                      std::mt19937& random) {
+  std::uniform_int_distribution<int> channel(0, 255);
+  size_t queries = 0;
+
+  for (size_t i = 0; i < RANDOM_QUERIES; i++) {
+    auto const R = (uint8_t)channel(random);
+    auto const G = (uint8_t)channel(random);
+    auto const B = (uint8_t)channel(random);
+    CIEDE2000::LAB lab;
+    rgbToLAB(R, G, B, lab);
+    scanAgrees(scan, entries, lab, R, G, B, (uint32_t)(random() % entries.size()));
+    queries++;
+  }
+
+  // Palette colors themselves: distance 0 against the entry's own fixed-point L*a*b*
+  for (size_t i = 0; i < entries.size(); i += 7) {
+    const PaletteEntry& entry = entries[i];
+    scanAgrees(scan, entries, duluxLabFromFixed(entry.lab), entry.r, entry.g, entry.b,
+               (uint32_t)((i * 31) % entries.size()));
+    queries++;
+  }
+
+  // The edges of the L*a*b* range batch requests accept, with RGB derived as they are
+  double const L_EDGES[] = {0.0, 0.01, 50.0, 99.99, 100.0};
+  double const AB_EDGES[] = {-128.0, -127.99, 0.0, 126.99, 127.0};
+  for (double l : L_EDGES) {
+    for (double a : AB_EDGES) {
+      for (double b : AB_EDGES) {
+        CIEDE2000::LAB const LAB{l, a, b};
+        uint8_t r = 0, g = 0, bl = 0;
+        labToRGB(LAB, r, g, bl);
+        scanAgrees(scan, entries, LAB, r, g, bl, 0);
+        queries++;
+      }
+    }
+  }
+
+  // Light targets on the RGB branch, including the channel threshold itself
+  uint8_t const LIGHT_EDGES[] = {DULUX_LIGHT_CHANNEL_THRESHOLD, DULUX_LIGHT_CHANNEL_THRESHOLD + 1,
+                                 255};
+  for (uint8_t r : LIGHT_EDGES) {
+    for (uint8_t g : LIGHT_EDGES) {
+      for (uint8_t b : LIGHT_EDGES) {
+        CIEDE2000::LAB lab;
+        rgbToLAB(r, g, b, lab);
+        scanAgrees(scan, entries, lab, r, g, b, (uint32_t)(entries.size() - 1));
+        queries++;
+      }
+    }
+  }
+  return queries;
+}
+
+void testExactScan(std::mt19937& random) {
+  std::vector<PaletteEntry> const ENTRIES = makePalette(SCAN_PALETTE_COLORS, random);
+  DuluxExactScan scan;
+  check(buildScan(scan, ENTRIES), "exact scan build failed");
+
+  int const BEFORE = failures;
+  size_t const SERIAL = runScanQueries(scan, ENTRIES, random);
+
+  DuluxParallelScan workers;
+  workers.begin();
+  scan.setWorkers(&workers);
+  size_t const SHARDED = runScanQueries(scan, ENTRIES, random);
+  printf("exact scan: %zu queries on one core, %zu split over %u shards, %d disagreements\n",
+         SERIAL, SHARDED, (unsigned)workers.getShardCount(), failures - BEFORE);
+}
+
+void testLut(std::mt19937& random) {
+  std::vector<PaletteEntry> const ENTRIES = makePalette(LUT_PALETTE_COLORS, random);
+  uint32_t const CRC = 0x12345678;
+  std::vector<uint8_t> const IMAGE = buildLut(ENTRIES, CRC);
+
+  DuluxLutHeader header{};
+  size_t const CELLS = (size_t)1 << (3 * DULUX_LUT_BITS);
+  check(IMAGE.size() == sizeof(header) + (CELLS * sizeof(uint16_t)), "LUT size %zu",
+        IMAGE.size());
+  if (IMAGE.size() != sizeof(header) + (CELLS * sizeof(uint16_t))) {
+    return;
+  }
+  memcpy(&header, IMAGE.data(), sizeof(header));
+  std::vector<uint16_t> cells(CELLS);
+  memcpy(cells.data(), IMAGE.data() + sizeof(header), CELLS * sizeof(uint16_t));
+  check(header.magic == DULUX_LUT_MAGIC && header.palette_crc == CRC &&
+            header.color_count == ENTRIES.size() && header.bits == DULUX_LUT_BITS,
+        "LUT header fields");
+  check(header.cells_crc == duluxCrc32(0, IMAGE.data() + sizeof(header),
+                                       CELLS * sizeof(uint16_t)),
+        "LUT cells CRC");
+  auto const UNIFORM = (uint32_t)std::count_if(cells.begin(), cells.end(), [](uint16_t cell) {
+    return (cell & DULUX_LUT_BOUNDARY) == 0;
+  });
+  check(header.uniform_cells == UNIFORM, "LUT uniform count %u, header %u", UNIFORM,
+        header.uniform_cells);
+
+  // Every value of a uniform cell has the stored winner; a boundary cell has two winners
+  uint32_t const SIDE = 1U << DULUX_LUT_BITS;
+  uint32_t const SPAN = 1U << (8 - DULUX_LUT_BITS);
+  int const BEFORE = failures;
+  size_t uniform_checked = 0;
+  size_t boundary_checked = 0;
+  for (size_t sample = 0; sample < LUT_SAMPLED_CELLS; sample++) {
+    auto const CELL = (uint32_t)(random() % CELLS);
+    uint32_t const CR = CELL / (SIDE * SIDE);
+    uint32_t const CG = (CELL / SIDE) % SIDE;
+    uint32_t const CB = CELL % SIDE;
+    bool const BOUNDARY = (cells[CELL] & DULUX_LUT_BOUNDARY) != 0;
+    uint32_t const STORED = cells[CELL] & ~DULUX_LUT_BOUNDARY;
+    bool hint_wins = false;
+    bool mixed = false;
+    uint32_t first = UINT32_MAX;
+    for (uint32_t r = CR * SPAN; r < (CR + 1) * SPAN; r++) {
+      for (uint32_t g = CG * SPAN; g < (CG + 1) * SPAN; g++) {
+        for (uint32_t b = CB * SPAN; b < (CB + 1) * SPAN; b++) {
+          CIEDE2000::LAB lab;
+          rgbToLAB((uint8_t)r, (uint8_t)g, (uint8_t)b, lab);
+          uint32_t const WINNER =
+              bruteForce(ENTRIES, lab, (uint8_t)r, (uint8_t)g, (uint8_t)b).index;
+          if (!BOUNDARY) {
+            check(WINNER == STORED, "LUT cell %u RGB(%u,%u,%u): stored %u, brute force %u",
+                  CELL, r, g, b, STORED, WINNER);
+          }
+          hint_wins = hint_wins || WINNER == STORED;
+          mixed = mixed || (first != UINT32_MAX && WINNER != first);
+          first = WINNER;
+        }
+      }
+    }
+    if (BOUNDARY) {
+      check(mixed && hint_wins, "LUT boundary cell %u: mixed %d, hint wins %d", CELL, mixed,
+            hint_wins);
+      boundary_checked++;
+    } else {
+      uniform_checked++;
+    }
+  }
+  printf("lookup table: %zu uniform and %zu boundary cells checked value by value, "
+         "%d disagreements\n",
+         uniform_checked, boundary_checked, failures - BEFORE);
+}
+
+// Feed the image in the given pieces; returns whether finish() accepted it
+bool upload(const std::vector<uint8_t>& image, const std::vector<size_t>& cuts,
+            DuluxPaletteUpload& receiver) {
+  if (!receiver.begin("/upload.bin")) {
+    return false;
+  }
+  size_t start = 0;
+  for (size_t end : cuts) {
+    receiver.write(image.data() + start, end - start);
+    start = end;
+  }
+  return receiver.finish();
+}
+
+std::vector<uint8_t> readHostFile(const char* path) {
+  std::vector<uint8_t> content;
+  File file = LittleFS.open(path, "r");
+  uint8_t buffer[256];
+  for (size_t got; file && (got = file.read(buffer, sizeof(buffer))) > 0;) {
+    content.insert(content.end(), buffer, buffer + got);
+  }
+  return content;
+}
+
+void testUpload(std::mt19937& random) {
+  char directory[] = "/tmp/host_tests.XXXXXX";
+  if (!mkdtemp(directory)) {
+    check(false, "cannot create a temporary directory");
+    return;
+  }
+  LittleFS.root = directory;
+
+  std::vector<PaletteEntry> const ENTRIES = makePalette(UPLOAD_PALETTE_COLORS, random);
+  std::vector<uint8_t> const IMAGE = writeV1(ENTRIES);
+  uint32_t expected_crc = 0;
+  memcpy(&expected_crc, IMAGE.data() + IMAGE.size() - sizeof(DuluxV1Trailer),
+         sizeof(expected_crc));
+  size_t const SIZE = IMAGE.size();
+  size_t const RECORDS_END = SIZE - sizeof(DuluxV1Trailer);  // The trailer is optional
+
+  int const BEFORE = failures;
+  DuluxPaletteUpload receiver;
+  auto accepted = [&](const std::vector<size_t>& cuts, const char* what, size_t where) {
+    bool const OK = upload(IMAGE, cuts, receiver);
+    check(OK && receiver.getColorCount() == ENTRIES.size() &&
+              receiver.getPaletteCrc() == expected_crc && receiver.getBytesReceived() == SIZE &&
+              readHostFile("/upload.bin") == IMAGE,
+          "upload %s %zu: accepted %d (%s)", what, where, OK, receiver.getError());
+  };
+
+  accepted({SIZE}, "in one piece", SIZE);
+  for (size_t split = 1; split < SIZE; split++) {
+    accepted({split, SIZE}, "split at", split);
+  }
+  for (size_t chunk = 1; chunk <= 64; chunk++) {
+    std::vector<size_t> cuts;
+    for (size_t end = chunk; end < SIZE + chunk; end += chunk) {
+      cuts.push_back(std::min(end, SIZE));
+    }
+    accepted(cuts, "in chunks of", chunk);
+  }
+
+  // Failed uploads leave the previous file as it was and no temporary files behind
+  auto rejected = [&](const std::vector<uint8_t>& image, const char* what, size_t where) {
+    bool const OK = upload(image, {image.size()}, receiver);
+    check(!OK && readHostFile("/upload.bin") == IMAGE && !LittleFS.exists("/upload.bin.part") &&
+              !LittleFS.exists("/upload.bin.old"),
+          "upload %s %zu: accepted %d, target kept %d", what, where, OK,
+          readHostFile("/upload.bin") == IMAGE);
+  };
+  for (size_t length = 0; length < SIZE; length++) {
+    if (length == RECORDS_END) {
+      continue;  // A v1 file without its trailer is complete
+    }
+    rejected(std::vector<uint8_t>(IMAGE.begin(), IMAGE.begin() + length), "truncated to",
+             length);
+  }
+  std::vector<uint8_t> corrupt = IMAGE;
+  corrupt[DULUX_HEADER_SIZE] ^= 0x01;  // First color's red channel: structure intact
+  rejected(corrupt, "with a flipped record byte at", DULUX_HEADER_SIZE);
+  std::vector<uint8_t> extended = IMAGE;
+  extended.push_back(0);
+  rejected(extended, "with a byte past the trailer, length", extended.size());
+  printf("upload: %zu-byte v1 file split at every offset and in 1-64 byte chunks, %zu "
+         "truncations, %d failures\n",
+         SIZE, SIZE - 1, failures - BEFORE);
+
+  LittleFS.remove("/upload.bin");
+  rmdir(directory);
+}
+
+}  // namespace
+
+int main() {
+  setvbuf(stdout, nullptr, _IOLBF, 0);  // Results show up as each check finishes
+  std::mt19937 random(TEST_SEED);
+  testExactScan(random);
+  testLut(random);
+  testUpload(random);
+  printf(failures == 0 ? "All host tests passed\n" : "%d checks failed\n", failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file Arduino.h
+ * @brief Host stand-in for the parts of the Arduino core the firmware headers use
+ *
+ * Only what tools/host_tests needs: timing, a silent Serial, String as far
+ * as path building goes, and ESP.getFreePsram(). Not for firmware builds.
+ */
+
+#ifndef HOST_TESTS_ARDUINO_H
+#define HOST_TESTS_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+
+inline unsigned long millis() {
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline unsigned long micros() {
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline void yield() {}
+
+// Log output of the code under test is dropped; the tests report their own results
+struct HostSerial {
+  template <typename... Args>
+  void printf(const char* /*format*/, Args... /*args*/) {}
+  void println(const char* /*text*/ = "") {}
+};
+inline HostSerial Serial;
+
+class String : public std::string {
+ public:
+  String() = default;
+  String(const char* text) : std::string(text ? text : "") {}
+  String(const std::string& text) : std::string(text) {}
+  String operator+(const char* text) const {
+    return String(static_cast<const std::string&>(*this) + text);
+  }
+};
+
+// Reports 8 MB free, so PSRAM-sized planning takes its normal path
+struct HostEsp {
+  size_t getFreePsram() const {
+    return 8U << 20;
+  }
+};
+inline HostEsp ESP;
+
+#endif  // HOST_TESTS_ARDUINO_H
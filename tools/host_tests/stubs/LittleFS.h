@@ -0,0 +1,82 @@
+/**
+ * @file LittleFS.h
+ * @brief Host stand-in for LittleFS: absolute firmware paths under a host directory
+ *
+ * Set LittleFS.root to an existing directory before use; "/x.bin" then
+ * means root + "/x.bin".
+ */
+
+#ifndef HOST_TESTS_LITTLEFS_H
+#define HOST_TESTS_LITTLEFS_H
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+#include "Arduino.h"
+
+class File {
+ private:
+  std::shared_ptr<FILE> handle;
+
+ public:
+  File() = default;
+  explicit File(FILE* opened) : handle(opened, [](FILE* file) { fclose(file); }) {}
+
+  explicit operator bool() const {
+    return handle != nullptr;
+  }
+  size_t read(uint8_t* buffer, size_t length) {
+    return handle ? fread(buffer, 1, length, handle.get()) : 0;
+  }
+  size_t write(const uint8_t* buffer, size_t length) {
+    return handle ? fwrite(buffer, 1, length, handle.get()) : 0;
+  }
+  bool seek(uint32_t position) {
+    return handle && fseek(handle.get(), (long)position, SEEK_SET) == 0;
+  }
+  size_t position() const {
+    return handle ? (size_t)ftell(handle.get()) : 0;
+  }
+  void close() {
+    handle.reset();
+  }
+};
+
+struct HostLittleFS {
+  std::string root;
+
+  std::string hostPath(const char* path) const {
+    return root + path;
+  }
+  File open(const char* path, const char* mode) {
+    FILE* const FILE_HANDLE = fopen(hostPath(path).c_str(), mode[0] == 'w' ? "wb" : "rb");
+    return FILE_HANDLE ? File(FILE_HANDLE) : File();
+  }
+  File open(const String& path, const char* mode) {
+    return open(path.c_str(), mode);
+  }
+  bool exists(const char* path) const {
+    FILE* const FILE_HANDLE = fopen(hostPath(path).c_str(), "rb");
+    if (FILE_HANDLE) {
+      fclose(FILE_HANDLE);
+    }
+    return FILE_HANDLE != nullptr;
+  }
+  bool remove(const char* path) {
+    return ::remove(hostPath(path).c_str()) == 0;
+  }
+  bool remove(const String& path) {
+    return remove(path.c_str());
+  }
+  bool rename(const char* from, const char* to) {
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+  }
+  bool rename(const String& from, const char* to) {
+    return rename(from.c_str(), to);
+  }
+};
+inline HostLittleFS LittleFS;
+
+#endif  // HOST_TESTS_LITTLEFS_H
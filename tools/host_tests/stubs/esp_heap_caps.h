@@ -0,0 +1,23 @@
+/**
+ * @file esp_heap_caps.h
+ * @brief Host stand-in for the ESP-IDF capability allocator: plain malloc/free
+ */
+
+#ifndef HOST_TESTS_ESP_HEAP_CAPS_H
+#define HOST_TESTS_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+inline void* heap_caps_malloc(size_t size, int /*caps*/) {
+  return malloc(size);
+}
+
+inline void heap_caps_free(void* pointer) {
+  free(pointer);
+}
+
+#endif  // HOST_TESTS_ESP_HEAP_CAPS_H
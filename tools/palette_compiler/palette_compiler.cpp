@@ -0,0 +1,1086 @@
+/**
+ * @file palette_compiler.cpp
+ * @brief Host tool that compiles a paint palette into a dulux.bin database
+ *
+ * Inputs: CSV (header row), JSON (array of objects) or an existing dulux.bin
+ * (v1 or v2). Outputs the v1 row format or the v2 columnar format described in
+ * src/dulux_palette_format.h.
+ *
+ * Processing:
+ * - Colors with identical RGB are de-duplicated (first occurrence wins), since
+ *   the matcher can never tell them apart.
+ * - Entries are sorted along a Hilbert (default) or Morton curve in L*a*b*
+ *   space so that perceptually close colors are adjacent in the file.
+ * - A CRC-32 identifies the palette (v2 META section, v1 trailer).
+ * - v2 output carries a prebuilt KD-tree section the firmware adopts as-is
+ *   instead of building the tree at boot.
+ * - v2 names and codes are front-coded (dulux_front_coding.h) unless
+ *   --names plain is given.
+ * - --lut precomputes the exact match of every RGB value into a
+ *   DULUX_LUT_BITS-per-channel table keyed by the palette CRC. This is the
+ *   slow part of a build (minutes per core); it runs on every hardware thread.
+ *
+ * Build (from the repository root):
+ *   g++ -std=c++17 -O2 -pthread -Isrc tools/palette_compiler/palette_compiler.cpp \
+ *       src/CIEDE2000.cpp -o palette_compiler
+ *
+ * Usage:
+ *   palette_compiler [options] <input.csv|input.json|input.bin> <output.bin>
+ *     --format v1|v2           Output layout (default: v2)
+ *     --order hilbert|morton|source   Entry ordering (default: hilbert)
+ *     --keep-duplicates        Keep colors with identical RGB
+ *     --no-index               Do not emit the prebuilt KD-tree section
+ *     --names front-coded|plain   v2 string encoding (default: front-coded)
+ *     --lut <output.lut>       Also write the nearest-paint lookup table
+ *
+ * CSV columns (case-insensitive, any order): name, code, r, g, b (or hex),
+ * lrv, id, light_text. JSON objects use the same keys (lightText accepted).
+ *
+ * tools/host_tests includes this file with PALETTE_COMPILER_NO_MAIN defined
+ * to check its writers and buildLut() directly.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "CIEDE2000.h"
+#include "dulux_front_coding.h"
+#include "dulux_match_metric.h"
+#include "dulux_palette_format.h"
+#include "dulux_spatial_order.h"
+
+namespace {
+
+constexpr size_t MAX_V1_STRING = 254;  // 255 is the v1 reader's error sentinel
+constexpr size_t MAX_INDEXED_COLORS = 65535;
+// CIEDE2000 lower-bound constants, derived in src/dulux_exact_scan.h
+constexpr float LUT_SL_MAX = 1.747f;
+constexpr float LUT_CROSS_FLOOR = 0.134f;
+constexpr float LUT_SC_SLOPE = 0.03375f;
+constexpr float LUT_BOUND_SLACK = 1e-3f;
+
+struct PaletteEntry {
+  std::string name;
+  std::string code;
+  uint8_t r{0}, g{0}, b{0};
+  uint16_t lrv_scaled{0};
+  uint32_t id{0};
+  bool light_text{false};
+  DuluxLabFixed lab{};
+  uint32_t curve_key{0};
+};
+
+struct Options {
+  std::string input;
+  std::string output;
+  uint32_t version{DULUX_BINARY_VERSION_V2};
+  uint32_t ordering{DULUX_ORDER_HILBERT};
+  bool dedupe{true};
+  bool emit_index{true};
+  bool front_coded{true};
+  std::string lut_output;  // Empty: no lookup table
+};
+
+[[noreturn]] void fail(const std::string& message) {
+  fprintf(stderr, "palette_compiler: %s\n", message.c_str());
+  exit(1);
+}
+
+std::string lowercase(std::string value) {
+  for (char& c : value) {
+    c = (char)tolower((unsigned char)c);
+  }
+  return value;
+}
+
+std::string trim(const std::string& value) {
+  size_t const START = value.find_first_not_of(" \t\r\n");
+  if (START == std::string::npos) {
+    return "";
+  }
+  size_t const END = value.find_last_not_of(" \t\r\n");
+  return value.substr(START, END - START + 1);
+}
+
+bool parseBool(const std::string& value) {
+  std::string const LOWER = lowercase(trim(value));
+  return LOWER == "1" || LOWER == "true" || LOWER == "yes";
+}
+
+uint8_t parseChannel(const std::string& value, const char* what) {
+  long const CHANNEL = strtol(value.c_str(), nullptr, 10);
+  if (CHANNEL < 0 || CHANNEL > 255) {
+    fail(std::string("channel out of range for ") + what + ": " + value);
+  }
+  return (uint8_t)CHANNEL;
+}
+
+void parseHex(const std::string& value, PaletteEntry& entry) {
+  std::string hex = trim(value);
+  if (!hex.empty() && hex[0] == '#') {
+    hex.erase(0, 1);
+  }
+  if (hex.size() != 6) {
+    fail("invalid hex color: " + value);
+  }
+  unsigned long const RGB = strtoul(hex.c_str(), nullptr, 16);
+  entry.r = (uint8_t)(RGB >> 16);
+  entry.g = (uint8_t)(RGB >> 8);
+  entry.b = (uint8_t)RGB;
+}
+
+// Apply one named field to an entry (shared by the CSV and JSON readers)
+void applyField(PaletteEntry& entry, const std::string& key, const std::string& value) {
+  std::string const KEY = lowercase(key);
+  if (KEY == "name") {
+    entry.name = value;
+  } else if (KEY == "code") {
+    entry.code = value;
+  } else if (KEY == "r" || KEY == "red") {
+    entry.r = parseChannel(value, "r");
+  } else if (KEY == "g" || KEY == "green") {
+    entry.g = parseChannel(value, "g");
+  } else if (KEY == "b" || KEY == "blue") {
+    entry.b = parseChannel(value, "b");
+  } else if (KEY == "hex") {
+    parseHex(value, entry);
+  } else if (KEY == "lrv") {
+    entry.lrv_scaled = (uint16_t)((strtod(value.c_str(), nullptr) * 100.0) + 0.5);
+  } else if (KEY == "id") {
+    entry.id = (uint32_t)strtoul(value.c_str(), nullptr, 10);
+  } else if (KEY == "light_text" || KEY == "lighttext") {
+    entry.light_text = parseBool(value);
+  }
+}
+
+std::string readFile(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    fail("cannot open " + path);
+  }
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  return contents.str();
+}
+
+/*****************************************************************************
+ * CSV input
+ *****************************************************************************/
+
+std::vector<std::string> splitCsvLine(const std::string& line) {
+  std::vector<std::string> fields;
+  std::string field;
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); i++) {
+    char const C = line[i];
+    if (quoted) {
+      if (C == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+        field += '"';
+        i++;
+      } else if (C == '"') {
+        quoted = false;
+      } else {
+        field += C;
+      }
+    } else if (C == '"') {
+      quoted = true;
+    } else if (C == ',') {
+      fields.push_back(trim(field));
+      field.clear();
+    } else {
+      field += C;
+    }
+  }
+  fields.push_back(trim(field));
+  return fields;
+}
+
+std::vector<PaletteEntry> readCsv(const std::string& path) {
+  std::istringstream in(readFile(path));
+  std::string line;
+  std::vector<std::string> columns;
+  std::vector<PaletteEntry> entries;
+
+  while (std::getline(in, line)) {
+    if (trim(line).empty()) {
+      continue;
+    }
+    std::vector<std::string> const FIELDS = splitCsvLine(line);
+    if (columns.empty()) {
+      columns = FIELDS;
+      continue;
+    }
+    PaletteEntry entry;
+    for (size_t i = 0; i < FIELDS.size() && i < columns.size(); i++) {
+      applyField(entry, columns[i], FIELDS[i]);
+    }
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+/*****************************************************************************
+ * JSON input (array of flat objects with string, number or bool values)
+ *****************************************************************************/
+
+class JsonReader {
+ private:
+  const std::string& text;
+  size_t pos{0};
+
+  void skipSpace() {
+    while (pos < text.size() && isspace((unsigned char)text[pos])) {
+      pos++;
+    }
+  }
+
+  void expect(char c) {
+    skipSpace();
+    if (pos >= text.size() || text[pos] != c) {
+      fail(std::string("JSON: expected '") + c + "' at offset " + std::to_string(pos));
+    }
+    pos++;
+  }
+
+  bool consume(char c) {
+    skipSpace();
+    if (pos < text.size() && text[pos] == c) {
+      pos++;
+      return true;
+    }
+    return false;
+  }
+
+  std::string parseString() {
+    expect('"');
+    std::string out;
+    while (pos < text.size() && text[pos] != '"') {
+      char c = text[pos++];
+      if (c == '\\' && pos < text.size()) {
+        char const ESCAPE = text[pos++];
+        switch (ESCAPE) {
+          case 'n':
+            c = '\n';
+            break;
+          case 't':
+            c = '\t';
+            break;
+          case 'u': {
+            // Encode the BMP code point as UTF-8
+            unsigned long const CODE = strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+            pos += 4;
+            if (CODE < 0x80) {
+              out += (char)CODE;
+            } else if (CODE < 0x800) {
+              out += (char)(0xC0 | (CODE >> 6));
+              out += (char)(0x80 | (CODE & 0x3F));
+            } else {
+              out += (char)(0xE0 | (CODE >> 12));
+              out += (char)(0x80 | ((CODE >> 6) & 0x3F));
+              out += (char)(0x80 | (CODE & 0x3F));
+            }
+            continue;
+          }
+          default:
+            c = ESCAPE;
+            break;
+        }
+      }
+      out += c;
+    }
+    expect('"');
+    return out;
+  }
+
+  std::string parseScalar() {
+    skipSpace();
+    if (pos < text.size() && text[pos] == '"') {
+      return parseString();
+    }
+    size_t const START = pos;
+    while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ']' &&
+           !isspace((unsigned char)text[pos])) {
+      pos++;
+    }
+    return text.substr(START, pos - START);
+  }
+
+ public:
+  explicit JsonReader(const std::string& source) : text(source) {
+  }
+
+  std::vector<PaletteEntry> parse() {
+    std::vector<PaletteEntry> entries;
+    expect('[');
+    if (consume(']')) {
+      return entries;
+    }
+    do {
+      PaletteEntry entry;
+      expect('{');
+      if (!consume('}')) {
+        do {
+          std::string const KEY = parseString();
+          expect(':');
+          applyField(entry, KEY, parseScalar());
+        } while (consume(','));
+        expect('}');
+      }
+      entries.push_back(entry);
+    } while (consume(','));
+    expect(']');
+    return entries;
+  }
+};
+
+/*****************************************************************************
+ * Existing dulux.bin input (v1 or v2)
+ *****************************************************************************/
+
+template <typename T>
+T loadAt(const std::string& data, size_t offset) {
+  if (offset + sizeof(T) > data.size()) {
+    fail("truncated binary input");
+  }
+  T value;
+  memcpy(&value, data.data() + offset, sizeof(T));
+  return value;
+}
+
+std::vector<PaletteEntry> readBinary(const std::string& path) {
+  std::string const DATA = readFile(path);
+  auto const HEADER = loadAt<DuluxBinaryHeader>(DATA, 0);
+  if (HEADER.magic != DULUX_MAGIC_NUMBER || !duluxIsSupportedVersion(HEADER.version)) {
+    fail("not a dulux.bin database: " + path);
+  }
+
+  std::vector<PaletteEntry> entries(HEADER.color_count);
+
+  if (HEADER.version == DULUX_BINARY_VERSION) {
+    size_t pos = DULUX_HEADER_SIZE;
+    auto readString = [&](std::string& out) {
+      uint8_t const LENGTH = loadAt<uint8_t>(DATA, pos++);
+      if (LENGTH != 255) {
+        out = DATA.substr(pos, LENGTH);
+        pos += LENGTH;
+      }
+    };
+    for (PaletteEntry& entry : entries) {
+      entry.r = loadAt<uint8_t>(DATA, pos);
+      entry.g = loadAt<uint8_t>(DATA, pos + 1);
+      entry.b = loadAt<uint8_t>(DATA, pos + 2);
+      entry.lrv_scaled = loadAt<uint16_t>(DATA, pos + 3);
+      entry.id = loadAt<uint32_t>(DATA, pos + 5);
+      pos += DULUX_FIXED_FIELDS_SIZE;
+      readString(entry.name);
+      readString(entry.code);
+      entry.light_text = loadAt<uint8_t>(DATA, pos++) != 0;
+    }
+    return entries;
+  }
+
+  uint32_t const SECTION_COUNT = loadAt<uint32_t>(DATA, HEADER.reserved);
+  std::map<uint32_t, DuluxSectionEntry> sections;
+  for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+    auto const ENTRY =
+        loadAt<DuluxSectionEntry>(DATA, HEADER.reserved + 4 + (i * sizeof(DuluxSectionEntry)));
+    sections[ENTRY.tag] = ENTRY;
+  }
+  for (uint32_t tag : {DULUX_SECTION_RGB, DULUX_SECTION_LRV, DULUX_SECTION_ID, DULUX_SECTION_FLAGS}) {
+    if (sections.count(tag) == 0) {
+      fail("v2 input is missing a required section");
+    }
+  }
+  bool const FRONT_CODED =
+      sections.count(DULUX_SECTION_NAME_FC) != 0 && sections.count(DULUX_SECTION_CODE_FC) != 0;
+  if (!FRONT_CODED && (sections.count(DULUX_SECTION_NAME) == 0 ||
+                       sections.count(DULUX_SECTION_CODE) == 0 ||
+                       sections.count(DULUX_SECTION_STRINGS) == 0)) {
+    fail("v2 input has no name/code sections");
+  }
+
+  auto heapString = [&](uint32_t column, uint32_t index) {
+    uint32_t const OFFSET = loadAt<uint32_t>(DATA, sections[column].offset + (index * 4));
+    return std::string(DATA.c_str() + sections[DULUX_SECTION_STRINGS].offset + OFFSET);
+  };
+  auto frontCodedString = [&](uint32_t tag, uint32_t index) {
+    const DuluxSectionEntry& entry = sections[tag];
+    DuluxFrontCodedLayout layout{};
+    if (!duluxFrontCodedLayout(loadAt<DuluxFrontCodedHeader>(DATA, entry.offset), entry.size,
+                               HEADER.color_count, layout)) {
+      fail("malformed front-coded section in input");
+    }
+    char buffer[DULUX_FRONT_CODED_MAX_LENGTH + 1];
+    const auto* section = reinterpret_cast<const uint8_t*>(DATA.data()) + entry.offset;
+    if (duluxFrontCodedDecode(section, layout, index, buffer, sizeof(buffer)) < 0) {
+      fail("malformed front-coded string in input");
+    }
+    return std::string(buffer);
+  };
+  for (uint32_t i = 0; i < HEADER.color_count; i++) {
+    PaletteEntry& entry = entries[i];
+    size_t const RGB = sections[DULUX_SECTION_RGB].offset + (i * 3);
+    entry.r = loadAt<uint8_t>(DATA, RGB);
+    entry.g = loadAt<uint8_t>(DATA, RGB + 1);
+    entry.b = loadAt<uint8_t>(DATA, RGB + 2);
+    entry.lrv_scaled = loadAt<uint16_t>(DATA, sections[DULUX_SECTION_LRV].offset + (i * 2));
+    entry.id = loadAt<uint32_t>(DATA, sections[DULUX_SECTION_ID].offset + (i * 4));
+    entry.light_text =
+        (loadAt<uint8_t>(DATA, sections[DULUX_SECTION_FLAGS].offset + i) & DULUX_FLAG_LIGHT_TEXT) != 0;
+    entry.name = FRONT_CODED ? frontCodedString(DULUX_SECTION_NAME_FC, i)
+                             : heapString(DULUX_SECTION_NAME, i);
+    entry.code = FRONT_CODED ? frontCodedString(DULUX_SECTION_CODE_FC, i)
+                             : heapString(DULUX_SECTION_CODE, i);
+  }
+  return entries;
+}
+
+/*****************************************************************************
+ * Processing
+ *****************************************************************************/
+
+size_t dedupe(std::vector<PaletteEntry>& entries) {
+  std::unordered_set<uint32_t> seen;
+  std::vector<PaletteEntry> unique;
+  unique.reserve(entries.size());
+  for (const PaletteEntry& entry : entries) {
+    uint32_t const KEY = ((uint32_t)entry.r << 16) | ((uint32_t)entry.g << 8) | entry.b;
+    if (seen.insert(KEY).second) {
+      unique.push_back(entry);
+    } else {
+      fprintf(stderr, "  duplicate RGB(%u,%u,%u) dropped: %s (%s)\n", entry.r, entry.g, entry.b,
+              entry.name.c_str(), entry.code.c_str());
+    }
+  }
+  size_t const DROPPED = entries.size() - unique.size();
+  entries.swap(unique);
+  return DROPPED;
+}
+
+void computeLabAndOrder(std::vector<PaletteEntry>& entries, uint32_t ordering) {
+  for (PaletteEntry& entry : entries) {
+    CIEDE2000::LAB lab;
+    rgbToLAB(entry.r, entry.g, entry.b, lab);
+    entry.lab = duluxLabToFixed(lab);
+
+    uint32_t axes[3];
+    duluxLabToCurveAxes(entry.lab, axes);
+    entry.curve_key = ordering == DULUX_ORDER_MORTON ? duluxMortonKey(axes) : duluxHilbertKey(axes);
+  }
+
+  if (ordering != DULUX_ORDER_SOURCE) {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const PaletteEntry& a, const PaletteEntry& b) {
+                       return a.curve_key < b.curve_key;
+                     });
+  }
+}
+
+void clampStrings(std::vector<PaletteEntry>& entries) {
+  for (PaletteEntry& entry : entries) {
+    for (std::string* field : {&entry.name, &entry.code}) {
+      if (field->size() > MAX_V1_STRING) {
+        fprintf(stderr, "  truncating long string: %s\n", field->c_str());
+        field->resize(MAX_V1_STRING);
+      }
+    }
+  }
+}
+
+/*****************************************************************************
+ * Output
+ *****************************************************************************/
+
+template <typename T>
+void append(std::vector<uint8_t>& out, const T& value) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+void appendString(std::vector<uint8_t>& out, const std::string& value) {
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+/**
+ * @brief Build the KD-tree in the implicit layout LightweightKDTree uses
+ *
+ * Every range larger than DULUX_KD_LEAF_SIZE is sorted on L*a*b* axis
+ * depth % 3 so that its middle record is the median, then both halves are
+ * split the same way. The result is the section payload: header + points.
+ */
+std::vector<uint8_t> buildKDTree(const std::vector<PaletteEntry>& entries) {
+  struct Point {
+    int16_t c[3];
+    DuluxKDPointRecord record;
+  };
+  struct Range {
+    size_t lo;
+    size_t hi;
+    uint8_t depth;
+  };
+
+  std::vector<Point> points(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    const PaletteEntry& entry = entries[i];
+    points[i] = {{entry.lab.l, entry.lab.a, entry.lab.b},
+                 {entry.r, entry.g, entry.b, 0, (uint16_t)i}};
+  }
+
+  std::vector<Range> pending{{0, points.size(), 0}};
+  while (!pending.empty()) {
+    Range const RANGE = pending.back();
+    pending.pop_back();
+    if (RANGE.hi - RANGE.lo <= DULUX_KD_LEAF_SIZE) {
+      continue;
+    }
+
+    uint8_t const AXIS = RANGE.depth % 3;
+    std::stable_sort(points.begin() + RANGE.lo, points.begin() + RANGE.hi,
+                     [AXIS](const Point& a, const Point& b) { return a.c[AXIS] < b.c[AXIS]; });
+    size_t const MID = RANGE.lo + ((RANGE.hi - RANGE.lo) / 2);
+    pending.push_back({RANGE.lo, MID, (uint8_t)(RANGE.depth + 1)});
+    pending.push_back({MID + 1, RANGE.hi, (uint8_t)(RANGE.depth + 1)});
+  }
+
+  DuluxKDTreeHeader header{};
+  header.leaf_size = DULUX_KD_LEAF_SIZE;
+  header.point_count = (uint32_t)points.size();
+  std::vector<uint8_t> tree;
+  append(tree, header);
+  for (const Point& point : points) {
+    append(tree, point.record);
+  }
+  return tree;
+}
+
+/**
+ * @brief Nearest-paint lookup table over RGB quantized to DULUX_LUT_BITS per channel
+ *
+ * Every one of the 2^24 RGB values is matched exactly with the firmware
+ * metric (lowest index wins ties), one cell at a time:
+ * - The previous cell's winner is scored against every value in the cell;
+ *   the worst of those distances bounds every value's true match.
+ * - Candidates whose CIEDE2000 lower bound (src/dulux_exact_scan.h) to the
+ *   cell's L*a*b* box exceeds that are dropped for the whole cell. Light
+ *   candidates of a cell with light values are also bounded by RGB box distance.
+ * - Each value then checks the short list with its own bound.
+ * A cell whose values all share one winner stores it; any other cell gets
+ * DULUX_LUT_BOUNDARY plus its most frequent winner as a hint.
+ */
+std::vector<uint8_t> buildLut(const std::vector<PaletteEntry>& entries, uint32_t palette_crc) {
+  struct Color {
+    CIEDE2000::LAB lab;
+    float l, a, b, chroma;
+    uint8_t r, g, bl;
+    bool light;
+    uint16_t index;
+  };
+  auto makeColor = [](uint8_t r, uint8_t g, uint8_t b, const CIEDE2000::LAB& lab,
+                      uint16_t index) {
+    return Color{lab,
+                 (float)lab.l,
+                 (float)lab.a,
+                 (float)lab.b,
+                 hypotf((float)lab.a, (float)lab.b),
+                 r,
+                 g,
+                 b,
+                 r > DULUX_LIGHT_CHANNEL_THRESHOLD && g > DULUX_LIGHT_CHANNEL_THRESHOLD &&
+                     b > DULUX_LIGHT_CHANNEL_THRESHOLD,
+                 index};
+  };
+  auto distance = [](const Color& target, const Color& candidate) {
+    return duluxCandidateDistance(target.r, target.g, target.bl, target.lab, candidate.r,
+                                  candidate.g, candidate.bl, candidate.lab);
+  };
+  // Squared CIEDE2000 lower bound from L*a*b* gaps and the largest possible chroma sum
+  auto boundSquared = [](float dl, float da, float db, float chroma_sum) {
+    float const L_TERM = dl / LUT_SL_MAX;
+    float const SC_MAX = 1.0f + (LUT_SC_SLOPE * chroma_sum);
+    return (L_TERM * L_TERM) + (LUT_CROSS_FLOOR * ((da * da) + (db * db)) / (SC_MAX * SC_MAX));
+  };
+  auto gap = [](float value, float lo, float hi) {
+    return value < lo ? lo - value : (value > hi ? value - hi : 0.0f);
+  };
+
+  std::vector<Color> candidates;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const PaletteEntry& entry = entries[i];
+    candidates.push_back(
+        makeColor(entry.r, entry.g, entry.b, duluxLabFromFixed(entry.lab), (uint16_t)i));
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Color& x, const Color& y) { return x.l < y.l; });
+  std::vector<uint32_t> position(entries.size());
+  for (size_t i = 0; i < candidates.size(); i++) {
+    position[candidates[i].index] = (uint32_t)i;
+  }
+
+  uint32_t const SIDE = 1U << DULUX_LUT_BITS;
+  uint32_t const SHIFT = 8 - DULUX_LUT_BITS;
+  uint32_t const SPAN = 1U << SHIFT;
+  std::vector<uint16_t> cells((size_t)SIDE * SIDE * SIDE);
+  struct Listed {
+    float bound;  // Squared lower bound over the whole cell
+    const Color* color;
+  };
+
+  // One red slice of cells; slices are independent and shared out between threads
+  auto fillSlice = [&](uint32_t cr) {
+    std::vector<Color> values;
+    std::vector<Listed> shortlist;
+    std::vector<uint32_t> winners;
+    uint32_t seed = 0;  // Palette index of the previous cell's most frequent winner
+
+    for (uint32_t cg = 0; cg < SIDE; cg++) {
+      for (uint32_t cb = 0; cb < SIDE; cb++) {
+        // The cell's values and their L*a*b* bounding box
+        values.clear();
+        float l_lo = INFINITY, l_hi = -INFINITY, a_lo = INFINITY, a_hi = -INFINITY;
+        float b_lo = INFINITY, b_hi = -INFINITY, chroma_hi = 0.0f;
+        bool any_light = false;
+        for (uint32_t r = cr * SPAN; r < (cr + 1) * SPAN; r++) {
+          for (uint32_t g = cg * SPAN; g < (cg + 1) * SPAN; g++) {
+            for (uint32_t b = cb * SPAN; b < (cb + 1) * SPAN; b++) {
+              CIEDE2000::LAB lab;
+              rgbToLAB((uint8_t)r, (uint8_t)g, (uint8_t)b, lab);
+              values.push_back(makeColor((uint8_t)r, (uint8_t)g, (uint8_t)b, lab, 0));
+              const Color& value = values.back();
+              l_lo = std::min(l_lo, value.l);
+              l_hi = std::max(l_hi, value.l);
+              a_lo = std::min(a_lo, value.a);
+              a_hi = std::max(a_hi, value.a);
+              b_lo = std::min(b_lo, value.b);
+              b_hi = std::max(b_hi, value.b);
+              chroma_hi = std::max(chroma_hi, value.chroma);
+              any_light = any_light || value.light;
+            }
+          }
+        }
+
+        float limit = 0.0f;
+        for (const Color& value : values) {
+          limit = std::max(limit, distance(value, candidates[position[seed]]));
+        }
+        limit += LUT_BOUND_SLACK;
+
+        // Short list: every candidate that could beat the seed somewhere in the cell
+        shortlist.clear();
+        for (const Color& candidate : candidates) {
+          float const DL = gap(candidate.l, l_lo, l_hi);
+          if (DL / LUT_SL_MAX > limit && candidate.l > l_hi && !any_light) {
+            break;  // Sorted by L*: everything further is out of reach too
+          }
+          float bound = boundSquared(DL, gap(candidate.a, a_lo, a_hi),
+                                     gap(candidate.b, b_lo, b_hi), chroma_hi + candidate.chroma);
+          if (any_light && candidate.light) {
+            float const DR = gap(candidate.r, (float)(cr * SPAN), (float)((cr + 1) * SPAN - 1));
+            float const DG = gap(candidate.g, (float)(cg * SPAN), (float)((cg + 1) * SPAN - 1));
+            float const DB = gap(candidate.bl, (float)(cb * SPAN), (float)((cb + 1) * SPAN - 1));
+            bound = std::min(bound, (DR * DR) + (DG * DG) + (DB * DB));
+          }
+          if (bound <= limit * limit) {
+            shortlist.push_back({bound, &candidate});
+          }
+        }
+        std::sort(shortlist.begin(), shortlist.end(),
+                  [](const Listed& x, const Listed& y) { return x.bound < y.bound; });
+
+        // Exact winner of each value among the short list, seeded with the previous value's
+        winners.clear();
+        uint32_t best_index = seed;
+        for (const Color& value : values) {
+          float best = distance(value, candidates[position[best_index]]);
+          for (const Listed& listed : shortlist) {
+            const Color* candidate = listed.color;
+            float const LIMIT = best + LUT_BOUND_SLACK;
+            if (listed.bound > LIMIT * LIMIT) {
+              break;  // The cell bound holds for this value too, and only grows from here
+            }
+            if (!(value.light && candidate->light) &&
+                boundSquared(fabsf(value.l - candidate->l), value.a - candidate->a,
+                             value.b - candidate->b, value.chroma + candidate->chroma) >
+                    LIMIT * LIMIT) {
+              continue;
+            }
+            float const DISTANCE = distance(value, *candidate);
+            if (DISTANCE < best || (DISTANCE == best && candidate->index < best_index)) {
+              best = DISTANCE;
+              best_index = candidate->index;
+            }
+          }
+          winners.push_back(best_index);
+        }
+
+        // Most frequent winner; ties go to the lower index
+        std::sort(winners.begin(), winners.end());
+        uint32_t hint = winners[0];
+        size_t hint_votes = 0;
+        for (size_t i = 0; i < winners.size();) {
+          size_t j = i;
+          while (j < winners.size() && winners[j] == winners[i]) {
+            j++;
+          }
+          if (j - i > hint_votes) {
+            hint = winners[i];
+            hint_votes = j - i;
+          }
+          i = j;
+        }
+        bool const UNIFORM = hint_votes == winners.size();
+        cells[(((cr * SIDE) + cg) * SIDE) + cb] =
+            (uint16_t)(hint | (UNIFORM ? 0 : DULUX_LUT_BOUNDARY));
+        seed = hint;
+      }
+    }
+  };
+
+  std::atomic<uint32_t> next_slice{0};
+  std::atomic<uint32_t> done_slices{0};
+  auto worker = [&]() {
+    for (uint32_t cr = next_slice++; cr < SIDE; cr = next_slice++) {
+      fillSlice(cr);
+      printf("\rComputing lookup table: %u%%", (unsigned)((++done_slices * 100) / SIDE));
+      fflush(stdout);
+    }
+  };
+  std::vector<std::thread> threads(std::max(1U, std::thread::hardware_concurrency()));
+  for (std::thread& thread : threads) {
+    thread = std::thread(worker);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  printf("\n");
+
+  auto const UNIFORM = (uint32_t)std::count_if(
+      cells.begin(), cells.end(), [](uint16_t cell) { return (cell & DULUX_LUT_BOUNDARY) == 0; });
+
+  DuluxLutHeader header{};
+  header.magic = DULUX_LUT_MAGIC;
+  header.version = DULUX_LUT_VERSION;
+  header.palette_crc = palette_crc;
+  header.color_count = (uint32_t)entries.size();
+  header.bits = DULUX_LUT_BITS;
+  header.uniform_cells = UNIFORM;
+  header.cells_crc =
+      duluxCrc32(0, reinterpret_cast<const uint8_t*>(cells.data()), cells.size() * sizeof(uint16_t));
+
+  std::vector<uint8_t> out;
+  append(out, header);
+  out.insert(out.end(), reinterpret_cast<const uint8_t*>(cells.data()),
+             reinterpret_cast<const uint8_t*>(cells.data() + cells.size()));
+  printf("Lookup table: %zu cells, %u uniform (%.1f%%)\n", cells.size(), UNIFORM,
+         (UNIFORM * 100.0) / cells.size());
+  return out;
+}
+
+/**
+ * @brief Encode one string column as a front-coded section
+ *
+ * Distinct strings are sorted bytewise so that neighbours share prefixes;
+ * each color stores the ordinal of its string.
+ */
+std::vector<uint8_t> encodeFrontCoded(const std::vector<std::string>& values) {
+  std::vector<std::string> distinct(values);
+  std::sort(distinct.begin(), distinct.end());
+  distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+  if (distinct.size() > UINT16_MAX + 1U) {
+    fail("too many distinct strings for a front-coded section");
+  }
+
+  std::vector<uint8_t> data;
+  std::vector<uint32_t> bucket_offsets;
+  for (size_t i = 0; i < distinct.size(); i++) {
+    const std::string& value = distinct[i];
+    size_t prefix = 0;
+    if (i % DULUX_FRONT_CODED_BUCKET == 0) {
+      bucket_offsets.push_back((uint32_t)data.size());
+    } else {
+      const std::string& previous = distinct[i - 1];
+      while (prefix < value.size() && prefix < previous.size() && value[prefix] == previous[prefix]) {
+        prefix++;
+      }
+    }
+    data.push_back((uint8_t)prefix);
+    data.push_back((uint8_t)(value.size() - prefix));
+    data.insert(data.end(), value.begin() + (long)prefix, value.end());
+  }
+
+  std::vector<uint8_t> out;
+  append(out, DuluxFrontCodedHeader{(uint32_t)values.size(), (uint32_t)distinct.size(),
+                                    DULUX_FRONT_CODED_BUCKET, 0, (uint32_t)data.size()});
+  for (const std::string& value : values) {
+    auto const ORDINAL = (uint16_t)(std::lower_bound(distinct.begin(), distinct.end(), value) -
+                                    distinct.begin());
+    append(out, ORDINAL);
+  }
+  while (out.size() % 4 != 0) {
+    out.push_back(0);
+  }
+  for (uint32_t offset : bucket_offsets) {
+    append(out, offset);
+  }
+  out.insert(out.end(), data.begin(), data.end());
+  return out;
+}
+
+std::vector<uint8_t> writeV1(const std::vector<PaletteEntry>& entries) {
+  std::vector<uint8_t> out;
+  append(out, DuluxBinaryHeader{DULUX_MAGIC_NUMBER, DULUX_BINARY_VERSION,
+                                (uint32_t)entries.size(), 0});
+  for (const PaletteEntry& entry : entries) {
+    out.push_back(entry.r);
+    out.push_back(entry.g);
+    out.push_back(entry.b);
+    append(out, entry.lrv_scaled);
+    append(out, entry.id);
+    out.push_back((uint8_t)entry.name.size());
+    appendString(out, entry.name);
+    out.push_back((uint8_t)entry.code.size());
+    appendString(out, entry.code);
+    out.push_back(entry.light_text ? 1 : 0);
+  }
+  append(out, DuluxV1Trailer{duluxCrc32(0, out.data(), out.size()), DULUX_TRAILER_MAGIC});
+  return out;
+}
+
+std::vector<uint8_t> writeV2(const std::vector<PaletteEntry>& entries, const Options& options,
+                             size_t source_count, uint32_t& crc_out) {
+  struct Section {
+    uint32_t tag;
+    std::vector<uint8_t> data;
+  };
+  std::vector<Section> sections = {
+      {DULUX_SECTION_RGB, {}},  {DULUX_SECTION_LAB, {}},  {DULUX_SECTION_LRV, {}},
+      {DULUX_SECTION_ID, {}},   {DULUX_SECTION_FLAGS, {}}, {DULUX_SECTION_NAME, {}},
+      {DULUX_SECTION_CODE, {}}, {DULUX_SECTION_STRINGS, {}}};
+  sections.reserve(sections.size() + 2);
+  std::vector<uint8_t>& rgb = sections[0].data;
+  std::vector<uint8_t>& lab = sections[1].data;
+  std::vector<uint8_t>& lrv = sections[2].data;
+  std::vector<uint8_t>& ids = sections[3].data;
+  std::vector<uint8_t>& flags = sections[4].data;
+  std::vector<uint8_t>& names = sections[5].data;
+  std::vector<uint8_t>& codes = sections[6].data;
+  std::vector<uint8_t>& heap = sections[7].data;
+
+  // Identical strings share one heap slot
+  std::map<std::string, uint32_t> interned;
+  auto intern = [&](const std::string& value) {
+    auto const FOUND = interned.find(value);
+    if (FOUND != interned.end()) {
+      return FOUND->second;
+    }
+    auto const OFFSET = (uint32_t)heap.size();
+    appendString(heap, value);
+    heap.push_back('\0');
+    interned[value] = OFFSET;
+    return OFFSET;
+  };
+
+  for (const PaletteEntry& entry : entries) {
+    rgb.push_back(entry.r);
+    rgb.push_back(entry.g);
+    rgb.push_back(entry.b);
+    append(lab, entry.lab);
+    append(lrv, entry.lrv_scaled);
+    append(ids, entry.id);
+    flags.push_back(entry.light_text ? DULUX_FLAG_LIGHT_TEXT : 0);
+    if (!options.front_coded) {
+      append(names, intern(entry.name));
+      append(codes, intern(entry.code));
+    }
+  }
+
+  if (options.front_coded) {
+    std::vector<std::string> name_values;
+    std::vector<std::string> code_values;
+    for (const PaletteEntry& entry : entries) {
+      name_values.push_back(entry.name);
+      code_values.push_back(entry.code);
+    }
+    // Replace the NAME/CODE/STRS slots so the section order stays stable
+    sections.resize(5);
+    sections.push_back({DULUX_SECTION_NAME_FC, encodeFrontCoded(name_values)});
+    sections.push_back({DULUX_SECTION_CODE_FC, encodeFrontCoded(code_values)});
+  }
+
+  if (options.emit_index) {
+    if (entries.size() > MAX_INDEXED_COLORS) {
+      fprintf(stderr, "  %zu colors exceed the 16-bit KD-tree section; index skipped\n",
+              entries.size());
+    } else {
+      sections.push_back({DULUX_SECTION_KDTREE, buildKDTree(entries)});
+    }
+  }
+
+  uint32_t crc = 0;
+  for (const Section& section : sections) {
+    crc = duluxCrc32(crc, section.data.data(), section.data.size());
+  }
+  crc_out = crc;
+
+  Section meta{DULUX_SECTION_META, {}};
+  append(meta.data, DuluxPaletteMeta{crc, options.ordering, (uint32_t)source_count, 0});
+  sections.push_back(meta);
+
+  // Lay out: header, aligned sections, then the section table
+  std::vector<uint8_t> out(DULUX_HEADER_SIZE, 0);
+  std::vector<DuluxSectionEntry> table;
+  for (const Section& section : sections) {
+    while (out.size() % DULUX_SECTION_ALIGNMENT != 0) {
+      out.push_back(0);
+    }
+    table.push_back({section.tag, (uint32_t)out.size(), (uint32_t)section.data.size()});
+    out.insert(out.end(), section.data.begin(), section.data.end());
+  }
+  while (out.size() % DULUX_SECTION_ALIGNMENT != 0) {
+    out.push_back(0);
+  }
+
+  auto const TABLE_OFFSET = (uint32_t)out.size();
+  append(out, (uint32_t)table.size());
+  for (const DuluxSectionEntry& entry : table) {
+    append(out, entry);
+  }
+
+  DuluxBinaryHeader const HEADER{DULUX_MAGIC_NUMBER, DULUX_BINARY_VERSION_V2,
+                                 (uint32_t)entries.size(), TABLE_OFFSET};
+  memcpy(out.data(), &HEADER, sizeof(HEADER));
+  return out;
+}
+
+Options parseArguments(int argc, char** argv) {
+  Options options;
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string const ARG = argv[i];
+    if (ARG == "--format" && i + 1 < argc) {
+      std::string const VALUE = argv[++i];
+      if (VALUE != "v1" && VALUE != "v2") {
+        fail("--format must be v1 or v2");
+      }
+      options.version = VALUE == "v1" ? DULUX_BINARY_VERSION : DULUX_BINARY_VERSION_V2;
+    } else if (ARG == "--order" && i + 1 < argc) {
+      std::string const VALUE = argv[++i];
+      if (VALUE == "hilbert") {
+        options.ordering = DULUX_ORDER_HILBERT;
+      } else if (VALUE == "morton") {
+        options.ordering = DULUX_ORDER_MORTON;
+      } else if (VALUE == "source") {
+        options.ordering = DULUX_ORDER_SOURCE;
+      } else {
+        fail("--order must be hilbert, morton or source");
+      }
+    } else if (ARG == "--keep-duplicates") {
+      options.dedupe = false;
+    } else if (ARG == "--no-index") {
+      options.emit_index = false;
+    } else if (ARG == "--names" && i + 1 < argc) {
+      std::string const VALUE = argv[++i];
+      if (VALUE != "front-coded" && VALUE != "plain") {
+        fail("--names must be front-coded or plain");
+      }
+      options.front_coded = VALUE == "front-coded";
+    } else if (ARG == "--lut" && i + 1 < argc) {
+      options.lut_output = argv[++i];
+    } else if (ARG == "-h" || ARG == "--help") {
+      printf("usage: palette_compiler [--format v1|v2] [--order hilbert|morton|source]\n"
+             "                        [--keep-duplicates] [--no-index] [--names front-coded|plain]\n"
+             "                        [--lut <output.lut>] <input> <output.bin>\n");
+      exit(0);
+    } else {
+      positional.push_back(ARG);
+    }
+  }
+  if (positional.size() != 2) {
+    fail("expected <input> <output.bin> (see --help)");
+  }
+  options.input = positional[0];
+  options.output = positional[1];
+  return options;
+}
+
+std::string extension(const std::string& path) {
+  size_t const DOT = path.find_last_of('.');
+  return DOT == std::string::npos ? "" : lowercase(path.substr(DOT + 1));
+}
+
+}  // namespace
+
+#ifndef PALETTE_COMPILER_NO_MAIN
+int main(int argc, char** argv) {
+  Options const OPTIONS = parseArguments(argc, argv);
+
+  std::string const EXT = extension(OPTIONS.input);
+  std::vector<PaletteEntry> entries;
+  if (EXT == "csv") {
+    entries = readCsv(OPTIONS.input);
+  } else if (EXT == "json") {
+    std::string const TEXT = readFile(OPTIONS.input);
+    entries = JsonReader(TEXT).parse();
+  } else if (EXT == "bin") {
+    entries = readBinary(OPTIONS.input);
+  } else {
+    fail("unsupported input type: " + OPTIONS.input);
+  }
+
+  size_t const SOURCE_COUNT = entries.size();
+  printf("Read %zu colors from %s\n", SOURCE_COUNT, OPTIONS.input.c_str());
+  if (entries.empty()) {
+    fail("palette is empty");
+  }
+
+  if (OPTIONS.dedupe) {
+    printf("Removed %zu duplicate colors\n", dedupe(entries));
+  }
+  clampStrings(entries);
+  computeLabAndOrder(entries, OPTIONS.ordering);
+
+  uint32_t crc = 0;
+  std::vector<uint8_t> image;
+  if (OPTIONS.version == DULUX_BINARY_VERSION) {
+    image = writeV1(entries);
+    memcpy(&crc, image.data() + image.size() - sizeof(DuluxV1Trailer), sizeof(crc));
+  } else {
+    image = writeV2(entries, OPTIONS, SOURCE_COUNT, crc);
+  }
+
+  FILE* out = fopen(OPTIONS.output.c_str(), "wb");
+  if (!out || fwrite(image.data(), 1, image.size(), out) != image.size()) {
+    fail("cannot write " + OPTIONS.output);
+  }
+  fclose(out);
+
+  printf("Wrote %s: v%u, %zu colors, %zu bytes, CRC-32 0x%08X\n", OPTIONS.output.c_str(),
+         OPTIONS.version, entries.size(), image.size(), crc);
+
+  if (!OPTIONS.lut_output.empty()) {
+    if (entries.size() > DULUX_LUT_MAX_COLORS) {
+      fail("too many colors for a lookup table");
+    }
+    std::vector<uint8_t> const LUT = buildLut(entries, crc);
+    FILE* lut = fopen(OPTIONS.lut_output.c_str(), "wb");
+    if (!lut || fwrite(LUT.data(), 1, LUT.size(), lut) != LUT.size()) {
+      fail("cannot write " + OPTIONS.lut_output);
+    }
+    fclose(lut);
+    printf("Wrote %s: %zu bytes\n", OPTIONS.lut_output.c_str(), LUT.size());
+  }
+  return 0;
+}
+#endif